@@ -1,237 +1,346 @@
+// doneAction fires whenever an excited membrane has decayed into silence.
+// model picks the mesh variant at init: the sum of 1 (self loops, tension
+// control), 2 (inverting rim guides) and 4 (rim filter); 7 is the original
+// and what any other value plays, with a message.
 
 StoneChime0 : UGen {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 }
 
 StoneChime1 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	checkInputs { ^this.checkSameRateAsFirstInput }
 }
 
 StoneChime2 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 }
 
 StoneChime3 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 }
 
 SCFrag5 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag6 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag7 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag8 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag9 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag10 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag11 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag12 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag13 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag14 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag15 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag16 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag17 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag18 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag19 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag20 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag21 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag22 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag23 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag24 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag25 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag26 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag27 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag28 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag29 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag30 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag31 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag32 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag33 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag34 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag35 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag36 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag37 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag38 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag39 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag40 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag41 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag42 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag43 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag44 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag45 : StoneChime0 {
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 	}
 SCFrag46 : StoneChime0{
-	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0;
-		^this.multiNew('audio', excitation, tension, loss).madd(mul, add)
+	*ar { arg excitation, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7;
+		^this.multiNew('audio', excitation, tension, loss, doneAction, model).madd(mul, add)
 	}
 }
 
+
+// a mesh loaded while the server runs, by id (0-1023). loadPoints reads
+// "x y" lattice points, the first one the output; loadMask a text picture
+// of the mesh, 'o' marking the output. every point must lie within 1024
+// lattice units of the output in x and y, or the mesh is refused. preload builds meshes before the
+// notes that need them: UGen names or [shape, angle, fragNums] triples.
+// VarMembraneLanes, VarMembraneModal and VarMembraneConv play custom
+// meshes too, as shape 4 with the id as fragNums.
+// pickups adds an output channel per [x, y] point to listen at besides the
+// output, in lattice units from it (x steps 2 along a row, rows 1 apart),
+// e.g. [[-8, 0], [8, 0]] for three channels; the nearest junction is used.
+// strike, an [x, y] point in the same units, is where the excitation hits
+// the mesh, spread over the junctions within 4 units of it; nil keeps the
+// mesh's own point. it may be modulated: a new point is placed in the
+// background and applies a few blocks later. only VarMembraneCustom and
+// VarMembraneShape take pickups and strike: the other membranes have the
+// one output and strike where the mesh does
+VarMembraneCustom : MultiOutUGen {
+	*ar { arg excitation, id = 0, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7, pickups = #[], strike;
+		^this.multiNewList(['audio', pickups.size, excitation, tension, loss, doneAction, model, id] ++ strike.asArray ++ pickups.flat).madd(mul, add)
+	}
+	init { arg pickupN ... theInputs;
+		inputs = theInputs;
+		^this.initOutputs(pickupN + 1, rate)
+	}
+	*loadPoints { arg id, path, server;
+		(server ? Server.default).sendMsg(\cmd, \membraneLoadPoints, id, path.standardizePath)
+	}
+	*loadMask { arg id, path, server;
+		(server ? Server.default).sendMsg(\cmd, \membraneLoadMask, id, path.standardizePath)
+	}
+	*preload { arg items, server;
+		(server ? Server.default).sendMsg(\cmd, \membranePreload, *items.flat)
+	}
+}
+
+// any mesh by its parameters, fixed when the synth starts. shape: 0
+// circle, 1 hexagon, 2 stone chime, 3 fragment, 4 custom. angle is any
+// positive number for chimes (StoneChime0-3 are 2, 6, 10 and 14), fragNums
+// the fragment count or the custom id. an unseen combination plays silence
+// until it is built in the background; VarMembraneCustom.preload builds
+// ahead, e.g. [[2, 9.5, 0]]. pickups and strike as for VarMembraneCustom
+VarMembraneShape : MultiOutUGen {
+	*ar { arg excitation, shape = 2, angle = 14, fragNums = 0, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7, pickups = #[], strike;
+		^this.multiNewList(['audio', pickups.size, excitation, tension, loss, doneAction, model, shape, angle, fragNums] ++ strike.asArray ++ pickups.flat).madd(mul, add)
+	}
+	init { arg pickupN ... theInputs;
+		inputs = theInputs;
+		^this.initOutputs(pickupN + 1, rate)
+	}
+}
+
+// VarMembraneLanes, VarMembraneModal and VarMembraneConv take the mesh
+// first, in the order of VarMembraneShape: excitation, shape, angle,
+// fragNums, tension, loss, mul, add, then their own arguments.
+
+// one mesh shared by several voices, one output channel per excitation.
+// shape: 0 circle, 1 hexagon, 2 stone chime (angle), 3 fragment (fragNums),
+// 4 custom (fragNums is the id). an excitation that is a number or a
+// control signal is read once a block
+VarMembraneLanes : MultiOutUGen {
+	*ar { arg excitation, shape = 2, angle = 2, fragNums = 0, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, model = 7;
+		var lanes = excitation.asArray.collect { |exc, i|
+			[exc, tension.asArray.wrapAt(i), loss.asArray.wrapAt(i)]
+		};
+		^this.multiNewList([\audio, shape, angle, fragNums, model] ++ lanes.flat).madd(mul, add)
+	}
+	init { arg ... theInputs;
+		inputs = theInputs;
+		^this.initOutputs((inputs.size - 4) div: 3, rate)
+	}
+}
+
+// the mesh as a bank of resonators, computed once per shape and model and
+// retuned to tension and loss, which may change while it plays. maxModes 0
+// keeps every mode; threshold drops modes weaker than that fraction of the
+// strongest. the excitation must be audio rate
+VarMembraneModal : UGen {
+	*ar { arg excitation, shape = 2, angle = 2, fragNums = 0, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, model = 7, maxModes = 0, threshold = 0;
+		^this.multiNew('audio', excitation, tension, loss, shape, angle, fragNums, maxModes, threshold, model).madd(mul, add)
+	}
+	checkInputs {
+		if(inputs.at(0).rate != \audio) { ^"excitation must be audio rate" };
+		^this.checkValidInputs
+	}
+}
+
+// the mesh as its impulse response, rendered once per shape, tension, loss
+// and length (seconds) and shared by every unit with about the same
+// settings, then played by zero-latency partitioned convolution. costs the
+// same for every shape; tension and loss are read at init only. length is
+// at most 8 seconds, and every unit takes about 8 bytes of real-time
+// memory per sample of it: 1.5 MB for 2 seconds at 48 kHz, so raise
+// scsynth's -m for many voices. doneAction fires when the response has
+// run out, or at once if it cannot be had. the excitation must be audio
+// rate
+VarMembraneConv : UGen {
+	*ar { arg excitation, shape = 2, angle = 2, fragNums = 0, tension=0.05, loss = 0.99999, mul = 1.0, add = 0.0, doneAction = 0, model = 7, length = 2;
+		^this.multiNew('audio', excitation, tension, loss, shape, angle, fragNums, length, model, doneAction).madd(mul, add)
+	}
+	checkInputs {
+		if(inputs.at(0).rate != \audio) { ^"excitation must be audio rate" };
+		^this.checkValidInputs
+	}
+}
@@ -0,0 +1,2096 @@
+// Standalone benchmark for the membrane kernels, runs outside scsynth.
+// Compares the original pointer-chasing cycle() against the compiled
+// mesh_cycle(), every SIMD kernel the CPU supports and the temporally
+// blocked mesh_run_tiled(), the voice-interleaved lanes kernel and the modal
+// resonator bank, for every registered shape, and reports ns per sample.
+// The pointer mesh takes the input inside its junction loop, as it always
+// did; there and in the third table the kernels are struck at the same
+// single point and must match it to rounding, tiled and lanes the scalar
+// kernel exactly.
+//
+// A second table compares the junction numberings of compile_mesh() (the
+// shape's flood fill order, Cuthill-McKee and lattice rows) by cache misses
+// and ns per sample.
+//
+// A third table runs every model variant (MESH_MODEL_*) of StoneChime3
+// against the pointer mesh built for the same model, then of the one-point
+// meshes, whose lone junction has no ports and must stay silent, and
+// checks which model ids the UGen inputs select.
+//
+// A fourth table compares the structured stencil (Membrane_stencil.h) with
+// the compiled mesh on registered units and growing discs;
+// "MembraneBench stencil" runs only that table.
+//
+// A fifth table checks the K-variable engine (Membrane_kmesh.h) against
+// the W-variable mesh_cycle() for every model, with state bytes per voice;
+// "MembraneBench kmesh" runs only that table.
+//
+// A sixth table plays the rendered impulse response (Membrane_conv.h)
+// against the mesh it was rendered from; "MembraneBench conv" runs only
+// that table.
+//
+// A seventh table writes compiled meshes to a mesh file
+// (Membrane_meshfile.h), maps it back and runs both, which must agree to
+// the bit, then damages a small one word by word: every copy must be
+// refused or play safely; "MembraneBench meshfile" runs only that table.
+//
+// An eighth table listens at several junctions at once (t_mesh_pickup):
+// a pickup at the output must match what the kernel returns, pickups on
+// the mesh and on the stencil must agree, and the cost per sample with
+// them; "MembraneBench pickup" runs only that table. Both are struck away
+// from the default point (t_mesh_strike), so the two strikes must agree
+// too.
+//
+// A ninth table fills the mesh cache (StoneChime.h) with meshes, modes and
+// a response, releases them and trims it: the least recently released
+// must go first, nearly the same response settings must share one, and a
+// purge must hand every byte back to the heap;
+// "MembraneBench cache" runs only that table.
+//
+// A tenth table strikes every registered unit with its whole footprint
+// (t_mesh_strike), at the default point and away from it, against the
+// pointer mesh struck with the same weights; "MembraneBench strike" runs
+// only that table.
+//
+// "MembraneBench build" times the shape builder and compile_mesh() on
+// hexagonal discs of up to ~100k junctions, against the original quadratic
+// flood fill where that finishes in reasonable time.
+//
+// "MembraneBench decay [seconds]" instead follows one struck StoneChime3
+// through its long decay and prints the cost per second of audio with
+// subnormals, with them flushed, and with the unit's auto-sleep.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#include "StoneChime.h"
+
+#define BENCH_SAMPLES (48000 * 2)
+#define BENCH_LANES 16
+#define BENCH_MODAL_TOLERANCE 1e-3f // all modes against the scalar kernel
+#define BENCH_REF_TOLERANCE 1e-4f // the scalar kernel against the pointer mesh
+#define BENCH_BLOCK 64
+#define BENCH_RATE 48000
+
+// the registered UGens and their VarMembrane_init() arguments
+typedef struct {
+  const char *name;
+  int shape_type;
+  int angle;
+  int fragNums;
+  int points_n; // expected topology
+  int lines_n;
+  int edge_n;
+} t_bench_unit;
+
+// points, lines and edge points of every registered UGen, in
+// registeredUnits() order, as built by the original shape code
+static const int unitCounts[][3] = {
+  {1, 0, 1}, {1, 0, 1}, {91, 228, 42}, {103, 258, 48},
+  {115, 288, 54}, {117, 292, 56}, {1, 0, 1}, {1, 0, 1},
+  {1, 0, 1}, {1, 0, 1}, {1, 0, 1}, {18, 35, 15},
+  {18, 35, 15}, {22, 45, 18}, {22, 45, 18}, {27, 56, 22},
+  {27, 56, 22}, {32, 67, 26}, {32, 67, 26}, {37, 78, 30},
+  {37, 78, 30}, {40, 86, 31}, {40, 86, 31}, {43, 93, 33},
+  {43, 93, 33}, {49, 107, 37}, {49, 107, 37}, {51, 113, 37},
+  {51, 113, 37}, {53, 119, 37}, {53, 119, 37}, {55, 126, 36},
+  {55, 126, 36}, {55, 126, 36}, {55, 126, 36}, {57, 131, 37},
+  {57, 131, 37}, {60, 140, 37}, {60, 140, 37}, {65, 154, 38},
+  {65, 154, 38}, {67, 159, 39}, {67, 159, 39}, {71, 171, 39},
+  {71, 171, 39}, {75, 182, 40}, {75, 182, 40}, {77, 190, 38},
+  {77, 190, 38}, {82, 203, 40}, {82, 203, 40}, {84, 208, 41},
+  {84, 208, 41}
+};
+
+static std::vector<t_bench_unit> registeredUnits()
+{
+  std::vector<t_bench_unit> units;
+  static char names[47][16];
+  t_bench_unit u;
+
+  u.name = "VarMembraneCircle"; u.shape_type = 0; u.angle = 0; u.fragNums = 0;
+  units.push_back(u);
+  u.name = "VarMembraneHexagon"; u.shape_type = 1;
+  units.push_back(u);
+
+  static const char *chimes[] = {"StoneChime0", "StoneChime1", "StoneChime2", "StoneChime3"};
+  for (int i = 0; i < 4; ++i) {
+    u.name = chimes[i]; u.shape_type = 2; u.angle = 2 + i * 4; u.fragNums = 0;
+    units.push_back(u);
+  }
+
+  for (int i = 0; i < 47; ++i) {
+    snprintf(names[i], sizeof(names[i]), "SCFrag%d", i);
+    u.name = names[i]; u.shape_type = 3; u.angle = 0; u.fragNums = i;
+    units.push_back(u);
+  }
+
+  for (size_t i = 0; i < units.size(); ++i) {
+    units[i].points_n = unitCounts[i][0];
+    units[i].lines_n = unitCounts[i][1];
+    units[i].edge_n = unitCounts[i][2];
+  }
+  return units;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// the original pointer mesh, kept as the reference implementation. its
+// junctions take their share of the input inside the junction loop, as
+// they always did; the kernels add theirs afterwards (t_mesh_strike)
+
+typedef struct {
+  float a;
+  float b;
+  float c;
+  int invert;
+} t_delay;
+
+typedef struct {
+  int ins, outs;
+  t_delay *in[6];
+  t_delay *out[6];
+  t_delay *self_loop;
+} t_junction;
+
+typedef struct {
+  int model;
+  int points_n;
+  int delay_n;
+  t_junction *junctions;
+  t_delay *delays;
+  float *drive; // the share of the input each junction takes
+} t_ref_mesh;
+
+static void ref_init(t_ref_mesh *ref, const t_shape *shape, int model)
+{
+  int d = 0;
+
+  ref->model = model;
+  ref->points_n = shape->points_n;
+  ref->delay_n = shape->lines_n * 2 + shape->edge_n + shape->points_n;
+  ref->delays = (t_delay *) calloc(ref->delay_n, sizeof(t_delay));
+  ref->junctions = (t_junction *) calloc(shape->points_n, sizeof(t_junction));
+  ref->drive = (float *) calloc(shape->points_n, sizeof(float));
+
+  for (int i = 0; i < shape->lines_n; ++i) {
+    t_junction *from = &ref->junctions[shape->lines[i].a];
+    t_junction *to = &ref->junctions[shape->lines[i].b];
+    t_delay *delay = &ref->delays[d++];
+
+    from->out[from->outs++] = delay;
+    to->in[to->ins++] = delay;
+
+    delay = &ref->delays[d++];
+    from->in[from->ins++] = delay;
+    to->out[to->outs++] = delay;
+  }
+
+  for (int i = 0; i < shape->points_n; ++i) {
+    t_junction *junction = &ref->junctions[i];
+    junction->self_loop = &ref->delays[d++];
+
+    if (shape->points[i].is_edge && (model & MESH_RIM_GUIDES)) {
+      t_delay *delay = &ref->delays[d++];
+      delay->invert = 1;
+      junction->out[junction->outs++] = delay;
+      junction->in[junction->ins++] = delay;
+    }
+  }
+}
+
+// strike the reference at n shape points
+static void ref_strike(t_ref_mesh *ref, const uint32_t *points, const float *weights, uint32_t n)
+{
+  memset(ref->drive, 0, ref->points_n * sizeof(float));
+  for (uint32_t s = 0; s < n; ++s) {
+    ref->drive[points[s]] += weights[s];
+  }
+}
+
+static void ref_free(t_ref_mesh *ref)
+{
+  free(ref->delays);
+  free(ref->junctions);
+  free(ref->drive);
+}
+
+static float ref_cycle(t_ref_mesh *ref, float input, float yj, float yj_r, float loss)
+{
+  float result = 0;
+
+  for (int i = 0; i < ref->points_n; ++i) {
+    t_junction *junction = &ref->junctions[i];
+    float total = 0;
+    float yc = yj - junction->ins;
+
+    for (int j = 0; j < junction->ins; ++j) {
+      total += junction->in[j]->b;
+    }
+    if (ref->model & MESH_SELF_LOOP) {
+      total = 2.0f * (total + (yc * junction->self_loop->b)) * yj_r;
+    }
+    else {
+      total *= (2.0f / ((float) (junction->ins ? junction->ins : 1)));
+    }
+
+    total += input * ref->drive[i];
+    total *= loss;
+
+    for (int j = 0; j < junction->outs; ++j) {
+      junction->out[j]->a = total - junction->in[j]->b;
+    }
+    junction->self_loop->a = total - junction->self_loop->b;
+
+    if (i == 0) {
+      result = total;
+    }
+  }
+
+  for (int i = 0; i < ref->delay_n; ++i) {
+    t_delay *delay = &ref->delays[i];
+    if (delay->invert && (ref->model & MESH_RIM_FILTER)) {
+      delay->b = ((0.0f - delay->a) + delay->c) * 0.5f;
+      delay->c = (0.0f - delay->a);
+    }
+    else if (delay->invert) {
+      delay->b = 0.0f - delay->a;
+    }
+    else {
+      delay->b = delay->a;
+    }
+  }
+  return result;
+}
+
+// all the input into the shape point nearest the mesh's default strike,
+// on the reference and as a t_mesh_strike for the kernels. a mesh without
+// lines is not struck at all, as mesh_strike() would not
+static void benchStrikePoint(t_ref_mesh *ref, const t_shape *shape, const t_mesh *mesh,
+                             t_mesh_strike *strike)
+{
+  float x, y;
+  uint32_t point;
+  const float weight = 1.f;
+
+  mesh_strike_default(shape, &x, &y);
+  point = mesh_point_near(shape, x, y);
+
+  strike->n = shape->lines_n > 0;
+  strike->junction[0] = mesh->junction_of[point];
+  strike->weight[0] = weight;
+  strike->output = strike->n && strike->junction[0] == 0 ? weight : 0.f;
+  strike->tile[0] = 0;
+  for (uint32_t k = 0; k < mesh->tile_n; ++k) {
+    for (uint32_t j = mesh->tile_off[k]; j < mesh->tile_off[k + 1]; ++j) {
+      if (mesh->tile_junctions[j] == strike->junction[0]) {
+        strike->tile[0] = k;
+      }
+    }
+  }
+  ref_strike(ref, &point, &weight, strike->n);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// a short noise burst, like the trigger excitation
+static void makeExcitation(float *buf, int n)
+{
+  srand(1);
+  memset(buf, 0, n * sizeof(float));
+  for (int i = 0; i < 1024 && i < n; ++i) {
+    buf[i] = (0.01 - (((float) rand() / RAND_MAX) * 0.02));
+  }
+}
+
+static double now_ns()
+{
+  return std::chrono::duration<double, std::nano>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// fmaxf() passes over NaN, so relError() alone would not see one
+static int allFinite(const float *x, int n)
+{
+  for (int k = 0; k < n; ++k) {
+    if (!std::isfinite(x[k])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// peak-relative difference between two renders
+static float relError(const float *x, const float *y, int n)
+{
+  float peak = 0, err = 0;
+  for (int k = 0; k < n; ++k) {
+    peak = fmaxf(peak, fabsf(x[k]));
+    err = fmaxf(err, fabsf(x[k] - y[k]));
+  }
+  return peak > 0 ? err / peak : err;
+}
+
+////////////////////////////////////////////////////////////////////
+
+enum { DECAY_SUBNORMAL, DECAY_FLUSH, DECAY_SLEEP, DECAY_N };
+
+// ns per sample for each second of a decay, run like VarMembrane_next_a()
+static void decayRun(const t_mesh *mesh, int mode, const float *input, int seconds,
+                     float yj, float yj_r, float loss, double *cost, float *energy)
+{
+  t_mesh_state state;
+  void *block = malloc(mesh_state_size(mesh));
+  float out[BENCH_BLOCK];
+  int asleep = 0;
+
+  mesh_state_init(mesh, &state, block);
+
+  for (int s = 0; s < seconds; ++s) {
+    double t0 = now_ns();
+
+    for (int k = 0; k < BENCH_RATE; k += BENCH_BLOCK) {
+      const float *in = &input[(size_t) s * BENCH_RATE + k];
+      unsigned int fpmode = 0;
+
+      if (asleep) {
+        for (int j = 0; j < BENCH_BLOCK; ++j) {
+          asleep &= in[j] == 0.f;
+        }
+        if (asleep) {
+          memset(out, 0, sizeof(out));
+          continue;
+        }
+      }
+
+      if (mode != DECAY_SUBNORMAL) {
+        fpmode = mesh_denormals_flush();
+      }
+      for (int j = 0; j < BENCH_BLOCK; ++j) {
+        out[j] = mesh_kernels(MESH_MODEL_DEFAULT)->cycle(mesh, &state, in[j], yj, yj_r, loss);
+      }
+      if (mode == DECAY_SLEEP) {
+        int quiet = 1;
+        for (int j = 0; j < BENCH_BLOCK; ++j) {
+          quiet &= in[j] == 0.f;
+        }
+        if (quiet && mesh_state_energy(mesh, MESH_MODEL_DEFAULT, &state) < MESH_QUIET_ENERGY) {
+          mesh_state_clear(mesh, &state);
+          asleep = 1;
+        }
+      }
+      if (mode != DECAY_SUBNORMAL) {
+        mesh_denormals_restore(fpmode);
+      }
+    }
+
+    cost[s] = (now_ns() - t0) / BENCH_RATE;
+    if (energy) {
+      energy[s] = mesh_state_energy(mesh, MESH_MODEL_DEFAULT, &state);
+    }
+  }
+  free(block);
+}
+
+static int decayBench(int seconds, float yj, float yj_r, float loss)
+{
+  t_mesh_entry *entry = acquireMesh(2, 14, 0);
+  std::vector<float> input((size_t) seconds * BENCH_RATE);
+  std::vector<double> cost[DECAY_N];
+  std::vector<float> energy(seconds);
+  static const char *names[] = {"subnormal", "flushed", "sleeping"};
+
+  makeExcitation(input.data(), (int) input.size());
+
+  for (int mode = 0; mode < DECAY_N; ++mode) {
+    cost[mode].resize(seconds);
+    decayRun(entry->mesh, mode, input.data(), seconds, yj, yj_r, loss, cost[mode].data(),
+             mode == DECAY_SUBNORMAL ? energy.data() : NULL);
+  }
+
+  printf("StoneChime3, one strike, loss %g, ns per sample for each second of audio\n", loss);
+  printf("%7s %12s", "second", "energy");
+  for (int mode = 0; mode < DECAY_N; ++mode) {
+    printf(" %10s", names[mode]);
+  }
+  printf("\n");
+  for (int s = 0; s < seconds; ++s) {
+    printf("%7d %12.3g", s, energy[s]);
+    for (int mode = 0; mode < DECAY_N; ++mode) {
+      printf(" %10.2f", cost[mode][s]);
+    }
+    printf("\n");
+  }
+
+  releaseMesh(entry);
+  purgeMeshCache();
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// the original flood fill, which scans every input point per probe and
+// every made point per find; kept as the reference for the grid builder
+
+#define BUILD_REF_MAX 16384 // the original fixed array size
+#define BUILD_REF_LIMIT 20000 // largest disc worth waiting for
+
+static int refInShape(int x, int y, const t_point p[], int pSize)
+{
+  for (int i = 0; i < pSize; i++) {
+    if (x == p[i].x && y == p[i].y) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static t_shape *refShape(const t_point p[], int pSize)
+{
+  static const int possible[6][2] = {{1, 1}, {2, 0}, {1, -1}, {-1, -1}, {-2, 0}, {-1, 1}};
+  t_shape *shape = (t_shape *) calloc(1, sizeof(t_shape));
+  int *search = (int *) calloc(BUILD_REF_MAX, sizeof(int));
+  int search_n = 0;
+  int look = 0;
+
+  shape->points_max = BUILD_REF_MAX;
+  shape->lines_max = BUILD_REF_MAX * 3;
+  shape->points = (t_point *) calloc(shape->points_max, sizeof(t_point));
+  shape->lines = (t_line *) calloc(shape->lines_max, sizeof(t_line));
+  shape->points_n = 1;
+
+  while (look >= 0) {
+    for (int i = 0; i < 6; ++i) {
+      t_point *from = &shape->points[look];
+      int x = from->x + possible[i][0];
+      int y = from->y + possible[i][1];
+      int id = -1;
+
+      if (!refInShape(x, y, p, pSize)) {
+        if (!from->is_edge) {
+          from->is_edge = 1;
+          shape->edge_n++;
+        }
+        continue;
+      }
+      for (int j = 0; j < shape->points_n; ++j) {
+        if (shape->points[j].x == x && shape->points[j].y == y) {
+          id = j;
+          break;
+        }
+      }
+      if (id < 0) {
+        id = shape->points_n++;
+        shape->points[id].id = id;
+        shape->points[id].x = x;
+        shape->points[id].y = y;
+        search[search_n++] = id;
+      }
+      if (i < 3) {
+        shape->lines[shape->lines_n].a = look;
+        shape->lines[shape->lines_n].b = id;
+        shape->lines_n++;
+      }
+    }
+    look = search_n ? search[--search_n] : -1;
+  }
+  free(search);
+  return shape;
+}
+
+// same points, ids, edges and lines in the same order
+static int sameShape(const t_shape *x, const t_shape *y)
+{
+  if (x->points_n != y->points_n || x->lines_n != y->lines_n || x->edge_n != y->edge_n) {
+    return 0;
+  }
+  for (int i = 0; i < x->points_n; ++i) {
+    const t_point *a = &x->points[i], *b = &y->points[i];
+    if (a->id != b->id || a->x != b->x || a->y != b->y || a->is_edge != b->is_edge) {
+      return 0;
+    }
+  }
+  for (int i = 0; i < x->lines_n; ++i) {
+    if (x->lines[i].a != y->lines[i].a || x->lines[i].b != y->lines[i].b) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// the lattice points (x + y even) of a hexagon of the given radius around
+// the origin, about 3 r^2 junctions
+static std::vector<t_point> hexDisc(int radius)
+{
+  std::vector<t_point> p;
+  t_point point = {0, 0, 0, 0};
+
+  for (int y = -radius; y <= radius; ++y) {
+    int half = 2 * radius - abs(y);
+    for (int x = -half; x <= half; ++x) {
+      if (((x + y) & 1) == 0) {
+        point.x = x;
+        point.y = y;
+        p.push_back(point);
+      }
+    }
+  }
+  return p;
+}
+
+static int buildBench()
+{
+  static const int radii[] = {4, 8, 16, 32, 64, 96, 128, 182};
+  int failures = 0;
+
+  printf("%7s %8s %8s %8s %12s %12s %12s %10s %6s\n", "radius", "points", "lines", "edge",
+         "ref ms", "grid ms", "compile ms", "ns/point", "ok");
+
+  for (size_t r = 0; r < sizeof(radii) / sizeof(*radii); ++r) {
+    std::vector<t_point> p = hexDisc(radii[r]);
+    double t0 = now_ns();
+    t_shape *shape;
+    int error = getShape2(0, p.data(), (int) p.size(), &shape);
+    double t1 = now_ns();
+
+    if (error != SHAPE_OK) {
+      printf("%7d %s\n", radii[r], shape_error(error));
+      failures++;
+      continue;
+    }
+    t_mesh *mesh = compile_mesh(shape, MESH_ORDER_DEFAULT);
+    double t2 = now_ns();
+    int ok = shape->points_n == (int) p.size();
+
+    printf("%7d %8d %8d %8d", radii[r], shape->points_n, shape->lines_n, shape->edge_n);
+
+    if ((int) p.size() < BUILD_REF_LIMIT && (int) p.size() < BUILD_REF_MAX) {
+      double t3 = now_ns();
+      t_shape *ref = refShape(p.data(), (int) p.size());
+      printf(" %12.3f", (now_ns() - t3) / 1e6);
+      ok &= sameShape(ref, shape);
+      free_shape(ref);
+    }
+    else {
+      printf(" %12s", "-");
+    }
+
+    printf(" %12.3f %12.3f %10.1f %6s\n", (t1 - t0) / 1e6, (t2 - t1) / 1e6,
+           (t1 - t0) / shape->points_n, ok ? "yes" : "NO");
+    failures += !ok;
+
+    free_mesh(mesh);
+    free_shape(shape);
+  }
+
+  // bounding boxes that would overflow, or take more than SHAPE_GRID_MAX
+  // cells, are refused before anything is allocated; so are custom points
+  // past CUSTOM_EXTENT
+  t_point far[2] = {{0, 0, 0, 0}, {0, INT_MAX - 1, INT_MAX - 1, 0}};
+  t_point wide[2] = {{0, 0, 0, 0}, {0, 2 * CUSTOM_EXTENT + 2, 0, 0}};
+  t_shape *shape;
+  int refused = getShape2(0, far, 2, &shape) == SHAPE_ERR_GRID && !shape
+    && defineCustomMesh(0, wide, 2) == 0;
+  printf("%7s %s %6s\n", "far", "refused", refused ? "yes" : "NO");
+  failures += !refused;
+
+  return failures ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// junction numbering against cache behaviour. hardware counters are read
+// where the kernel exposes them; the simulated count replays the scalar
+// kernel's delay accesses through a small fully associative LRU cache, so
+// it is reproducible everywhere
+
+#define SIM_CACHE_LINES 512 // 32 KB
+#define SIM_LINE_FLOATS 16
+
+enum { COUNTER_L1D, COUNTER_LLC, COUNTER_N };
+
+typedef struct {
+  int fd[COUNTER_N];
+} t_counters;
+
+static void countersOpen(t_counters *c)
+{
+  for (int i = 0; i < COUNTER_N; ++i) {
+    c->fd[i] = -1;
+  }
+#ifdef __linux__
+  for (int i = 0; i < COUNTER_N; ++i) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    if (i == COUNTER_L1D) {
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+    else {
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    }
+    c->fd[i] = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+#endif
+}
+
+static void countersStart(t_counters *c)
+{
+#ifdef __linux__
+  for (int i = 0; i < COUNTER_N; ++i) {
+    if (c->fd[i] >= 0) {
+      ioctl(c->fd[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(c->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#endif
+}
+
+// counts since countersStart(), -1 where unavailable
+static void countersStop(t_counters *c, long long *counts)
+{
+  for (int i = 0; i < COUNTER_N; ++i) {
+    counts[i] = -1;
+#ifdef __linux__
+    if (c->fd[i] >= 0) {
+      ioctl(c->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+      if (read(c->fd[i], &counts[i], sizeof(counts[i])) != sizeof(counts[i])) {
+        counts[i] = -1;
+      }
+    }
+#endif
+  }
+}
+
+static void countersClose(t_counters *c)
+{
+#ifdef __linux__
+  for (int i = 0; i < COUNTER_N; ++i) {
+    if (c->fd[i] >= 0) {
+      close(c->fd[i]);
+    }
+  }
+#endif
+}
+
+static void simTouch(std::vector<long> &lru, long line, long *misses)
+{
+  for (size_t i = 0; i < lru.size(); ++i) {
+    if (lru[i] == line) {
+      lru.erase(lru.begin() + i);
+      lru.insert(lru.begin(), line);
+      return;
+    }
+  }
+  (*misses)++;
+  lru.insert(lru.begin(), line);
+  if (lru.size() > SIM_CACHE_LINES) {
+    lru.pop_back();
+  }
+}
+
+// misses of the second of two mesh_cycle() calls, in the default model
+static long simMisses(const t_mesh *mesh)
+{
+  std::vector<long> lru;
+  long misses = 0;
+  long buffer[2] = {0, 1};
+  long lines = (long) mesh->delay_n / SIM_LINE_FLOATS + 1;
+
+  for (int cycle = 0; cycle < 2; ++cycle) {
+    long a = buffer[cycle & 1] * lines, b = buffer[(cycle + 1) & 1] * lines, c = 2 * lines;
+
+    if (cycle == 1) {
+      misses = 0;
+    }
+    for (uint32_t i = 0; i < mesh->points_n; ++i) {
+      uint32_t self = mesh->rim_d + i;
+      for (uint32_t p = mesh->port_off[i]; p < mesh->port_off[i + 1]; ++p) {
+        simTouch(lru, b + mesh->in[p] / SIM_LINE_FLOATS, &misses);
+      }
+      simTouch(lru, b + self / SIM_LINE_FLOATS, &misses);
+      for (uint32_t p = mesh->port_off[i]; p < mesh->port_off[i + 1]; ++p) {
+        simTouch(lru, a + mesh->out[p] / SIM_LINE_FLOATS, &misses);
+        simTouch(lru, b + mesh->in[p] / SIM_LINE_FLOATS, &misses);
+      }
+      simTouch(lru, a + self / SIM_LINE_FLOATS, &misses);
+    }
+    for (uint32_t d = mesh->line_d; d < mesh->rim_d; ++d) {
+      simTouch(lru, a + d / SIM_LINE_FLOATS, &misses);
+      simTouch(lru, c + (d - mesh->line_d) / SIM_LINE_FLOATS, &misses);
+    }
+  }
+  return misses;
+}
+
+// largest junction number difference across a line
+static uint32_t meshBandwidth(const t_shape *shape, const t_mesh *mesh)
+{
+  uint32_t width = 0;
+
+  for (int i = 0; i < shape->lines_n; ++i) {
+    uint32_t a = mesh->junction_of[shape->lines[i].a];
+    uint32_t b = mesh->junction_of[shape->lines[i].b];
+    width = std::max(width, a > b ? a - b : b - a);
+  }
+  return width;
+}
+
+static int orderBench(const char *name, const t_shape *shape, const float *input,
+                      float yj, float yj_r, float loss)
+{
+  static const char *names[] = {"shape", "cm", "rows"};
+  int samples = shape->points_n > 10000 ? BENCH_SAMPLES / 16 : BENCH_SAMPLES;
+  std::vector<float> out[3][2];
+  t_counters counters;
+  int ok = 1;
+
+  countersOpen(&counters);
+
+  for (int order = MESH_ORDER_SHAPE; order <= MESH_ORDER_ROWS; ++order) {
+    t_mesh *mesh = compile_mesh(shape, order);
+    void *block = malloc(mesh_state_size(mesh));
+    t_mesh_state state;
+    long long counts[COUNTER_N];
+
+    printf("%-20s %6s %7d %10u %10.1f", name, names[order], shape->points_n,
+           meshBandwidth(shape, mesh), (double) simMisses(mesh));
+
+    for (int best = 0; best < 2; ++best) {
+      t_mesh_cycle_fn cycle = best ? mesh_kernels(MESH_MODEL_DEFAULT)->cycle
+        : mesh_kernel(MESH_KERNEL_SCALAR, MESH_MODEL_DEFAULT);
+      double t0;
+
+      out[order][best].resize(samples);
+      mesh_state_init(mesh, &state, block);
+      countersStart(&counters);
+      t0 = now_ns();
+      for (int k = 0; k < samples; ++k) {
+        out[order][best][k] = cycle(mesh, &state, input[k], yj, yj_r, loss);
+      }
+      double ns = (now_ns() - t0) / samples;
+      countersStop(&counters, counts);
+
+      if (!best) {
+        for (int c = 0; c < COUNTER_N; ++c) {
+          if (counts[c] < 0) {
+            printf(" %10s", "-");
+          }
+          else {
+            printf(" %10.1f", (double) counts[c] / samples);
+          }
+        }
+      }
+      printf(" %10.2f", ns);
+    }
+
+    // renumbering must not change a single output bit
+    if (order != MESH_ORDER_SHAPE) {
+      for (int best = 0; best < 2; ++best) {
+        ok &= memcmp(out[0][best].data(), out[order][best].data(), samples * sizeof(float)) == 0;
+      }
+    }
+    printf(" %6s\n", order != MESH_ORDER_SHAPE ? (ok ? "yes" : "NO") : "");
+
+    free(block);
+    free_mesh(mesh);
+  }
+
+  countersClose(&counters);
+  return !ok;
+}
+
+static int orderBenches(const std::vector<t_bench_unit> &units, const float *input,
+                        float yj, float yj_r, float loss)
+{
+  static const char *picked[] = {"StoneChime3", "SCFrag46"};
+  int failures = 0;
+
+  printf("\njunction order: sim misses per sample with a %d KB LRU cache, hardware\n"
+         "misses per sample for the scalar kernel where available\n",
+         SIM_CACHE_LINES * SIM_LINE_FLOATS * (int) sizeof(float) / 1024);
+  printf("%-20s %6s %7s %10s %10s %10s %10s %10s %10s %6s\n", "unit", "order", "points",
+         "bandwidth", "sim miss", "L1D miss", "LLC miss", "scalar", "best", "ok");
+
+  for (size_t u = 0; u < units.size(); ++u) {
+    for (size_t k = 0; k < sizeof(picked) / sizeof(*picked); ++k) {
+      if (strcmp(units[u].name, picked[k]) == 0) {
+        t_shape *shape = calcMesh(units[u].shape_type, units[u].angle, units[u].fragNums);
+        failures += orderBench(units[u].name, shape, input, yj, yj_r, loss);
+        free_shape(shape);
+      }
+    }
+  }
+
+  // where the state no longer fits in cache
+  std::vector<t_point> p = hexDisc(64);
+  t_shape *shape;
+  if (getShape2(0, p.data(), (int) p.size(), &shape) == SHAPE_OK) {
+    failures += orderBench("disc r=64", shape, input, yj, yj_r, loss);
+    free_shape(shape);
+  }
+  return failures;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// every model of one unit struck at a single point: the scalar kernel
+// against the pointer mesh of the same model within BENCH_REF_TOLERANCE,
+// tiled and lanes against scalar exactly, the SIMD kernels within
+// tolerance
+static int modelBench(const t_bench_unit &unit, const float *input, float yj, float yj_r, float loss)
+{
+  t_mesh_entry *entry = acquireMesh(unit.shape_type, unit.angle, unit.fragNums);
+  const t_mesh *mesh = entry->mesh;
+  std::vector<float> before(BENCH_SAMPLES), after(BENCH_SAMPLES), other(BENCH_SAMPLES);
+  void *block = malloc(mesh_state_size(mesh));
+  void *lane_block = malloc(mesh_lanes_size(mesh, 1));
+  int stride = mesh_lanes_stride(1);
+  std::vector<float> lane_in(stride, 0.f), lane_yj(stride, 1.f), lane_yj_r(stride, 1.f),
+    lane_loss(stride, 0.f), lane_out(stride);
+  int failures = 0;
+
+  lane_yj[0] = yj;
+  lane_yj_r[0] = yj_r;
+  lane_loss[0] = loss;
+
+  printf("\n%s, every model\n", unit.name);
+  printf("%-20s %10s", "model", "pointer");
+  for (int kernel = 0; kernel < MESH_KERNEL_N; ++kernel) {
+    printf(" %10s", mesh_kernel_name(kernel));
+  }
+  printf(" %10s %10s %10s %6s\n", "ref err", "max err", "peak", "ok");
+
+  for (int model = 0; model < MESH_MODEL_N; ++model) {
+    const t_mesh_kernels *kernels = mesh_kernels(model);
+    t_mesh_state state;
+    t_mesh_lanes lanes;
+    t_ref_mesh ref;
+    t_mesh_strike single;
+    float worst = 0, ref_err = 1.f, peak = 0;
+    double t0;
+    int ok = 1;
+
+    printf("%-20s", mesh_model_name(model));
+
+    ref_init(&ref, entry->shape, model);
+    benchStrikePoint(&ref, entry->shape, mesh, &single);
+    t0 = now_ns();
+    for (int k = 0; k < BENCH_SAMPLES; ++k) {
+      before[k] = ref_cycle(&ref, input[k], yj, yj_r, loss);
+      peak = fmaxf(peak, fabsf(before[k]));
+    }
+    printf(" %10.2f", (now_ns() - t0) / BENCH_SAMPLES);
+    ref_free(&ref);
+    ok &= allFinite(before.data(), BENCH_SAMPLES);
+
+    for (int kernel = 0; kernel < MESH_KERNEL_N; ++kernel) {
+      t_mesh_cycle_fn cycle = mesh_kernel(kernel, model);
+      float *out = kernel == MESH_KERNEL_SCALAR ? after.data() : other.data();
+
+      if (!cycle) {
+        printf(" %10s", "-");
+        continue;
+      }
+      mesh_state_init(mesh, &state, block);
+      state.strike = &single;
+      t0 = now_ns();
+      for (int k = 0; k < BENCH_SAMPLES; ++k) {
+        out[k] = cycle(mesh, &state, input[k], yj, yj_r, loss);
+      }
+      printf(" %10.2f", (now_ns() - t0) / BENCH_SAMPLES);
+
+      ok &= allFinite(out, BENCH_SAMPLES);
+      if (kernel == MESH_KERNEL_SCALAR) {
+        ref_err = relError(before.data(), after.data(), BENCH_SAMPLES);
+      }
+      else {
+        worst = fmaxf(worst, relError(after.data(), other.data(), BENCH_SAMPLES));
+      }
+    }
+
+    mesh_state_init(mesh, &state, block);
+    state.strike = &single;
+    for (int k = 0; k < BENCH_SAMPLES; k += BENCH_BLOCK) {
+      kernels->tiled(mesh, &state, &input[k], &other[k], BENCH_BLOCK, yj, yj_r, loss);
+    }
+    ok &= memcmp(after.data(), other.data(), BENCH_SAMPLES * sizeof(float)) == 0;
+
+    mesh_lanes_init(mesh, &lanes, 1, lane_block);
+    lanes.strike = &single;
+    for (int k = 0; k < BENCH_SAMPLES; ++k) {
+      lane_in[0] = input[k];
+      kernels->lanes(mesh, &lanes, lane_in.data(), lane_yj.data(), lane_yj_r.data(),
+                     lane_loss.data(), lane_out.data());
+      other[k] = lane_out[0];
+    }
+    ok &= memcmp(after.data(), other.data(), BENCH_SAMPLES * sizeof(float)) == 0;
+
+    // a mesh without lines is not struck and must stay silent
+    ok &= ref_err <= BENCH_REF_TOLERANCE && worst <= MESH_SIMD_TOLERANCE
+      && (peak > 0.f || entry->shape->lines_n == 0);
+    failures += !ok;
+    printf(" %10.2g %10.2g %10.3g %6s\n", ref_err, worst, peak, ok ? "yes" : "NO");
+  }
+
+  free(lane_block);
+  free(block);
+  releaseMesh(entry);
+  return failures;
+}
+
+// the model inputs the UGens may be given: ids truncate, everything else
+// is refused, and the kernel tables fall back to the default for it
+static int modelIdBench()
+{
+  const float inputs[] = {0.f, 2.5f, 7.f, 7.99f, -0.5f, -1.f, 8.f, 1e10f, -1e10f, NAN, INFINITY};
+  const int expect[] = {0, 2, 7, 7, -1, -1, -1, -1, -1, -1, -1};
+  int failures = 0;
+
+  printf("\nmodel inputs\n%-12s %6s %6s\n", "input", "model", "ok");
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+    int model = mesh_model_of(inputs[i]);
+    int ok = model == expect[i];
+
+    if (model < 0) {
+      ok &= mesh_kernels(model) == mesh_kernels(MESH_MODEL_DEFAULT)
+        && stencil_kernel(model) == stencil_kernel(MESH_MODEL_DEFAULT)
+        && kmesh_kernel(model) == kmesh_kernel(MESH_MODEL_DEFAULT);
+    }
+    failures += !ok;
+    printf("%-12g %6d %6s\n", inputs[i], model, ok ? "yes" : "NO");
+  }
+  return failures;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// the stencil against the compiled mesh: every stencil kernel of the default
+// model, then the scalar one for every model, within STENCIL_TOLERANCE of
+// the scalar mesh kernel
+static int stencilBench(const char *name, const t_shape *shape, const float *input,
+                        float yj, float yj_r, float loss)
+{
+  int samples = shape->points_n > 10000 ? BENCH_SAMPLES / 16 : BENCH_SAMPLES;
+  t_mesh *mesh = compile_mesh(shape, MESH_ORDER_DEFAULT);
+  t_stencil *stencil = compile_stencil(shape);
+  std::vector<float> ref(samples), out(samples);
+  void *block = malloc(mesh_state_size(mesh));
+  void *stencil_block = malloc(stencil_state_size(stencil));
+  t_mesh_state state;
+  t_stencil_state stencil_state;
+  float worst = 0;
+  double t0;
+
+  printf("%-20s %7d %6.1f%% %4s", name, shape->points_n,
+         100.0 * stencil->interior_n / stencil->points_n, stencil_use(stencil) ? "yes" : "no");
+
+  for (int model = 0; model < MESH_MODEL_N; ++model) {
+    int kernels = model == MESH_MODEL_DEFAULT ? MESH_KERNEL_N : 1;
+
+    mesh_state_init(mesh, &state, block);
+    t0 = now_ns();
+    for (int k = 0; k < samples; ++k) {
+      ref[k] = mesh_kernel(MESH_KERNEL_SCALAR, model)(mesh, &state, input[k], yj, yj_r, loss);
+    }
+    double scalar_ns = (now_ns() - t0) / samples;
+
+    if (model == MESH_MODEL_DEFAULT) {
+      mesh_state_init(mesh, &state, block);
+      t0 = now_ns();
+      for (int k = 0; k < samples; ++k) {
+        out[k] = mesh_kernels(model)->cycle(mesh, &state, input[k], yj, yj_r, loss);
+      }
+      printf(" %10.2f %10.2f", scalar_ns, (now_ns() - t0) / samples);
+    }
+
+    for (int kernel = 0; kernel < kernels; ++kernel) {
+      t_stencil_cycle_fn cycle = stencil_kernel_isa(kernel, model);
+
+      if (!cycle) {
+        printf(" %10s", "-");
+        continue;
+      }
+      stencil_state_init(stencil, &stencil_state, stencil_block);
+      t0 = now_ns();
+      for (int k = 0; k < samples; ++k) {
+        out[k] = cycle(stencil, &stencil_state, input[k], yj, yj_r, loss);
+      }
+      if (model == MESH_MODEL_DEFAULT) {
+        printf(" %10.2f", (now_ns() - t0) / samples);
+      }
+      worst = fmaxf(worst, relError(ref.data(), out.data(), samples));
+    }
+  }
+
+  int ok = worst <= STENCIL_TOLERANCE;
+  printf(" %10.2g %6s\n", worst, ok ? "yes" : "NO");
+
+  free(stencil_block);
+  free(block);
+  free_stencil(stencil);
+  free_mesh(mesh);
+  return !ok;
+}
+
+static int stencilBenches(const std::vector<t_bench_unit> &units, const float *input,
+                          float yj, float yj_r, float loss)
+{
+  static const char *picked[] = {"StoneChime3", "SCFrag46"};
+  static const int radii[] = {16, 32, 64, 128};
+  int failures = 0;
+
+  printf("\nstructured stencil against the compiled mesh, ns per sample\n");
+  printf("%-20s %7s %7s %4s %10s %10s", "unit", "points", "inner", "use", "mesh", "mesh best");
+  for (int kernel = 0; kernel < MESH_KERNEL_N; ++kernel) {
+    printf(" %10s", mesh_kernel_name(kernel));
+  }
+  printf(" %10s %6s\n", "max err", "ok");
+
+  for (size_t u = 0; u < units.size(); ++u) {
+    for (size_t k = 0; k < sizeof(picked) / sizeof(*picked); ++k) {
+      if (strcmp(units[u].name, picked[k]) == 0) {
+        t_shape *shape = calcMesh(units[u].shape_type, units[u].angle, units[u].fragNums);
+        failures += stencilBench(units[u].name, shape, input, yj, yj_r, loss);
+        free_shape(shape);
+      }
+    }
+  }
+
+  for (size_t r = 0; r < sizeof(radii) / sizeof(*radii); ++r) {
+    std::vector<t_point> p = hexDisc(radii[r]);
+    char name[32];
+    t_shape *shape;
+
+    snprintf(name, sizeof(name), "disc r=%d", radii[r]);
+    if (getShape2(0, p.data(), (int) p.size(), &shape) == SHAPE_OK) {
+      failures += stencilBench(name, shape, input, yj, yj_r, loss);
+      free_shape(shape);
+    }
+  }
+  return failures;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// the K-variable engine against the W-variable mesh: every model within
+// KMESH_TOLERANCE of mesh_cycle(), and the default model's cost per voice
+static int kmeshBench(const char *name, const t_shape *shape, const float *input,
+                      float yj, float yj_r, float loss)
+{
+  int samples = shape->points_n > 10000 ? BENCH_SAMPLES / 16 : BENCH_SAMPLES;
+  t_mesh *mesh = compile_mesh(shape, MESH_ORDER_DEFAULT);
+  t_kmesh *kmesh = compile_kmesh(shape, MESH_ORDER_DEFAULT);
+  std::vector<float> ref(samples), out(samples);
+  void *block = malloc(mesh_state_size(mesh));
+  void *kmesh_block = malloc(kmesh_state_size(kmesh));
+  t_mesh_state state;
+  t_kmesh_state kmesh_state;
+  double mesh_ns = 0, best_ns = 0, kmesh_ns = 0;
+  float worst = 0;
+
+  for (int model = 0; model < MESH_MODEL_N; ++model) {
+    t_kmesh_cycle_fn cycle = kmesh_kernel(model);
+    double t0;
+
+    mesh_state_init(mesh, &state, block);
+    t0 = now_ns();
+    for (int k = 0; k < samples; ++k) {
+      ref[k] = mesh_kernel(MESH_KERNEL_SCALAR, model)(mesh, &state, input[k], yj, yj_r, loss);
+    }
+    if (model == MESH_MODEL_DEFAULT) {
+      mesh_ns = (now_ns() - t0) / samples;
+
+      mesh_state_init(mesh, &state, block);
+      t0 = now_ns();
+      for (int k = 0; k < samples; ++k) {
+        out[k] = mesh_kernels(model)->cycle(mesh, &state, input[k], yj, yj_r, loss);
+      }
+      best_ns = (now_ns() - t0) / samples;
+    }
+
+    kmesh_state_init(kmesh, &kmesh_state, kmesh_block);
+    t0 = now_ns();
+    for (int k = 0; k < samples; ++k) {
+      out[k] = cycle(kmesh, &kmesh_state, input[k], yj_r, loss);
+    }
+    if (model == MESH_MODEL_DEFAULT) {
+      kmesh_ns = (now_ns() - t0) / samples;
+    }
+    worst = fmaxf(worst, relError(ref.data(), out.data(), samples));
+  }
+
+  int ok = worst <= KMESH_TOLERANCE;
+  printf("%-20s %7d %10zu %10zu %10.2f %10.2f %10.2f %10.2g %6s\n", name, shape->points_n,
+         mesh_state_size(mesh), kmesh_state_size(kmesh), mesh_ns, best_ns, kmesh_ns,
+         worst, ok ? "yes" : "NO");
+
+  free(kmesh_block);
+  free(block);
+  free_kmesh(kmesh);
+  free_mesh(mesh);
+  return !ok;
+}
+
+static int kmeshBenches(const std::vector<t_bench_unit> &units, const float *input,
+                        float yj, float yj_r, float loss)
+{
+  static const char *picked[] = {"StoneChime3", "SCFrag46", "VarMembraneHexagon"};
+  static const int radii[] = {32, 64, 128};
+  int failures = 0;
+
+  printf("\nK-variable engine against the W-variable mesh, state bytes per voice and\n"
+         "ns per sample\n");
+  printf("%-20s %7s %10s %10s %10s %10s %10s %10s %6s\n", "unit", "points", "W bytes",
+         "K bytes", "W scalar", "W best", "K", "max err", "ok");
+
+  for (size_t u = 0; u < units.size(); ++u) {
+    for (size_t k = 0; k < sizeof(picked) / sizeof(*picked); ++k) {
+      if (strcmp(units[u].name, picked[k]) == 0) {
+        t_shape *shape = calcMesh(units[u].shape_type, units[u].angle, units[u].fragNums);
+        failures += kmeshBench(units[u].name, shape, input, yj, yj_r, loss);
+        free_shape(shape);
+      }
+    }
+  }
+
+  for (size_t r = 0; r < sizeof(radii) / sizeof(*radii); ++r) {
+    std::vector<t_point> p = hexDisc(radii[r]);
+    char name[32];
+    t_shape *shape;
+
+    snprintf(name, sizeof(name), "disc r=%d", radii[r]);
+    if (getShape2(0, p.data(), (int) p.size(), &shape) == SHAPE_OK) {
+      failures += kmeshBench(name, shape, input, yj, yj_r, loss);
+      free_shape(shape);
+    }
+  }
+  return failures;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// the partitioned convolution of the default model's impulse response
+// against the mesh itself, within CONV_TOLERANCE. the response is rendered
+// as long as the comparison, so only rounding and the cut tail differ
+static int convBench(const char *name, const t_shape *shape, const float *input,
+                     float yj, float yj_r, float loss)
+{
+  int samples = shape->points_n > 10000 ? BENCH_SAMPLES / 16 : BENCH_SAMPLES;
+  t_mesh *mesh = compile_mesh(shape, MESH_ORDER_DEFAULT);
+  std::vector<float> ref(samples), out(samples), ir(samples);
+  void *block = malloc(mesh_state_size(mesh));
+  t_mesh_state state;
+  double t0;
+
+  mesh_state_init(mesh, &state, block);
+  t0 = now_ns();
+  for (int k = 0; k < samples; ++k) {
+    ref[k] = mesh_kernels(MESH_MODEL_DEFAULT)->cycle(mesh, &state, input[k], yj, yj_r, loss);
+  }
+  double mesh_ns = (now_ns() - t0) / samples;
+
+  t0 = now_ns();
+  uint32_t length = conv_render(mesh, MESH_MODEL_DEFAULT, yj, loss, ir.data(), samples);
+  t_conv *conv = compile_conv(ir.data(), length);
+  double build_ms = (now_ns() - t0) / 1e6;
+
+  t_conv_state conv_state;
+  void *conv_block = malloc(conv_state_size(conv));
+  conv_state_init(conv, &conv_state, conv_block);
+  t0 = now_ns();
+  for (int k = 0; k < samples; k += BENCH_BLOCK) {
+    conv_run(conv, &conv_state, &input[k], &out[k], std::min(BENCH_BLOCK, samples - k));
+  }
+  double conv_ns = (now_ns() - t0) / samples;
+
+  float err = relError(ref.data(), out.data(), samples);
+  int ok = err <= CONV_TOLERANCE;
+  printf("%-20s %7d %8u %6u %10zu %10.1f %10.2f %10.2f %10.2g %6s\n", name, shape->points_n,
+         length, conv->levels_n, conv_state_size(conv), build_ms, mesh_ns, conv_ns, err,
+         ok ? "yes" : "NO");
+
+  free(conv_block);
+  free_conv(conv);
+  free(block);
+  free_mesh(mesh);
+  return !ok;
+}
+
+static int convBenches(const std::vector<t_bench_unit> &units, const float *input,
+                       float yj, float yj_r, float loss)
+{
+  static const char *picked[] = {"StoneChime3", "SCFrag46", "VarMembraneHexagon"};
+  static const int radii[] = {32, 64};
+  int failures = 0;
+
+  printf("\npartitioned convolution of the impulse response against the mesh, state\n"
+         "bytes per voice, ms to render and compile, ns per sample\n");
+  printf("%-20s %7s %8s %6s %10s %10s %10s %10s %10s %6s\n", "unit", "points", "taps", "levels",
+         "bytes", "build ms", "mesh best", "conv", "max err", "ok");
+
+  for (size_t u = 0; u < units.size(); ++u) {
+    for (size_t k = 0; k < sizeof(picked) / sizeof(*picked); ++k) {
+      if (strcmp(units[u].name, picked[k]) == 0) {
+        t_shape *shape = calcMesh(units[u].shape_type, units[u].angle, units[u].fragNums);
+        failures += convBench(units[u].name, shape, input, yj, yj_r, loss);
+        free_shape(shape);
+      }
+    }
+  }
+
+  for (size_t r = 0; r < sizeof(radii) / sizeof(*radii); ++r) {
+    std::vector<t_point> p = hexDisc(radii[r]);
+    char name[32];
+    t_shape *shape;
+
+    snprintf(name, sizeof(name), "disc r=%d", radii[r]);
+    if (getShape2(0, p.data(), (int) p.size(), &shape) == SHAPE_OK) {
+      failures += convBench(name, shape, input, yj, yj_r, loss);
+      free_shape(shape);
+    }
+  }
+  return failures;
+}
+
+// one mesh, and its stencil when that pays off, built and as mapped from
+// the file: identical output to the bit
+static int meshfileBench(const char *name, const t_shape *built_shape, double build_ms,
+                         const t_meshfile_item *item, const float *input, float yj, float yj_r,
+                         float loss)
+{
+  int samples = BENCH_SAMPLES / 8;
+  t_mesh *mesh = compile_mesh(built_shape, MESH_ORDER_DEFAULT);
+  t_stencil *stencil = item->stencil ? compile_stencil(built_shape) : NULL;
+  std::vector<float> built(samples), mapped(samples);
+  int same = 1;
+
+  for (int run = 0; run < 2; ++run) {
+    const t_mesh *m = run ? item->mesh : mesh;
+    const t_stencil *st = run ? item->stencil : stencil;
+    float *out = run ? mapped.data() : built.data();
+    void *block = malloc(st ? stencil_state_size(st) : mesh_state_size(m));
+
+    if (st) {
+      t_stencil_state state;
+      stencil_state_init(st, &state, block);
+      for (int k = 0; k < samples; ++k) {
+        out[k] = stencil_kernel(MESH_MODEL_DEFAULT)(st, &state, input[k], yj, yj_r, loss);
+      }
+    }
+    else {
+      t_mesh_state state;
+      mesh_state_init(m, &state, block);
+      for (int k = 0; k < samples; ++k) {
+        out[k] = mesh_kernels(MESH_MODEL_DEFAULT)->cycle(m, &state, input[k], yj, yj_r, loss);
+      }
+    }
+    free(block);
+  }
+  same = memcmp(built.data(), mapped.data(), samples * sizeof(float)) == 0
+    && item->shape->points_n == built_shape->points_n
+    && item->shape->lines_n == built_shape->lines_n;
+
+  printf("%-20s %7d %8s %10.2f %6s\n", name, built_shape->points_n, item->stencil ? "yes" : "no",
+         build_ms, same ? "yes" : "NO");
+
+  if (stencil) {
+    free_stencil(stencil);
+  }
+  free_mesh(mesh);
+  return !same;
+}
+
+// every word of a mesh file damaged in turn, all bits flipped and one
+// added: each copy must be refused or, if it still maps, play without
+// reading or writing outside its arrays
+static int meshfileDamage(const char *path, const float *input, float yj, float yj_r, float loss)
+{
+  std::vector<uint32_t> words;
+  const char *damaged = "MembraneBench.damaged.meshes";
+  FILE *in = fopen(path, "rb");
+  uint32_t word;
+  int tried = 0, refused = 0;
+
+  while (in && fread(&word, sizeof(word), 1, in) == 1) {
+    words.push_back(word);
+  }
+  if (in) {
+    fclose(in);
+  }
+
+  // every refusal is reported on stdout, keep them out of the table
+  fflush(stdout);
+  int saved = dup(1);
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, 1);
+  close(null);
+
+  // the header is checked whole, start past it
+  for (size_t w = 8; w < words.size(); ++w) {
+    for (int change = 0; change < 2; ++change) {
+      std::vector<uint32_t> copy(words);
+      copy[w] = change ? copy[w] + 1 : ~copy[w];
+
+      FILE *out = fopen(damaged, "wb");
+      if (!out) {
+        break;
+      }
+      fwrite(copy.data(), sizeof(uint32_t), copy.size(), out);
+      fclose(out);
+
+      tried++;
+      t_meshfile *file = meshfile_open(damaged);
+      if (!file) {
+        refused++;
+        continue;
+      }
+      for (uint32_t i = 0; i < meshfile_count(file); ++i) {
+        const t_meshfile_item *item = meshfile_item(file, i);
+        void *block = malloc(mesh_state_size(item->mesh));
+        t_mesh_state state;
+        std::vector<float> out_samples(BENCH_BLOCK);
+
+        mesh_state_init(item->mesh, &state, block);
+        for (int k = 0; k < BENCH_BLOCK; ++k) {
+          mesh_kernels(MESH_MODEL_DEFAULT)->cycle(item->mesh, &state, input[k], yj, yj_r, loss);
+        }
+        mesh_kernels(MESH_MODEL_DEFAULT)->tiled(item->mesh, &state, input, out_samples.data(),
+                                                BENCH_BLOCK, yj, yj_r, loss);
+        free(block);
+
+        if (item->stencil) {
+          t_stencil_state stencil_state;
+          block = malloc(stencil_state_size(item->stencil));
+          stencil_state_init(item->stencil, &stencil_state, block);
+          for (int k = 0; k < BENCH_BLOCK; ++k) {
+            stencil_kernel(MESH_MODEL_DEFAULT)(item->stencil, &stencil_state, input[k], yj, yj_r,
+                                               loss);
+          }
+          free(block);
+        }
+      }
+      meshfile_close(file);
+    }
+  }
+  remove(damaged);
+  fflush(stdout);
+  dup2(saved, 1);
+  close(saved);
+
+  printf("%d damaged copies, %d refused, the rest played\n", tried, refused);
+  return 0;
+}
+
+static int meshfileBenches(const std::vector<t_bench_unit> &units, const float *input,
+                           float yj, float yj_r, float loss)
+{
+  static const char *picked[] = {"StoneChime3", "SCFrag46", "VarMembraneHexagon"};
+  static const int radii[] = {32, 64};
+  std::vector<std::string> names;
+  std::vector<t_shape *> shapes;
+  std::vector<double> build_ms;
+  std::vector<t_meshfile_item> items;
+  const char *path = "MembraneBench.meshes";
+  int failures = 0;
+
+  for (size_t u = 0; u < units.size(); ++u) {
+    for (size_t k = 0; k < sizeof(picked) / sizeof(*picked); ++k) {
+      if (strcmp(units[u].name, picked[k]) == 0) {
+        names.push_back(units[u].name);
+        shapes.push_back(calcMesh(units[u].shape_type, units[u].angle, units[u].fragNums));
+      }
+    }
+  }
+  for (size_t r = 0; r < sizeof(radii) / sizeof(*radii); ++r) {
+    std::vector<t_point> p = hexDisc(radii[r]);
+    char name[32];
+    t_shape *shape;
+
+    snprintf(name, sizeof(name), "disc r=%d", radii[r]);
+    if (getShape2(0, p.data(), (int) p.size(), &shape) == SHAPE_OK) {
+      names.push_back(name);
+      shapes.push_back(shape);
+    }
+  }
+
+  // compiled the way acquireMesh() does, timed from the points up
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    t_meshfile_item item;
+    double t0 = now_ns();
+    t_shape *rebuilt = shapes[i];
+
+    item.shape_type = 0;
+    item.angle = 0;
+    item.frag = (int) i;
+    item.shape = rebuilt;
+    item.mesh = compile_mesh(rebuilt, MESH_ORDER_DEFAULT);
+    item.stencil = compile_stencil(rebuilt);
+    if (item.stencil && !stencil_use(item.stencil)) {
+      free_stencil(item.stencil);
+      item.stencil = NULL;
+    }
+    build_ms.push_back((now_ns() - t0) / 1e6);
+    items.push_back(item);
+  }
+
+  printf("\nmeshes written to a mesh file and mapped back, against the built ones;\n"
+         "ms to compile each\n");
+  printf("%-20s %7s %8s %10s %6s\n", "unit", "points", "stencil", "build ms", "same");
+
+  if (!meshfile_write(path, items.data(), items.size())) {
+    return 1;
+  }
+  double t0 = now_ns();
+  t_meshfile *file = meshfile_open(path);
+  double map_us = (now_ns() - t0) / 1e3;
+
+  if (!file || meshfile_count(file) != items.size()) {
+    printf("cannot map %s back\n", path);
+    failures++;
+  }
+  for (size_t i = 0; file && i < items.size(); ++i) {
+    failures += meshfileBench(names[i].c_str(), shapes[i], build_ms[i], meshfile_item(file, i),
+                              input, yj, yj_r, loss);
+  }
+  if (file) {
+    printf("%u meshes, %zu bytes, mapped in %.1f us\n", meshfile_count(file), meshfile_size(file),
+           map_us);
+    meshfile_close(file);
+  }
+  remove(path);
+
+  // small meshes only, the damage check maps the file once per word: a
+  // chime, and a disc with its stencil whether it pays off or not
+  std::vector<t_point> p = hexDisc(4);
+  t_shape *disc;
+  if (getShape2(0, p.data(), (int) p.size(), &disc) == SHAPE_OK) {
+    t_meshfile_item small[2] = {items[1], items[1]};
+    small[1].shape = disc;
+    small[1].mesh = compile_mesh(disc, MESH_ORDER_DEFAULT);
+    small[1].stencil = compile_stencil(disc);
+    if (meshfile_write(path, small, 2)) {
+      failures += meshfileDamage(path, input, yj, yj_r, loss);
+      remove(path);
+    }
+    free_stencil(small[1].stencil);
+    free_mesh(small[1].mesh);
+    free_shape(disc);
+  }
+
+  for (size_t i = 0; i < items.size(); ++i) {
+    if (items[i].stencil) {
+      free_stencil(items[i].stencil);
+    }
+    free_mesh(items[i].mesh);
+    free_shape(shapes[i]);
+  }
+  return failures;
+}
+
+// pickups around the output junction of shape, read after every cycle of
+// the compiled mesh and of the stencil, for every model. both are struck
+// at BENCH_STRIKE
+#define BENCH_PICKUPS 8
+#define BENCH_STRIKE_X 12.f
+#define BENCH_STRIKE_Y -6.f
+
+static float pickupRun(const t_shape *shape, const t_mesh *mesh, const t_stencil *stencil,
+                       int model, const float *input, int samples, float yj, float yj_r,
+                       float loss, float *out, float *pressures, double *ns)
+{
+  static const float spots[BENCH_PICKUPS][2] = {
+    {0, 0}, {-8, 0}, {8, 0}, {-4, -4}, {4, 4}, {0, -12}, {12, 6}, {-30, 20}
+  };
+  t_mesh_pickup pickups[BENCH_PICKUPS];
+  void *block = malloc(stencil ? stencil_state_size(stencil) : mesh_state_size(mesh));
+  t_mesh_state state;
+  t_stencil_state stencil_state;
+  t_mesh_strike struck;
+  t_stencil_strike stencil_struck;
+
+  if (stencil) {
+    stencil_strike(stencil, shape, BENCH_STRIKE_X, BENCH_STRIKE_Y, &stencil_struck);
+  }
+  else {
+    mesh_strike(mesh, shape, BENCH_STRIKE_X, BENCH_STRIKE_Y, &struck);
+  }
+
+  for (int p = 0; p < BENCH_PICKUPS; ++p) {
+    uint32_t point = mesh_point_near(shape, spots[p][0], spots[p][1]);
+    if (stencil) {
+      stencil_pickup(stencil, shape, model, point, &pickups[p]);
+    }
+    else {
+      mesh_pickup(mesh, model, point, &pickups[p]);
+    }
+  }
+
+  // without pickups, then with them
+  for (int run = 0; run < 2; ++run) {
+    if (stencil) {
+      stencil_state_init(stencil, &stencil_state, block);
+      stencil_state.strike = &stencil_struck;
+    }
+    else {
+      mesh_state_init(mesh, &state, block);
+      state.strike = &struck;
+    }
+    double t0 = now_ns();
+    for (int k = 0; k < samples; ++k) {
+      const float *a, *b;
+
+      if (stencil) {
+        out[k] = stencil_kernel(model)(stencil, &stencil_state, input[k], yj, yj_r, loss);
+        a = stencil_state.a;
+        b = stencil_state.b;
+      }
+      else {
+        out[k] = mesh_kernels(model)->cycle(mesh, &state, input[k], yj, yj_r, loss);
+        a = state.a;
+        b = state.b;
+      }
+      for (int p = 0; run && p < BENCH_PICKUPS; ++p) {
+        pressures[p * samples + k] = mesh_pickup_read(&pickups[p], a, b);
+      }
+    }
+    ns[run] = (now_ns() - t0) / samples;
+  }
+  free(block);
+
+  // spot 0 is the output junction itself
+  return relError(out, pressures, samples);
+}
+
+static int pickupBench(const char *name, const t_shape *shape, const float *input,
+                       float yj, float yj_r, float loss)
+{
+  int samples = shape->points_n > 10000 ? BENCH_SAMPLES / 16 : BENCH_SAMPLES / 4;
+  t_mesh *mesh = compile_mesh(shape, MESH_ORDER_DEFAULT);
+  t_stencil *stencil = compile_stencil(shape);
+  std::vector<float> out(samples), pressures(samples * BENCH_PICKUPS),
+    stencil_pressures(samples * BENCH_PICKUPS);
+  float out_err = 0, stencil_err = 0;
+  double mesh_ns[2] = {0, 0}, stencil_ns[2] = {0, 0};
+
+  for (int model = 0; model < MESH_MODEL_N; ++model) {
+    double ns[2];
+
+    out_err = fmaxf(out_err, pickupRun(shape, mesh, NULL, model, input, samples, yj, yj_r, loss,
+                                       out.data(), pressures.data(), ns));
+    if (model == MESH_MODEL_DEFAULT) {
+      mesh_ns[0] = ns[0];
+      mesh_ns[1] = ns[1];
+    }
+    if (!stencil_use(stencil)) {
+      continue;
+    }
+    out_err = fmaxf(out_err, pickupRun(shape, mesh, stencil, model, input, samples, yj, yj_r,
+                                       loss, out.data(), stencil_pressures.data(), ns));
+    for (int p = 0; p < BENCH_PICKUPS; ++p) {
+      stencil_err = fmaxf(stencil_err, relError(&pressures[p * samples],
+                                                &stencil_pressures[p * samples], samples));
+    }
+    if (model == MESH_MODEL_DEFAULT) {
+      stencil_ns[0] = ns[0];
+      stencil_ns[1] = ns[1];
+    }
+  }
+
+  int ok = out_err <= MESH_SIMD_TOLERANCE && stencil_err <= STENCIL_TOLERANCE;
+  printf("%-20s %7d %10.2f %10.2f", name, shape->points_n, mesh_ns[0], mesh_ns[1]);
+  if (stencil_use(stencil)) {
+    printf(" %10.2f %10.2f", stencil_ns[0], stencil_ns[1]);
+  }
+  else {
+    printf(" %10s %10s", "-", "-");
+  }
+  printf(" %10.2g %10.2g %6s\n", out_err, stencil_err, ok ? "yes" : "NO");
+
+  free_stencil(stencil);
+  free_mesh(mesh);
+  return !ok;
+}
+
+static int pickupBenches(const std::vector<t_bench_unit> &units, const float *input,
+                         float yj, float yj_r, float loss)
+{
+  static const char *picked[] = {"StoneChime3", "SCFrag46"};
+  static const int radii[] = {32, 64};
+  int failures = 0;
+
+  printf("\n%d pickups read after every cycle, ns per sample without and with them;\n"
+         "the output pickup against the kernel, the stencil's against the mesh's,\n"
+         "struck at (%g, %g)\n", BENCH_PICKUPS, BENCH_STRIKE_X, BENCH_STRIKE_Y);
+  printf("%-20s %7s %10s %10s %10s %10s %10s %10s %6s\n", "unit", "points", "mesh", "+pickups",
+         "stencil", "+pickups", "out err", "sten err", "ok");
+
+  for (size_t u = 0; u < units.size(); ++u) {
+    for (size_t k = 0; k < sizeof(picked) / sizeof(*picked); ++k) {
+      if (strcmp(units[u].name, picked[k]) == 0) {
+        t_shape *shape = calcMesh(units[u].shape_type, units[u].angle, units[u].fragNums);
+        failures += pickupBench(units[u].name, shape, input, yj, yj_r, loss);
+        free_shape(shape);
+      }
+    }
+  }
+
+  for (size_t r = 0; r < sizeof(radii) / sizeof(*radii); ++r) {
+    std::vector<t_point> p = hexDisc(radii[r]);
+    char name[32];
+    t_shape *shape;
+
+    snprintf(name, sizeof(name), "disc r=%d", radii[r]);
+    if (getShape2(0, p.data(), (int) p.size(), &shape) == SHAPE_OK) {
+      failures += pickupBench(name, shape, input, yj, yj_r, loss);
+      free_shape(shape);
+    }
+  }
+  return failures;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// every registered unit struck with its whole footprint, at the mesh's
+// default point and at BENCH_STRIKE: the scalar kernel against the pointer
+// mesh taking the same weights inside its junction loop
+static int strikeBenches(const std::vector<t_bench_unit> &units, const float *input,
+                         float yj, float yj_r, float loss)
+{
+  std::vector<float> before(BENCH_SAMPLES), after(BENCH_SAMPLES);
+  int failures = 0;
+
+  printf("\nthe strike footprint against the pointer mesh struck at the same junctions,\n"
+         "at the default point and at (%g, %g)\n", BENCH_STRIKE_X, BENCH_STRIKE_Y);
+  printf("%-20s %7s %10s %7s %10s %6s\n", "unit", "struck", "err", "struck", "err", "ok");
+
+  for (size_t u = 0; u < units.size(); ++u) {
+    t_mesh_entry *entry = acquireMesh(units[u].shape_type, units[u].angle, units[u].fragNums);
+    const t_shape *shape = entry->shape;
+    void *block = malloc(mesh_state_size(entry->mesh));
+    int ok = 1;
+
+    printf("%-20s", units[u].name);
+    for (int at = 0; at < 2; ++at) {
+      uint32_t points[MESH_STRIKE_MAX];
+      float weights[MESH_STRIKE_MAX];
+      t_mesh_strike strike;
+      t_mesh_state state;
+      t_ref_mesh ref;
+      float x = BENCH_STRIKE_X, y = BENCH_STRIKE_Y;
+
+      if (at == 0) {
+        mesh_strike_default(shape, &x, &y);
+      }
+      uint32_t n = mesh_strike_points(shape, x, y, points, weights);
+      ref_init(&ref, shape, MESH_MODEL_DEFAULT);
+      ref_strike(&ref, points, weights, n);
+
+      // the default point as compile_mesh() placed it
+      mesh_state_init(entry->mesh, &state, block);
+      if (at == 1) {
+        mesh_strike(entry->mesh, shape, x, y, &strike);
+        state.strike = &strike;
+      }
+
+      for (int k = 0; k < BENCH_SAMPLES; ++k) {
+        before[k] = ref_cycle(&ref, input[k], yj, yj_r, loss);
+        after[k] = mesh_cycle(entry->mesh, &state, input[k], yj, yj_r, loss);
+      }
+      float err = relError(before.data(), after.data(), BENCH_SAMPLES);
+      ok &= state.strike->n == n && err <= BENCH_REF_TOLERANCE;
+      printf(" %7u %10.2g", n, err);
+      ref_free(&ref);
+    }
+    failures += !ok;
+    printf(" %6s\n", ok ? "yes" : "NO");
+
+    free(block);
+    releaseMesh(entry);
+  }
+  return failures;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// bytes the heap has handed out, mapped blocks included; -1 where that
+// cannot be asked
+static long long heapInUse()
+{
+#ifdef __GLIBC__
+  struct mallinfo2 info = mallinfo2();
+  return (long long) (info.uordblks + info.hblkhd);
+#else
+  return -1;
+#endif
+}
+
+static const char *cacheChimes[] = {"StoneChime0", "StoneChime1", "StoneChime2", "StoneChime3"};
+
+// the four chime meshes, then the modes and a second of response of frag
+static int cacheFill(const std::vector<t_bench_unit> &units, const t_bench_unit *frag, float yj,
+                     float loss, t_mesh_entry **meshes, t_modal_entry **modal, t_conv_entry **conv)
+{
+  for (int i = 0; i < 4; ++i) {
+    meshes[i] = NULL;
+    for (size_t u = 0; u < units.size(); ++u) {
+      if (strcmp(units[u].name, cacheChimes[i]) == 0) {
+        meshes[i] = acquireMesh(units[u].shape_type, units[u].angle, units[u].fragNums);
+      }
+    }
+  }
+  *modal = acquireModal(frag->shape_type, frag->angle, frag->fragNums, MESH_MODEL_DEFAULT);
+  *conv = acquireConv(frag->shape_type, frag->angle, frag->fragNums, MESH_MODEL_DEFAULT, yj, loss,
+                      BENCH_RATE);
+  return *modal && *conv && meshes[0] && meshes[1] && meshes[2] && meshes[3];
+}
+
+static int cacheBench(const std::vector<t_bench_unit> &units, float yj, float loss)
+{
+  const t_bench_unit *frag = NULL;
+  t_mesh_entry *meshes[4];
+  t_modal_entry *modal;
+  t_conv_entry *conv;
+  size_t total, idle;
+  int failures = 0;
+
+  for (size_t u = 0; u < units.size(); ++u) {
+    if (strcmp(units[u].name, "SCFrag11") == 0) {
+      frag = &units[u];
+    }
+  }
+
+  printf("\nthe mesh cache, bytes held and idle after each step, and heap bytes\n");
+  printf("%-34s %10s %10s %10s %6s\n", "step", "held", "idle", "heap", "ok");
+
+  // once ahead, so what the heap and the cache's own vectors grow by the
+  // first time is not counted. nothing else may stay cached
+  purgeMeshCache();
+  if (cacheFill(units, frag, yj, loss, meshes, &modal, &conv)) {
+    for (int i = 0; i < 4; ++i) {
+      releaseMesh(meshes[i]);
+    }
+    releaseModal(modal);
+    releaseConv(conv);
+  }
+  purgeMeshCache();
+  long long heap = heapInUse();
+
+  if (!cacheFill(units, frag, yj, loss, meshes, &modal, &conv)) {
+    printf("cannot fill the cache\n");
+    return 1;
+  }
+  total = meshCacheBytes(&idle);
+  int ok = total > 0 && idle == 0;
+  printf("%-34s %10zu %10zu %10lld %6s\n", "acquired", total, idle, heapInUse() - heap,
+         ok ? "yes" : "NO");
+  failures += !ok;
+  size_t held = total;
+
+  // a response is shared by nearly the same settings, not by others
+  t_conv_entry *near = tryAcquireConv(frag->shape_type, frag->angle, frag->fragNums,
+                                      MESH_MODEL_DEFAULT, yj * 1.001f, 1.f - (1.f - loss) * 1.001f,
+                                      BENCH_RATE - 100);
+  t_conv_entry *far = tryAcquireConv(frag->shape_type, frag->angle, frag->fragNums,
+                                     MESH_MODEL_DEFAULT, yj * 1.1f, loss, BENCH_RATE);
+  ok = near == conv && !far;
+  printf("%-34s %10zu %10zu %10lld %6s\n", "response shared by nearby settings", total, idle,
+         heapInUse() - heap, ok ? "yes" : "NO");
+  failures += !ok;
+  if (near) {
+    releaseConv(near);
+  }
+  if (far) {
+    releaseConv(far);
+  }
+
+  // the chimes first, so they are the least recently released
+  int went_idle = 0;
+  for (int i = 0; i < 4; ++i) {
+    went_idle += releaseMesh(meshes[i]);
+  }
+  went_idle += releaseModal(modal);
+  went_idle += releaseConv(conv);
+  size_t kept = modal->bytes + conv->bytes;
+
+  total = meshCacheBytes(&idle);
+  ok = went_idle == 6 && idle > kept && idle < total;
+  printf("%-34s %10zu %10zu %10lld %6s\n", "released", total, idle, heapInUse() - heap,
+         ok ? "yes" : "NO");
+  failures += !ok;
+
+  // room for the modes and the response only: the chimes go, and the
+  // fragment mesh the modes still hold stays
+  int freed = trimMeshCache(kept);
+  total = meshCacheBytes(&idle);
+  t_mesh_entry *gone = tryAcquireMesh(2, 2, 0);
+  t_conv_entry *still = tryAcquireConv(frag->shape_type, frag->angle, frag->fragNums,
+                                       MESH_MODEL_DEFAULT, yj, loss, BENCH_RATE);
+  ok = freed == 4 && idle <= kept && !gone && still;
+  printf("%-34s %10zu %10zu %10lld %6s\n", "trimmed to the modes and response", total, idle,
+         heapInUse() - heap, ok ? "yes" : "NO");
+  failures += !ok;
+  if (gone) {
+    releaseMesh(gone);
+  }
+  if (still) {
+    releaseConv(still);
+  }
+
+  // everything back to the heap, up to what it keeps for itself
+  freed = purgeMeshCache();
+  total = meshCacheBytes(&idle);
+  long long left = heapInUse() - heap;
+  ok = freed == 3 && total == 0 && idle == 0 && left < (long long) held / 16;
+  printf("%-34s %10zu %10zu %10lld %6s\n", "purged", total, idle, left, ok ? "yes" : "NO");
+  failures += !ok;
+
+  return failures;
+}
+
+int main(int argc, char **argv)
+{
+  // default StoneChime parameters
+  float tension = 0.05f;
+  float loss = 0.99999f;
+  float yj = mesh_admittance(tension);
+  float yj_r = 1.0f / yj;
+
+  std::vector<t_bench_unit> units = registeredUnits();
+  std::vector<float> input(BENCH_SAMPLES), before(BENCH_SAMPLES), after(BENCH_SAMPLES),
+    simd(BENCH_SAMPLES);
+  int failures = 0;
+
+  int selected = mesh_select_kernel(MESH_KERNEL_N);
+
+  if (argc > 1 && strcmp(argv[1], "build") == 0) {
+    return buildBench();
+  }
+  if (argc > 1 && strcmp(argv[1], "decay") == 0) {
+    return decayBench(argc > 2 ? atoi(argv[2]) : 60, yj, yj_r, loss);
+  }
+
+  // like the calc functions; decaying modes would otherwise dominate the
+  // modal timings
+  mesh_denormals_flush();
+
+  makeExcitation(input.data(), BENCH_SAMPLES);
+
+  if (argc > 1 && strcmp(argv[1], "stencil") == 0) {
+    return stencilBenches(units, input.data(), yj, yj_r, loss) ? 1 : 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "kmesh") == 0) {
+    return kmeshBenches(units, input.data(), yj, yj_r, loss) ? 1 : 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "conv") == 0) {
+    return convBenches(units, input.data(), yj, yj_r, loss) ? 1 : 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "meshfile") == 0) {
+    return meshfileBenches(units, input.data(), yj, yj_r, loss) ? 1 : 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "pickup") == 0) {
+    return pickupBenches(units, input.data(), yj, yj_r, loss) ? 1 : 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "strike") == 0) {
+    return strikeBenches(units, input.data(), yj, yj_r, loss) ? 1 : 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "cache") == 0) {
+    return cacheBench(units, yj, loss) ? 1 : 0;
+  }
+
+  printf("%-20s %7s %7s %7s %10s", "unit", "points", "lines", "delays", "pointer");
+  for (int kernel = 0; kernel < MESH_KERNEL_N; ++kernel) {
+    printf(" %10s", mesh_kernel_name(kernel));
+  }
+  printf(" %10s %10s %10s %7s %10s %10s %10s %6s\n", "tiled", "lane", "modal", "modes",
+         "modal err", "ref err", "max err", "ok");
+
+  for (size_t u = 0; u < units.size(); ++u) {
+    t_mesh_entry *entry = acquireMesh(units[u].shape_type, units[u].angle, units[u].fragNums);
+    t_ref_mesh ref;
+    t_mesh_strike single;
+    t_mesh_state state;
+    void *block = malloc(mesh_state_size(entry->mesh));
+    double t0, t1;
+    float worst = 0;
+    int ok;
+
+    ref_init(&ref, entry->shape, MESH_MODEL_DEFAULT);
+    benchStrikePoint(&ref, entry->shape, entry->mesh, &single);
+
+    printf("%-20s %7d %7d %7u", units[u].name, entry->shape->points_n, entry->shape->lines_n,
+           entry->mesh->delay_n);
+
+    t0 = now_ns();
+    for (int k = 0; k < BENCH_SAMPLES; ++k) {
+      before[k] = ref_cycle(&ref, input[k], yj, yj_r, loss);
+    }
+    t1 = now_ns();
+    printf(" %10.2f", (t1 - t0) / BENCH_SAMPLES);
+
+    for (int kernel = 0; kernel < MESH_KERNEL_N; ++kernel) {
+      t_mesh_cycle_fn cycle = mesh_kernel(kernel, MESH_MODEL_DEFAULT);
+      float *out = kernel == MESH_KERNEL_SCALAR ? after.data() : simd.data();
+
+      if (!cycle) {
+        printf(" %10s", "-");
+        continue;
+      }
+
+      mesh_state_init(entry->mesh, &state, block);
+      state.strike = &single;
+      t0 = now_ns();
+      for (int k = 0; k < BENCH_SAMPLES; ++k) {
+        out[k] = cycle(entry->mesh, &state, input[k], yj, yj_r, loss);
+      }
+      t1 = now_ns();
+      printf(" %10.2f", (t1 - t0) / BENCH_SAMPLES);
+
+      if (kernel != MESH_KERNEL_SCALAR) {
+        worst = fmaxf(worst, relError(after.data(), simd.data(), BENCH_SAMPLES));
+      }
+    }
+    float ref_err = relError(before.data(), after.data(), BENCH_SAMPLES);
+
+    // temporal blocking, in 64 sample blocks like the server
+    mesh_state_init(entry->mesh, &state, block);
+    state.strike = &single;
+    t0 = now_ns();
+    for (int k = 0; k < BENCH_SAMPLES; k += 64) {
+      mesh_kernels(MESH_MODEL_DEFAULT)->tiled(entry->mesh, &state, &input[k], &simd[k], 64, yj, yj_r, loss);
+    }
+    t1 = now_ns();
+    printf(" %10.2f", (t1 - t0) / BENCH_SAMPLES);
+
+    int tiled_ok = memcmp(after.data(), simd.data(), BENCH_SAMPLES * sizeof(float)) == 0;
+
+    // BENCH_LANES identical voices through the lanes kernel, per voice cost
+    t_mesh_lanes lanes;
+    int stride = mesh_lanes_stride(BENCH_LANES);
+    void *lane_block = malloc(mesh_lanes_size(entry->mesh, BENCH_LANES));
+    std::vector<float> lane_in(stride, 0.f), lane_yj(stride, 1.f), lane_yj_r(stride, 1.f),
+      lane_loss(stride, 0.f), lane_out(stride);
+
+    for (int l = 0; l < BENCH_LANES; ++l) {
+      lane_yj[l] = yj;
+      lane_yj_r[l] = yj_r;
+      lane_loss[l] = loss;
+    }
+    mesh_lanes_init(entry->mesh, &lanes, BENCH_LANES, lane_block);
+    lanes.strike = &single;
+    t0 = now_ns();
+    for (int k = 0; k < BENCH_SAMPLES; ++k) {
+      for (int l = 0; l < BENCH_LANES; ++l) {
+        lane_in[l] = input[k];
+      }
+      mesh_kernels(MESH_MODEL_DEFAULT)->lanes(entry->mesh, &lanes, lane_in.data(), lane_yj.data(),
+                                              lane_yj_r.data(), lane_loss.data(), lane_out.data());
+      simd[k] = lane_out[BENCH_LANES - 1];
+    }
+    t1 = now_ns();
+    printf(" %10.2f", (t1 - t0) / BENCH_SAMPLES / BENCH_LANES);
+    free(lane_block);
+
+    // every mode of the decomposition, against the scalar kernel struck
+    // where the modes are
+    t_modal *modal = compute_modal(entry->mesh, MESH_MODEL_DEFAULT, yj, loss);
+    float modal_err = 1.f;
+    if (modal) {
+      mesh_state_init(entry->mesh, &state, block);
+      for (int k = 0; k < BENCH_SAMPLES; ++k) {
+        before[k] = mesh_cycle(entry->mesh, &state, input[k], yj, yj_r, loss);
+      }
+
+      t_modal_state modes;
+      void *modal_block = malloc(modal_state_size(modal->modes_n));
+      std::vector<float> modal_out(BENCH_SAMPLES);
+
+      modal_state_init(modal, &modes, modal->modes_n, modal_block);
+      t0 = now_ns();
+      for (int k = 0; k < BENCH_SAMPLES; k += 64) {
+        modal_run(&modes, &input[k], &modal_out[k], 64);
+      }
+      t1 = now_ns();
+      modal_err = relError(before.data(), modal_out.data(), BENCH_SAMPLES);
+      printf(" %10.2f %7d %10.2g", (t1 - t0) / BENCH_SAMPLES, modal->modes_n, modal_err);
+      free(modal_block);
+      free_modal(modal);
+    }
+    else {
+      printf(" %10s %7s %10s", "-", "-", "failed");
+    }
+
+    // the scalar kernel must reproduce the pointer mesh to rounding, tiled
+    // and lanes the scalar kernel exactly, SIMD within tolerance
+    int counts_ok = entry->shape->points_n == units[u].points_n
+      && entry->shape->lines_n == units[u].lines_n
+      && entry->shape->edge_n == units[u].edge_n;
+
+    ok = counts_ok
+      && ref_err <= BENCH_REF_TOLERANCE
+      && tiled_ok
+      && memcmp(after.data(), simd.data(), BENCH_SAMPLES * sizeof(float)) == 0
+      && worst <= MESH_SIMD_TOLERANCE
+      && modal_err <= BENCH_MODAL_TOLERANCE;
+    failures += !ok;
+
+    printf(" %10.2g %10.2g %6s\n", ref_err, worst, ok ? "yes" : "NO");
+    if (!counts_ok) {
+      printf("  expected %d points, %d lines, %d edge points; got %d, %d, %d\n",
+             units[u].points_n, units[u].lines_n, units[u].edge_n,
+             entry->shape->points_n, entry->shape->lines_n, entry->shape->edge_n);
+    }
+
+    free(block);
+    ref_free(&ref);
+    releaseMesh(entry);
+  }
+
+  printf("ns per sample (lane: per voice with %d voices), selected kernel: %s\n",
+         BENCH_LANES, mesh_kernel_name(selected));
+
+  failures += orderBenches(units, input.data(), yj, yj_r, loss);
+  failures += modelBench(units[5], input.data(), yj, yj_r, loss);
+  for (size_t u = 0; u < units.size(); ++u) {
+    t_mesh_entry *entry = acquireMesh(units[u].shape_type, units[u].angle, units[u].fragNums);
+    int lone = entry->shape->points_n == 1;
+
+    releaseMesh(entry);
+    if (lone) {
+      failures += modelBench(units[u], input.data(), yj, yj_r, loss);
+    }
+  }
+  failures += modelIdBench();
+  failures += stencilBenches(units, input.data(), yj, yj_r, loss);
+  failures += kmeshBenches(units, input.data(), yj, yj_r, loss);
+  failures += convBenches(units, input.data(), yj, yj_r, loss);
+  failures += meshfileBenches(units, input.data(), yj, yj_r, loss);
+  failures += pickupBenches(units, input.data(), yj, yj_r, loss);
+  failures += cacheBench(units, yj, loss);
+  failures += strikeBenches(units, input.data(), yj, yj_r, loss);
+
+  purgeMeshCache();
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+// Build-time generator of the precompiled mesh file (Membrane_meshfile.h):
+// compiles the mesh of every registered UGen and writes them all.
+//
+//   MembraneMeshGen [path]
+//
+// path defaults to MESHFILE_NAME in the current directory. the file is
+// read back and checked against the meshes it was written from.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "StoneChime.h"
+
+static int sameArray(const void *x, const void *y, size_t bytes)
+{
+  return bytes == 0 || memcmp(x, y, bytes) == 0;
+}
+
+int main(int argc, char **argv)
+{
+  const char *path = argc > 1 ? argv[1] : MESHFILE_NAME;
+  int written = writeMeshFile(path);
+
+  if (!written) {
+    return 1;
+  }
+
+  t_meshfile *file = meshfile_open(path);
+  if (!file) {
+    return 1;
+  }
+
+  // every unit against the item of its cache key
+  int ok = meshfile_count(file) == (uint32_t) written;
+  int meshNum, angle, fragNums;
+  char name[32];
+
+  for (int u = 0; ok && unitAt(u, name, sizeof(name)); ++u) {
+    unitParams(name, &meshNum, &angle, &fragNums);
+
+    t_mesh_entry *entry = acquireMesh(meshNum, angle, fragNums);
+    const t_meshfile_item *item = NULL;
+
+    for (uint32_t i = 0; entry && i < meshfile_count(file); ++i) {
+      const t_meshfile_item *it = meshfile_item(file, i);
+      if (it->shape_type == entry->key.shape_type && it->angle == entry->key.angle
+          && it->frag == entry->key.frag) {
+        item = it;
+      }
+    }
+    ok = item != NULL;
+    if (ok) {
+      const t_mesh *a = item->mesh;
+      const t_mesh *b = entry->mesh;
+
+      ok = a->points_n == b->points_n && a->delay_n == b->delay_n && a->tile_n == b->tile_n
+        && sameArray(a->port_off, b->port_off, (a->points_n * 3 + 1 + a->port_n * 2) * 4)
+        && sameArray(a->ell[1].in, b->ell[1].in,
+                     (a->points_pad * MESH_MAX_PORTS * 2 + a->points_pad) * 4)
+        && sameArray(a->tile_off, b->tile_off, ((a->tile_n + 1) * 2 + a->points_n * 2) * 4)
+        && (item->stencil != NULL) == (entry->stencil != NULL);
+    }
+    if (entry) {
+      releaseMesh(entry);
+    }
+  }
+
+  printf("%u meshes, %zu bytes in %s%s\n", meshfile_count(file), meshfile_size(file), path,
+         ok ? "" : ", DIFFERENT FROM THE BUILT MESHES");
+  meshfile_close(file);
+  purgeMeshCache();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,675 @@
+// Offline renderer for the membrane models, runs outside scsynth on the
+// same core as the plugin. Every job renders one excitation through one
+// mesh into a WAV file, the way the UGen would play it with fixed tension
+// and loss; jobs run in parallel on a worker pool.
+//
+//   MembraneRender [-j threads] [-f jobfile] [setting ...]
+//
+// the settings on the command line make one job, a job file holds one job
+// per line ('#' starts a comment). settings are key=value:
+//
+//   out=FILE.wav       where to write it (32-bit float, mono), required
+//   unit=NAME          a registered UGen, e.g. StoneChime3 or SCFrag12, or
+//   shape=N angle=A frag=F   the VarMembrane_init() arguments directly
+//   tension=0.05 loss=0.99999 model=7   as the UGen inputs
+//   engine=mesh        or kmesh, the K-variable form (Membrane_kmesh.h),
+//                      which no UGen plays yet
+//   in=FILE.wav        excitation, first channel, at its own sample rate;
+//   in=strike          or the trigger's noise burst (the default)
+//   at=X,Y             where the mesh is struck, as the UGens' strike input
+//   seed=1             for the strike
+//   rate=48000         sample rate of a strike
+//   tail=4             seconds rendered after the excitation ends
+//   gain=1
+//
+// a throughput report follows, with the realtime factor of each job and
+// over all jobs per core.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "StoneChime.h"
+
+#define RENDER_BLOCK 64
+
+typedef struct {
+  int line; // in the job file, 0 for the command line
+  std::string out;
+  std::string in;
+  int shape_type;
+  float angle;
+  int fragNums;
+  float tension;
+  float loss;
+  int model;
+  int kmesh;  // engine=kmesh
+  unsigned int seed;
+  int rate;
+  float tail;
+  float gain;
+  int at;     // strike at at_x, at_y instead of the mesh's own point
+  float at_x;
+  float at_y;
+
+  // results
+  int ok;
+  std::string error;
+  uint32_t points_n;
+  double seconds; // of audio
+  double ms;      // to render it
+} t_job;
+
+static double now_ms()
+{
+  return std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+////////////////////////////////////////////////////////////////////
+
+static uint32_t getLE(const unsigned char *p, int bytes)
+{
+  uint32_t v = 0;
+  for (int i = bytes - 1; i >= 0; --i) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+static void putLE(FILE *f, uint32_t v, int bytes)
+{
+  for (int i = 0; i < bytes; ++i) {
+    fputc((v >> (8 * i)) & 0xff, f);
+  }
+}
+
+// the first channel of a PCM (8 to 32 bit) or float WAV file
+static int readWav(const char *path, std::vector<float> &samples, int *rate, std::string &error)
+{
+  FILE *f = fopen(path, "rb");
+  std::vector<unsigned char> file;
+
+  if (!f) {
+    error = std::string("cannot open ") + path;
+    return 0;
+  }
+  unsigned char buf[65536];
+  size_t got;
+  while ((got = fread(buf, 1, sizeof(buf), f)) > 0) {
+    file.insert(file.end(), buf, buf + got);
+  }
+  fclose(f);
+
+  if (file.size() < 12 || memcmp(&file[0], "RIFF", 4) != 0 || memcmp(&file[8], "WAVE", 4) != 0) {
+    error = std::string(path) + " is not a WAV file";
+    return 0;
+  }
+
+  int format = 0, channels = 0, bits = 0;
+  const unsigned char *data = NULL;
+  size_t data_n = 0;
+
+  for (size_t pos = 12; pos + 8 <= file.size();) {
+    const unsigned char *chunk = &file[pos];
+    size_t size = getLE(chunk + 4, 4);
+    size_t avail = std::min(size, file.size() - pos - 8);
+
+    if (memcmp(chunk, "fmt ", 4) == 0 && avail >= 16) {
+      format = (int) getLE(chunk + 8, 2);
+      channels = (int) getLE(chunk + 10, 2);
+      *rate = (int) getLE(chunk + 12, 4);
+      bits = (int) getLE(chunk + 22, 2);
+      if (format == 0xfffe && avail >= 26) {
+        // WAVE_FORMAT_EXTENSIBLE, the format is the start of the subformat
+        format = (int) getLE(chunk + 32, 2);
+      }
+    }
+    else if (memcmp(chunk, "data", 4) == 0) {
+      data = chunk + 8;
+      data_n = avail;
+    }
+    pos += 8 + size + (size & 1);
+  }
+
+  int bytes = bits / 8;
+  int supported = (format == 1 && bits >= 8 && bits <= 32 && bits % 8 == 0)
+    || (format == 3 && (bits == 32 || bits == 64));
+
+  if (!data || channels < 1 || *rate <= 0 || !supported) {
+    error = std::string(path) + ": unsupported WAV format";
+    return 0;
+  }
+
+  size_t frames = data_n / (bytes * channels);
+  samples.resize(frames);
+  for (size_t k = 0; k < frames; ++k) {
+    const unsigned char *p = data + k * bytes * channels;
+    uint32_t v = getLE(p, bytes);
+
+    if (format == 3 && bits == 32) {
+      float x;
+      memcpy(&x, &v, sizeof(x));
+      samples[k] = x;
+    }
+    else if (format == 3) {
+      uint64_t w = ((uint64_t) getLE(p + 4, 4) << 32) | v;
+      double x;
+      memcpy(&x, &w, sizeof(x));
+      samples[k] = (float) x;
+    }
+    else if (bits == 8) {
+      samples[k] = ((int) v - 128) / 128.f;
+    }
+    else {
+      // sign extend from the top bit
+      int32_t s = (int32_t) (v << (32 - bits));
+      samples[k] = (float) (s / 2147483648.0);
+    }
+  }
+  return 1;
+}
+
+static int writeWav(const char *path, const std::vector<float> &samples, int rate)
+{
+  FILE *f = fopen(path, "wb");
+  uint32_t data_n = (uint32_t) (samples.size() * sizeof(float));
+
+  if (!f) {
+    return 0;
+  }
+  fwrite("RIFF", 1, 4, f);
+  putLE(f, 36 + data_n, 4);
+  fwrite("WAVEfmt ", 1, 8, f);
+  putLE(f, 16, 4);
+  putLE(f, 3, 2); // IEEE float
+  putLE(f, 1, 2);
+  putLE(f, rate, 4);
+  putLE(f, rate * sizeof(float), 4);
+  putLE(f, sizeof(float), 2);
+  putLE(f, 32, 2);
+  fwrite("data", 1, 4, f);
+  putLE(f, data_n, 4);
+  for (size_t k = 0; k < samples.size(); ++k) {
+    uint32_t v;
+    memcpy(&v, &samples[k], sizeof(v));
+    putLE(f, v, 4);
+  }
+  return fclose(f) == 0;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// the trigger's noise burst, from a generator of its own so that every
+// job is reproducible whichever thread runs it
+static void makeStrike(std::vector<float> &samples, unsigned int seed)
+{
+  uint32_t state = seed;
+
+  samples.resize(MESH_TRIGGER_DURATION);
+  for (int k = 0; k < MESH_TRIGGER_DURATION; ++k) {
+    state = state * 1664525u + 1013904223u;
+    samples[k] = 0.01f - (state >> 8) * (0.02f / 16777216.f);
+  }
+}
+
+static int silent(const float *in, int n)
+{
+  for (int k = 0; k < n; ++k) {
+    if (in[k] != 0.f) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// as VarMembrane_next() with fixed tension and loss and an audio rate
+// excitation, sleeping through silence the same way. struck at the job's
+// point if it has one. 0 if out of memory
+static int renderMesh(const t_mesh_entry *entry, const t_job *job, const float *in, float *out,
+                       size_t n, float yj, float loss)
+{
+  int model = job->model;
+  const t_mesh_kernels *kernels = mesh_kernels(model);
+  t_stencil_cycle_fn stencil_cycle = stencil_kernel(model);
+  const t_stencil *stencil = entry->stencil;
+  const t_mesh *mesh = entry->mesh;
+  t_mesh_state state;
+  t_stencil_state stencil_state;
+  t_mesh_strike strike;
+  t_stencil_strike stencil_struck;
+  float yj_r = 1.0f / yj;
+  int sleeping = 1;
+
+  void *block = malloc(stencil ? stencil_state_size(stencil) : mesh_state_size(mesh));
+  if (!block) {
+    return 0;
+  }
+  if (stencil) {
+    stencil_state_init(stencil, &stencil_state, block);
+    if (job->at) {
+      stencil_strike(stencil, entry->shape, job->at_x, job->at_y, &stencil_struck);
+      stencil_state.strike = &stencil_struck;
+    }
+  }
+  else {
+    mesh_state_init(mesh, &state, block);
+    if (job->at) {
+      mesh_strike(mesh, entry->shape, job->at_x, job->at_y, &strike);
+      state.strike = &strike;
+    }
+  }
+
+  unsigned int fpmode = mesh_denormals_flush();
+
+  for (size_t k = 0; k < n; k += RENDER_BLOCK) {
+    int count = (int) std::min((size_t) RENDER_BLOCK, n - k);
+    int quiet = silent(&in[k], count);
+
+    if (sleeping && quiet) {
+      memset(&out[k], 0, count * sizeof(float));
+      continue;
+    }
+    sleeping = 0;
+
+    if (stencil) {
+      for (int i = 0; i < count; ++i) {
+        out[k + i] = stencil_cycle(stencil, &stencil_state, in[k + i], yj, yj_r, loss);
+      }
+    }
+    else if (mesh_use_tiled(mesh)) {
+      kernels->tiled(mesh, &state, &in[k], &out[k], count, yj, yj_r, loss);
+    }
+    else {
+      for (int i = 0; i < count; ++i) {
+        out[k + i] = kernels->cycle(mesh, &state, in[k + i], yj, yj_r, loss);
+      }
+    }
+
+    float energy = stencil ? stencil_state_energy(stencil, model, &stencil_state)
+      : mesh_state_energy(mesh, model, &state);
+    if (quiet && energy < MESH_QUIET_ENERGY) {
+      if (stencil) {
+        stencil_state_clear(stencil, &stencil_state);
+      }
+      else {
+        mesh_state_clear(mesh, &state);
+      }
+      sleeping = 1;
+    }
+  }
+
+  mesh_denormals_restore(fpmode);
+  free(block);
+  return 1;
+}
+
+// renderMesh() on the K-variable form of the same mesh, compiled per job
+static int renderKmesh(const t_mesh_entry *entry, const t_job *job, const float *in, float *out,
+                       size_t n, float yj, float loss)
+{
+  t_kmesh_cycle_fn cycle = kmesh_kernel(job->model);
+  t_kmesh *kmesh = compile_kmesh(entry->shape, MESH_ORDER_DEFAULT);
+  t_kmesh_state state;
+  t_mesh_strike strike;
+  float yj_r = 1.0f / yj;
+  int sleeping = 1;
+
+  if (!kmesh) {
+    return 0;
+  }
+  void *block = malloc(kmesh_state_size(kmesh));
+  if (!block) {
+    free_kmesh(kmesh);
+    return 0;
+  }
+  kmesh_state_init(kmesh, &state, block);
+  if (job->at) {
+    // the junctions are numbered alike, see t_kmesh
+    mesh_strike(entry->mesh, entry->shape, job->at_x, job->at_y, &strike);
+    state.strike = &strike;
+  }
+
+  unsigned int fpmode = mesh_denormals_flush();
+
+  for (size_t k = 0; k < n; k += RENDER_BLOCK) {
+    int count = (int) std::min((size_t) RENDER_BLOCK, n - k);
+    int quiet = silent(&in[k], count);
+
+    if (sleeping && quiet) {
+      memset(&out[k], 0, count * sizeof(float));
+      continue;
+    }
+    sleeping = 0;
+
+    for (int i = 0; i < count; ++i) {
+      out[k + i] = cycle(kmesh, &state, in[k + i], yj_r, loss);
+    }
+
+    if (quiet && kmesh_state_energy(kmesh, &state) < MESH_QUIET_ENERGY) {
+      kmesh_state_clear(kmesh, &state);
+      sleeping = 1;
+    }
+  }
+
+  mesh_denormals_restore(fpmode);
+  free(block);
+  free_kmesh(kmesh);
+  return 1;
+}
+
+static void runJob(t_job *job)
+{
+  std::vector<float> in, out;
+  int rate = job->rate;
+  double t0 = now_ms();
+
+  if (job->in.empty() || job->in == "strike") {
+    makeStrike(in, job->seed);
+  }
+  else if (!readWav(job->in.c_str(), in, &rate, job->error)) {
+    return;
+  }
+
+  t_mesh_entry *entry = acquireMesh(job->shape_type, job->angle, job->fragNums);
+  if (!entry) {
+    job->error = "cannot build the mesh";
+    return;
+  }
+
+  size_t n = in.size() + (size_t) (job->tail * rate);
+  in.resize(n, 0.f);
+  out.resize(n);
+  int rendered = (job->kmesh ? renderKmesh : renderMesh)(entry, job, in.data(), out.data(), n,
+                                                          mesh_admittance(job->tension),
+                                                          mesh_loss(job->loss));
+  job->points_n = entry->mesh->points_n;
+  releaseMesh(entry);
+
+  if (!rendered) {
+    job->error = "out of memory";
+    return;
+  }
+  if (job->gain != 1.f) {
+    for (size_t k = 0; k < n; ++k) {
+      out[k] *= job->gain;
+    }
+  }
+  if (!writeWav(job->out.c_str(), out, rate)) {
+    job->error = "cannot write " + job->out;
+    return;
+  }
+
+  job->seconds = (double) n / rate;
+  job->ms = now_ms() - t0;
+  job->ok = 1;
+}
+
+////////////////////////////////////////////////////////////////////
+
+static void defaultJob(t_job *job, int line)
+{
+  job->line = line;
+  job->shape_type = -1;
+  job->angle = 0;
+  job->fragNums = 0;
+  job->tension = 0.05f;
+  job->loss = 0.99999f;
+  job->model = MESH_MODEL_DEFAULT;
+  job->kmesh = 0;
+  job->seed = 1;
+  job->rate = 48000;
+  job->tail = 4;
+  job->gain = 1;
+  job->at = 0;
+  job->at_x = 0;
+  job->at_y = 0;
+  job->ok = 0;
+  job->points_n = 0;
+  job->seconds = 0;
+  job->ms = 0;
+}
+
+// one key=value setting, 0 with a message if it is not one
+static int parseSetting(t_job *job, const char *setting, std::string &error)
+{
+  const char *eq = strchr(setting, '=');
+  if (!eq) {
+    error = std::string("expected key=value, got ") + setting;
+    return 0;
+  }
+  std::string key(setting, eq - setting);
+  const char *value = eq + 1;
+  int angle;
+
+  if (key == "out") {
+    job->out = value;
+  }
+  else if (key == "in") {
+    job->in = value;
+  }
+  else if (key == "unit") {
+    if (!unitParams(value, &job->shape_type, &angle, &job->fragNums)) {
+      error = std::string("no unit ") + value;
+      return 0;
+    }
+    job->angle = (float) angle;
+  }
+  else if (key == "shape") {
+    job->shape_type = atoi(value);
+  }
+  else if (key == "angle") {
+    job->angle = (float) atof(value);
+  }
+  else if (key == "frag") {
+    job->fragNums = atoi(value);
+  }
+  else if (key == "tension") {
+    job->tension = (float) atof(value);
+  }
+  else if (key == "loss") {
+    job->loss = (float) atof(value);
+  }
+  else if (key == "model") {
+    job->model = atoi(value);
+  }
+  else if (key == "engine") {
+    if (strcmp(value, "mesh") != 0 && strcmp(value, "kmesh") != 0) {
+      error = std::string("expected engine=mesh or kmesh, got ") + setting;
+      return 0;
+    }
+    job->kmesh = strcmp(value, "kmesh") == 0;
+  }
+  else if (key == "seed") {
+    job->seed = (unsigned int) strtoul(value, NULL, 10);
+  }
+  else if (key == "rate") {
+    job->rate = atoi(value);
+  }
+  else if (key == "tail") {
+    job->tail = (float) atof(value);
+  }
+  else if (key == "gain") {
+    job->gain = (float) atof(value);
+  }
+  else if (key == "at") {
+    if (sscanf(value, "%f,%f", &job->at_x, &job->at_y) != 2) {
+      error = std::string("expected at=X,Y, got ") + setting;
+      return 0;
+    }
+    job->at = 1;
+  }
+  else {
+    error = "unknown setting " + key;
+    return 0;
+  }
+  return 1;
+}
+
+static int checkJob(const t_job *job, std::string &error)
+{
+  if (job->out.empty()) {
+    error = "no out=";
+  }
+  else if (job->shape_type < 0 || job->shape_type > 3) {
+    error = "no unit= or shape=";
+  }
+  else if (job->shape_type == 2 && !(job->angle > 0)) {
+    error = "stone chimes need a positive angle";
+  }
+  else if (job->model < 0 || job->model >= MESH_MODEL_N) {
+    error = "model out of range";
+  }
+  else if (job->rate <= 0 || job->tail < 0) {
+    error = "rate and tail must be positive";
+  }
+  else {
+    return 1;
+  }
+  return 0;
+}
+
+static int readJobs(const char *path, std::vector<t_job> &jobs)
+{
+  FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  char line[4096];
+  int line_n = 0, ok = 1;
+
+  if (!f) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return 0;
+  }
+  while (fgets(line, sizeof(line), f)) {
+    char *hash = strchr(line, '#');
+    std::string error;
+    t_job job;
+    int settings = 0;
+
+    line_n++;
+    if (hash) {
+      *hash = 0;
+    }
+    defaultJob(&job, line_n);
+    for (char *tok = strtok(line, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+      if (!parseSetting(&job, tok, error)) {
+        break;
+      }
+      settings++;
+    }
+    if (settings == 0 && error.empty()) {
+      continue;
+    }
+    if (!error.empty() || !checkJob(&job, error)) {
+      fprintf(stderr, "%s:%d: %s\n", path, line_n, error.c_str());
+      ok = 0;
+      continue;
+    }
+    jobs.push_back(job);
+  }
+  if (f != stdin) {
+    fclose(f);
+  }
+  return ok;
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: MembraneRender [-j threads] [-f jobfile|-] [key=value ...]\n"
+          "  out=FILE.wav unit=NAME | shape=N angle=A frag=F\n"
+          "  tension=0.05 loss=0.99999 model=7 in=FILE.wav|strike seed=1 rate=48000\n"
+          "  at=X,Y tail=4 gain=1\n");
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<t_job> jobs;
+  t_job job;
+  std::string error;
+  int threads = (int) std::thread::hardware_concurrency();
+  int settings = 0;
+
+  defaultJob(&job, 0);
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      if (!readJobs(argv[++i], jobs)) {
+        return 1;
+      }
+    }
+    else if (argv[i][0] == '-') {
+      usage();
+      return 1;
+    }
+    else if (parseSetting(&job, argv[i], error)) {
+      settings++;
+    }
+    else {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+  }
+  if (settings > 0) {
+    if (!checkJob(&job, error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    jobs.push_back(job);
+  }
+  if (jobs.empty()) {
+    usage();
+    return 1;
+  }
+  threads = std::max(1, std::min(threads, (int) jobs.size()));
+
+  mesh_select_kernel(MESH_KERNEL_N);
+
+  // workers take the next job until none are left
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> pool;
+  double t0 = now_ms();
+
+  for (int t = 0; t < threads; ++t) {
+    pool.push_back(std::thread([&jobs, &next]() {
+      size_t j;
+      while ((j = next++) < jobs.size()) {
+        runJob(&jobs[j]);
+      }
+    }));
+  }
+  for (size_t t = 0; t < pool.size(); ++t) {
+    pool[t].join();
+  }
+  double wall = now_ms() - t0;
+
+  double audio = 0, busy = 0;
+  int failures = 0;
+
+  printf("%-32s %7s %9s %10s %10s\n", "out", "points", "seconds", "ms", "realtime");
+  for (size_t j = 0; j < jobs.size(); ++j) {
+    if (!jobs[j].ok) {
+      fprintf(stderr, "%s: %s\n", jobs[j].out.c_str(), jobs[j].error.c_str());
+      failures++;
+      continue;
+    }
+    printf("%-32s %7u %9.2f %10.1f %9.1fx\n", jobs[j].out.c_str(), jobs[j].points_n,
+           jobs[j].seconds, jobs[j].ms, jobs[j].seconds * 1000 / jobs[j].ms);
+    audio += jobs[j].seconds;
+    busy += jobs[j].ms;
+  }
+  printf("%zu jobs, %.2f s of audio in %.2f s on %d threads: %.1fx realtime, %.1fx per core\n",
+         jobs.size() - failures, audio, wall / 1000, threads, audio * 1000 / wall,
+         busy > 0 ? audio * 1000 / busy : 0.0);
+
+  purgeMeshCache();
+  return failures ? 1 : 0;
+}
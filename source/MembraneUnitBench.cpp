@@ -0,0 +1,360 @@
+// Per-unit benchmark: constructs and runs every registered membrane UGen
+// through its real Ctor and calc functions, outside scsynth, on a minimal
+// in-process host. Reports, one record per unit:
+//
+//   Ctor time with the mesh not yet cached (it is then built inline, as
+//   the server would on the NRT thread) and with it cached, real-time
+//   bytes per instance, junctions, lines and delays, the engine the unit
+//   runs on, ns per sample for one voice and per voice with
+//   UNIT_BENCH_VOICES running side by side, and from that the voices one
+//   core sustains at UNIT_BENCH_RATE in UNIT_BENCH_BLOCK sample blocks.
+//
+//   MembraneUnitBench [csv|json] [seconds]
+//
+// csv (the default) has one header line; json is one object with the
+// run's settings and a "units" array. both go to stdout.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include "SC_PlugIn.h"
+
+#include "StoneChime.h"
+
+#define UNIT_BENCH_RATE 48000
+#define UNIT_BENCH_BLOCK 64
+#define UNIT_BENCH_VOICES 32
+
+extern "C" void load(InterfaceTable *inTable);
+
+static double now_ns()
+{
+  return std::chrono::duration<double, std::nano>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+////////////////////////////////////////////////////////////////////
+
+// the host: unit definitions, real-time memory that counts what it hands
+// out, and asynchronous commands run inline
+
+typedef struct {
+  size_t size;
+  UnitCtorFunc ctor;
+  UnitDtorFunc dtor;
+} t_unit_def;
+
+static std::map<std::string, t_unit_def> unitDefs;
+static size_t rtBytes;
+
+static bool hostDefineUnit(const char *name, size_t size, UnitCtorFunc ctor, UnitDtorFunc dtor,
+                           uint32 flags)
+{
+  t_unit_def def = {size, ctor, dtor};
+  unitDefs[name] = def;
+  return true;
+}
+
+// every block is preceded by its size
+static void *hostRTAlloc(World *world, size_t size)
+{
+  size_t *block = (size_t *) malloc(size + sizeof(max_align_t));
+  if (!block) {
+    return NULL;
+  }
+  *block = size;
+  rtBytes += size;
+  return (char *) block + sizeof(max_align_t);
+}
+
+static void hostRTFree(World *world, void *ptr)
+{
+  if (ptr) {
+    size_t *block = (size_t *) ((char *) ptr - sizeof(max_align_t));
+    rtBytes -= *block;
+    free(block);
+  }
+}
+
+static void hostClearUnitOutputs(Unit *unit, int n)
+{
+  for (uint32 i = 0; i < unit->mNumOutputs; ++i) {
+    memset(unit->mOutBuf[i], 0, n * sizeof(float));
+  }
+}
+
+static int hostDoAsynchronousCommand(World *world, void *replyAddr, const char *name, void *data,
+                                     AsyncStageFn stage2, AsyncStageFn stage3, AsyncStageFn stage4,
+                                     AsyncFreeFn cleanup, int msgSize, void *msgData)
+{
+  if ((!stage2 || stage2(world, data)) && (!stage3 || stage3(world, data)) && stage4) {
+    stage4(world, data);
+  }
+  if (cleanup) {
+    cleanup(world, data);
+  }
+  return 0;
+}
+
+static void hostDoneAction(int action, Unit *unit)
+{
+}
+
+// plug-in commands are registered but never sent
+static bool hostDefinePlugInCmd(const char *name, PlugInCmdFunc func, void *userData)
+{
+  return true;
+}
+
+static int hostPrint(const char *fmt, ...)
+{
+  return 0;
+}
+
+static InterfaceTable hostTable;
+static World *hostWorld;
+static Rate hostRate;
+
+static void hostInit()
+{
+  hostTable.fDefineUnit = hostDefineUnit;
+  hostTable.fRTAlloc = hostRTAlloc;
+  hostTable.fRTFree = hostRTFree;
+  hostTable.fClearUnitOutputs = hostClearUnitOutputs;
+  hostTable.fDoAsynchronousCommand = hostDoAsynchronousCommand;
+  hostTable.fDoneAction = hostDoneAction;
+  hostTable.fDefinePlugInCmd = hostDefinePlugInCmd;
+  hostTable.fPrint = hostPrint;
+
+  hostWorld = (World *) calloc(1, sizeof(World));
+  hostWorld->mSampleRate = UNIT_BENCH_RATE;
+  hostWorld->mBufLength = UNIT_BENCH_BLOCK;
+  hostRate.mSampleRate = UNIT_BENCH_RATE;
+  hostRate.mBufLength = UNIT_BENCH_BLOCK;
+
+  load(&hostTable);
+}
+
+// one instance with an audio rate excitation and scalar tension, loss,
+// doneAction and model, as StoneChime*.ar builds it
+typedef struct {
+  Unit *unit;
+  const t_unit_def *def;
+  Wire wires[5];
+  Wire *wire_ptrs[5];
+  float *in_bufs[5];
+  float *out_bufs[1];
+  float in[5][UNIT_BENCH_BLOCK];
+  float out[UNIT_BENCH_BLOCK];
+} t_instance;
+
+static t_instance *instanceNew(const t_unit_def *def, float tension, float loss, int model)
+{
+  t_instance *inst = (t_instance *) calloc(1, sizeof(t_instance));
+  Unit *unit = (Unit *) calloc(1, def->size);
+
+  inst->unit = unit;
+  inst->def = def;
+  for (int i = 0; i < 5; ++i) {
+    inst->wires[i].mCalcRate = i == 0 ? calc_FullRate : calc_ScalarRate;
+    inst->wires[i].mBuffer = inst->in[i];
+    inst->wire_ptrs[i] = &inst->wires[i];
+    inst->in_bufs[i] = inst->in[i];
+  }
+  inst->out_bufs[0] = inst->out;
+  inst->in[1][0] = tension;
+  inst->in[2][0] = loss;
+  inst->in[3][0] = 0;
+  inst->in[4][0] = (float) model;
+
+  unit->mWorld = hostWorld;
+  unit->mRate = &hostRate;
+  unit->mNumInputs = 5;
+  unit->mNumOutputs = 1;
+  unit->mInput = inst->wire_ptrs;
+  unit->mInBuf = inst->in_bufs;
+  unit->mOutBuf = inst->out_bufs;
+  unit->mCalcRate = calc_FullRate;
+  return inst;
+}
+
+static void instanceCtor(t_instance *inst)
+{
+  (inst->def->ctor)(inst->unit);
+}
+
+static void instanceNext(t_instance *inst)
+{
+  (inst->unit->mCalcFunc)(inst->unit, UNIT_BENCH_BLOCK);
+}
+
+static void instanceFree(t_instance *inst)
+{
+  if (inst->def->dtor) {
+    (inst->def->dtor)(inst->unit);
+  }
+  free(inst->unit);
+  free(inst);
+}
+
+////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  std::string name;
+  int shape_type, angle, fragNums;
+  uint32_t points_n, lines_n, delay_n;
+  const char *engine;
+  double ctor_cold_us, ctor_warm_us;
+  size_t rt_bytes;
+  double ns, ns_voices, voices_per_core;
+} t_result;
+
+// ns per sample per voice of voices instances run block by block, kept
+// excited all along so that none of them goes to sleep
+static double runVoices(const t_unit_def *def, int voices, int blocks)
+{
+  std::vector<t_instance *> insts;
+  uint32_t noise = 1;
+
+  for (int v = 0; v < voices; ++v) {
+    insts.push_back(instanceNew(def, 0.05f, 0.99999f, MESH_MODEL_DEFAULT));
+    instanceCtor(insts[v]);
+  }
+
+  double t0 = now_ns();
+  for (int b = 0; b < blocks; ++b) {
+    for (int v = 0; v < voices; ++v) {
+      float *in = insts[v]->in[0];
+      for (int k = 0; k < UNIT_BENCH_BLOCK; ++k) {
+        noise = noise * 1664525u + 1013904223u;
+        in[k] = 0.01f - (noise >> 8) * (0.02f / 16777216.f);
+      }
+      instanceNext(insts[v]);
+    }
+  }
+  double ns = (now_ns() - t0) / ((double) blocks * UNIT_BENCH_BLOCK * voices);
+
+  for (int v = 0; v < voices; ++v) {
+    instanceFree(insts[v]);
+  }
+  return ns;
+}
+
+static t_result benchUnit(const char *name, const t_unit_def *def, int blocks)
+{
+  t_result r;
+  double t0;
+
+  r.name = name;
+  unitParams(name, &r.shape_type, &r.angle, &r.fragNums);
+
+  // nothing of this unit cached yet: the Ctor builds the mesh
+  purgeMeshCache();
+  size_t before = rtBytes;
+  t_instance *cold = instanceNew(def, 0.05f, 0.99999f, MESH_MODEL_DEFAULT);
+  t0 = now_ns();
+  instanceCtor(cold);
+  r.ctor_cold_us = (now_ns() - t0) / 1000;
+  r.rt_bytes = rtBytes - before;
+
+  t_instance *warm = instanceNew(def, 0.05f, 0.99999f, MESH_MODEL_DEFAULT);
+  t0 = now_ns();
+  instanceCtor(warm);
+  r.ctor_warm_us = (now_ns() - t0) / 1000;
+  instanceFree(warm);
+
+  t_mesh_entry *entry = acquireMesh(r.shape_type, (float) r.angle, r.fragNums);
+  r.points_n = entry->mesh->points_n;
+  r.lines_n = entry->mesh->lines_n;
+  r.delay_n = entry->mesh->delay_n;
+  r.engine = entry->stencil ? "stencil" : mesh_use_tiled(entry->mesh) ? "tiled" : "mesh";
+  releaseMesh(entry);
+  instanceFree(cold);
+
+  r.ns = runVoices(def, 1, blocks);
+  r.ns_voices = runVoices(def, UNIT_BENCH_VOICES, blocks / 4 > 0 ? blocks / 4 : 1);
+  r.voices_per_core = 1e9 / (r.ns_voices * UNIT_BENCH_RATE);
+  return r;
+}
+
+int main(int argc, char **argv)
+{
+  int json = argc > 1 && strcmp(argv[1], "json") == 0;
+  double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+  int blocks = (int) (seconds * UNIT_BENCH_RATE / UNIT_BENCH_BLOCK);
+  std::vector<t_result> results;
+  char name[32];
+
+  if (argc > 1 && !json && strcmp(argv[1], "csv") != 0) {
+    fprintf(stderr, "usage: MembraneUnitBench [csv|json] [seconds]\n");
+    return 1;
+  }
+  blocks = blocks > 0 ? blocks : 1;
+
+  hostInit();
+
+  // the registered membranes, in PluginLoad() order
+  std::vector<std::string> names;
+  names.push_back("VarMembraneCircle");
+  names.push_back("VarMembraneHexagon");
+  for (int i = 0; i < 4; ++i) {
+    snprintf(name, sizeof(name), "StoneChime%d", i);
+    names.push_back(name);
+  }
+  for (int i = 0; i < 47; ++i) {
+    snprintf(name, sizeof(name), "SCFrag%d", i);
+    names.push_back(name);
+  }
+
+  unsigned int fpmode = mesh_denormals_flush();
+  for (size_t u = 0; u < names.size(); ++u) {
+    std::map<std::string, t_unit_def>::const_iterator def = unitDefs.find(names[u]);
+    if (def == unitDefs.end()) {
+      fprintf(stderr, "%s is not registered\n", names[u].c_str());
+      return 1;
+    }
+    results.push_back(benchUnit(names[u].c_str(), &def->second, blocks));
+  }
+  mesh_denormals_restore(fpmode);
+
+  const char *kernel = mesh_kernel_name(mesh_select_kernel(MESH_KERNEL_N));
+
+  if (json) {
+    printf("{\"rate\": %d, \"block\": %d, \"voices\": %d, \"seconds\": %g, \"kernel\": \"%s\",\n"
+           " \"units\": [\n", UNIT_BENCH_RATE, UNIT_BENCH_BLOCK, UNIT_BENCH_VOICES, seconds, kernel);
+  }
+  else {
+    printf("unit,shape,angle,frag,points,lines,delays,engine,ctor_cold_us,ctor_warm_us,rt_bytes,"
+           "ns_per_sample,ns_per_sample_%d,voices_per_core,kernel\n", UNIT_BENCH_VOICES);
+  }
+
+  for (size_t u = 0; u < results.size(); ++u) {
+    const t_result &r = results[u];
+
+    if (json) {
+      printf("  {\"unit\": \"%s\", \"shape\": %d, \"angle\": %d, \"frag\": %d, \"points\": %u, "
+             "\"lines\": %u, \"delays\": %u, \"engine\": \"%s\", \"ctor_cold_us\": %.2f, "
+             "\"ctor_warm_us\": %.2f, \"rt_bytes\": %zu, \"ns_per_sample\": %.2f, "
+             "\"ns_per_sample_voices\": %.2f, \"voices_per_core\": %.1f}%s\n",
+             r.name.c_str(), r.shape_type, r.angle, r.fragNums, r.points_n, r.lines_n, r.delay_n,
+             r.engine, r.ctor_cold_us, r.ctor_warm_us, r.rt_bytes, r.ns, r.ns_voices,
+             r.voices_per_core, u + 1 < results.size() ? "," : "");
+    }
+    else {
+      printf("%s,%d,%d,%d,%u,%u,%u,%s,%.2f,%.2f,%zu,%.2f,%.2f,%.1f,%s\n", r.name.c_str(),
+             r.shape_type, r.angle, r.fragNums, r.points_n, r.lines_n, r.delay_n, r.engine,
+             r.ctor_cold_us, r.ctor_warm_us, r.rt_bytes, r.ns, r.ns_voices, r.voices_per_core,
+             kernel);
+    }
+  }
+  if (json) {
+    printf(" ]}\n");
+  }
+
+  purgeMeshCache();
+  return 0;
+}
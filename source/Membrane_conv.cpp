@@ -0,0 +1,418 @@
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Membrane_conv.h"
+
+#define ALIGN_FLOATS(n) (((n) + (MESH_ALIGN / sizeof(float)) - 1) & ~(MESH_ALIGN / sizeof(float) - 1))
+
+////////////////////////////////////////////////////////////////////
+
+uint32_t conv_render(const t_mesh *mesh, int model, float yj, float loss, float *ir,
+                     uint32_t length)
+{
+  t_mesh_cycle_fn cycle = mesh_kernels(model)->cycle;
+  t_mesh_state state;
+  void *block = malloc(mesh_state_size(mesh));
+  uint32_t k;
+
+  if (block == NULL) {
+    return 0;
+  }
+  mesh_state_init(mesh, &state, block);
+
+  unsigned int fpmode = mesh_denormals_flush();
+  for (k = 0; k < length; ++k) {
+    ir[k] = cycle(mesh, &state, k == 0 ? 1.f : 0.f, yj, 1.0f / yj, loss);
+  }
+  mesh_denormals_restore(fpmode);
+  free(block);
+
+  // drop the tail that holds next to nothing of the energy
+  double energy = 0, tail = 0;
+  for (k = 0; k < length; ++k) {
+    energy += (double) ir[k] * ir[k];
+  }
+  for (k = length; k > 1; --k) {
+    tail += (double) ir[k - 1] * ir[k - 1];
+    if (tail > energy * CONV_TAIL_ENERGY) {
+      break;
+    }
+  }
+  return k;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// in place radix-2 FFT of n interleaved complex values, unscaled
+static void conv_fft(const t_conv *conv, float *x, uint32_t n, int inverse)
+{
+  uint32_t i, j, bit;
+
+  for (i = 1, j = 0; i < n; ++i) {
+    for (bit = n >> 1; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      float re = x[2 * i], im = x[2 * i + 1];
+      x[2 * i] = x[2 * j];
+      x[2 * i + 1] = x[2 * j + 1];
+      x[2 * j] = re;
+      x[2 * j + 1] = im;
+    }
+  }
+
+  for (uint32_t len = 2; len <= n; len <<= 1) {
+    uint32_t half = len >> 1;
+    uint32_t step = conv->fft_max / len;
+
+    for (uint32_t m = 0; m < half; ++m) {
+      float wr = conv->twiddle[2 * m * step];
+      float wi = inverse ? -conv->twiddle[2 * m * step + 1] : conv->twiddle[2 * m * step + 1];
+
+      for (i = m; i < n; i += len) {
+        float *a = x + 2 * i, *b = x + 2 * (i + half);
+        float re = b[0] * wr - b[1] * wi;
+        float im = b[0] * wi + b[1] * wr;
+
+        b[0] = a[0] - re;
+        b[1] = a[1] - im;
+        a[0] += re;
+        a[1] += im;
+      }
+    }
+  }
+}
+
+// the spectrum, bins 0..size, of 2 * size real samples in place, through a
+// complex FFT of half the length. x holds 2 * size + 2 floats
+static void conv_rfft(const t_conv *conv, float *x, uint32_t size)
+{
+  uint32_t step = conv->fft_max / (2 * size);
+
+  conv_fft(conv, x, size, 0);
+
+  float re = x[0], im = x[1];
+  x[0] = re + im;
+  x[1] = 0.f;
+  x[2 * size] = re - im;
+  x[2 * size + 1] = 0.f;
+
+  // the even and odd samples' spectra are E and O, X[k] = E + W^k O and
+  // X[size - k] = conj(E - W^k O)
+  for (uint32_t k = 1; k <= size / 2; ++k) {
+    float *a = x + 2 * k, *b = x + 2 * (size - k);
+    float wr = conv->twiddle[2 * k * step], wi = conv->twiddle[2 * k * step + 1];
+    float er = 0.5f * (a[0] + b[0]), ei = 0.5f * (a[1] - b[1]);
+    float or_ = 0.5f * (a[1] + b[1]), oi = -0.5f * (a[0] - b[0]);
+    float tr = wr * or_ - wi * oi, ti = wr * oi + wi * or_;
+
+    a[0] = er + tr;
+    a[1] = ei + ti;
+    b[0] = er - tr;
+    b[1] = ti - ei;
+  }
+}
+
+// the inverse of conv_rfft(), unscaled: 2 * size times the samples
+static void conv_irfft(const t_conv *conv, float *x, uint32_t size)
+{
+  uint32_t step = conv->fft_max / (2 * size);
+
+  float first = x[0], last = x[2 * size];
+  x[0] = first + last;
+  x[1] = first - last;
+
+  for (uint32_t k = 1; k <= size / 2; ++k) {
+    float *a = x + 2 * k, *b = x + 2 * (size - k);
+    float wr = conv->twiddle[2 * k * step], wi = -conv->twiddle[2 * k * step + 1];
+    float er = a[0] + b[0], ei = a[1] - b[1];
+    float dr = a[0] - b[0], di = a[1] + b[1];
+    float or_ = dr * wr - di * wi, oi = dr * wi + di * wr;
+
+    a[0] = er - oi;
+    a[1] = ei + or_;
+    b[0] = er + oi;
+    b[1] = or_ - ei;
+  }
+
+  conv_fft(conv, x, size, 1);
+}
+
+t_conv *compile_conv(const float *ir, uint32_t length)
+{
+  t_conv *conv = (t_conv *) calloc(1, sizeof(t_conv));
+  uint32_t start = CONV_HEAD, size = CONV_HEAD;
+  size_t floats = 0;
+  uint32_t i, l;
+
+  if (conv == NULL) {
+    return NULL;
+  }
+  conv->length = length;
+
+  for (i = 0; i < CONV_HEAD; ++i) {
+    conv->head[CONV_HEAD - 1 - i] = i < length ? ir[i] : 0.f;
+  }
+
+  // each level ends where the next one is two of its own blocks in, the
+  // last takes the rest
+  while (start < length) {
+    t_conv_level *level = &conv->level[conv->levels_n];
+    uint32_t next = size * CONV_GROWTH <= CONV_MAX_BLOCK ? size * CONV_GROWTH : CONV_MAX_BLOCK;
+    uint32_t left = (length - start + size - 1) / size;
+    uint32_t parts = left;
+
+    if (next > size && conv->levels_n + 1 < CONV_LEVELS_MAX) {
+      parts = (2 * next - start) / size;
+      parts = parts < left ? parts : left;
+    }
+
+    level->size = size;
+    level->start = start;
+    level->parts = parts;
+    level->due = start < 2 * size;
+    floats += (size_t) parts * (size + 1) * 2;
+    conv->fft_max = 2 * size;
+    conv->levels_n++;
+
+    uint32_t silence = start + (parts + 3) * size;
+    conv->silence = silence > conv->silence ? silence : conv->silence;
+
+    start += parts * size;
+    size = next;
+  }
+  conv->silence = conv->silence > 2 * CONV_HEAD ? conv->silence : 2 * CONV_HEAD;
+
+  if (conv->levels_n == 0) {
+    return conv;
+  }
+
+  // the twiddles, then every level's spectra
+  float *block = (float *) malloc((floats + conv->fft_max) * sizeof(float));
+  float *scratch = (float *) malloc((conv->fft_max + 2) * sizeof(float));
+
+  if (block == NULL || scratch == NULL) {
+    free(block);
+    free(scratch);
+    free(conv);
+    return NULL;
+  }
+
+  conv->twiddle = block;
+  for (i = 0; i < conv->fft_max / 2; ++i) {
+    double phase = -2.0 * M_PI * i / conv->fft_max;
+    conv->twiddle[2 * i] = (float) cos(phase);
+    conv->twiddle[2 * i + 1] = (float) sin(phase);
+  }
+  block += conv->fft_max;
+
+  for (l = 0; l < conv->levels_n; ++l) {
+    t_conv_level *level = &conv->level[l];
+    uint32_t bins = level->size + 1;
+    // the inverse FFT is left unscaled
+    float scale = 1.0f / (2 * level->size);
+
+    level->spectra = block;
+    block += (size_t) level->parts * bins * 2;
+
+    for (uint32_t p = 0; p < level->parts; ++p) {
+      memset(scratch, 0, (level->size * 2 + 2) * sizeof(float));
+      for (i = 0; i < level->size; ++i) {
+        uint32_t k = level->start + p * level->size + i;
+        scratch[i] = k < length ? ir[k] : 0.f;
+      }
+      conv_rfft(conv, scratch, level->size);
+      for (i = 0; i < bins * 2; ++i) {
+        level->spectra[(size_t) p * bins * 2 + i] = scratch[i] * scale;
+      }
+    }
+  }
+
+  free(scratch);
+  return conv;
+}
+
+void free_conv(t_conv *conv)
+{
+  free(conv->twiddle);
+  free(conv);
+}
+
+////////////////////////////////////////////////////////////////////
+
+static size_t conv_level_floats(const t_conv_level *level)
+{
+  uint32_t bins = level->size + 1;
+
+  return ALIGN_FLOATS(2 * level->size) + ALIGN_FLOATS(2 * level->size + 2)
+    + ALIGN_FLOATS((size_t) level->parts * bins * 2) + ALIGN_FLOATS(bins * 2)
+    + ALIGN_FLOATS(level->size) * 2;
+}
+
+size_t conv_state_size(const t_conv *conv)
+{
+  size_t floats = ALIGN_FLOATS(2 * CONV_HEAD) + ALIGN_FLOATS(CONV_HEAD);
+
+  for (uint32_t l = 0; l < conv->levels_n; ++l) {
+    floats += conv_level_floats(&conv->level[l]);
+  }
+  return floats * sizeof(float) + MESH_ALIGN;
+}
+
+void conv_state_init(const t_conv *conv, t_conv_state *state, void *block)
+{
+  uintptr_t base = ((uintptr_t) block + MESH_ALIGN - 1) & ~((uintptr_t) MESH_ALIGN - 1);
+  float *p = (float *) base;
+
+  memset(block, 0, conv_state_size(conv));
+
+  state->history = p;
+  p += ALIGN_FLOATS(2 * CONV_HEAD);
+  state->tail = p;
+  p += ALIGN_FLOATS(CONV_HEAD);
+  state->pos = 0;
+
+  for (uint32_t l = 0; l < conv->levels_n; ++l) {
+    const t_conv_level *level = &conv->level[l];
+    t_conv_level_state *ls = &state->level[l];
+    uint32_t bins = level->size + 1;
+
+    ls->in = p;
+    p += ALIGN_FLOATS(2 * level->size);
+    ls->fft = p;
+    p += ALIGN_FLOATS(2 * level->size + 2);
+    ls->fdl = p;
+    p += ALIGN_FLOATS((size_t) level->parts * bins * 2);
+    ls->acc = p;
+    p += ALIGN_FLOATS(bins * 2);
+    ls->out = p;
+    p += ALIGN_FLOATS(level->size);
+    ls->next = p;
+    p += ALIGN_FLOATS(level->size);
+
+    ls->fill = 0;
+    ls->unit = level->parts + 2; // nothing to compute before the first block
+    ls->newest = 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+
+// the steps of one block of a level: the FFT of the last input block, one
+// step per partition, the inverse FFT
+static void conv_step(const t_conv *conv, const t_conv_level *level, t_conv_level_state *ls,
+                      uint32_t unit)
+{
+  uint32_t size = level->size;
+  uint32_t bins = size + 1;
+  uint32_t k;
+
+  if (unit == 0) {
+    conv_rfft(conv, ls->fft, size);
+    ls->newest = ls->newest + 1 < level->parts ? ls->newest + 1 : 0;
+    memcpy(ls->fdl + (size_t) ls->newest * bins * 2, ls->fft, bins * 2 * sizeof(float));
+  }
+  else if (unit <= level->parts) {
+    uint32_t part = unit - 1;
+    uint32_t slot = (ls->newest + level->parts - part) % level->parts;
+    const float *x = ls->fdl + (size_t) slot * bins * 2;
+    const float *h = level->spectra + (size_t) part * bins * 2;
+    float *acc = ls->acc;
+
+    if (part == 0) {
+      for (k = 0; k < bins; ++k) {
+        acc[2 * k] = x[2 * k] * h[2 * k] - x[2 * k + 1] * h[2 * k + 1];
+        acc[2 * k + 1] = x[2 * k] * h[2 * k + 1] + x[2 * k + 1] * h[2 * k];
+      }
+    }
+    else {
+      for (k = 0; k < bins; ++k) {
+        acc[2 * k] += x[2 * k] * h[2 * k] - x[2 * k + 1] * h[2 * k + 1];
+        acc[2 * k + 1] += x[2 * k] * h[2 * k + 1] + x[2 * k + 1] * h[2 * k];
+      }
+    }
+  }
+  else {
+    float *out = level->due ? ls->out : ls->next;
+
+    memcpy(ls->fft, ls->acc, bins * 2 * sizeof(float));
+    conv_irfft(conv, ls->fft, size);
+
+    // overlap-save: the second half is the linear convolution
+    memcpy(out, ls->fft + size, size * sizeof(float));
+  }
+}
+
+// every CONV_HEAD samples: feed the levels, do their share of the work and
+// gather their output for the next CONV_HEAD samples
+static void conv_boundary(const t_conv *conv, t_conv_state *state)
+{
+  const float *chunk = state->history + CONV_HEAD;
+  uint32_t k;
+
+  memset(state->tail, 0, CONV_HEAD * sizeof(float));
+
+  for (uint32_t l = 0; l < conv->levels_n; ++l) {
+    const t_conv_level *level = &conv->level[l];
+    t_conv_level_state *ls = &state->level[l];
+    uint32_t size = level->size;
+    uint32_t units = level->parts + 2;
+
+    memcpy(ls->in + size + ls->fill, chunk, CONV_HEAD * sizeof(float));
+    ls->fill += CONV_HEAD;
+
+    if (ls->fill == size) {
+      ls->fill = 0;
+      if (!level->due) {
+        float *tmp = ls->out;
+        ls->out = ls->next;
+        ls->next = tmp;
+      }
+      memcpy(ls->fft, ls->in, 2 * size * sizeof(float));
+      memcpy(ls->in, ls->in + size, size * sizeof(float));
+      ls->unit = 0;
+    }
+
+    uint32_t target = (ls->fill / CONV_HEAD + 1) * units / (size / CONV_HEAD);
+    while (ls->unit < target) {
+      conv_step(conv, level, ls, ls->unit++);
+    }
+
+    const float *out = ls->out + ls->fill;
+    for (k = 0; k < CONV_HEAD; ++k) {
+      state->tail[k] += out[k];
+    }
+  }
+
+  memcpy(state->history, chunk, CONV_HEAD * sizeof(float));
+}
+
+void conv_run(const t_conv *conv, t_conv_state *state, const float *in, float *out, int n)
+{
+  float *history = state->history;
+
+  for (int k = 0; k < n; ++k) {
+    uint32_t pos = state->pos;
+    history[CONV_HEAD + pos] = in[k];
+
+    // the head taps against the last CONV_HEAD inputs
+    const float *x = history + pos + 1;
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (uint32_t i = 0; i < CONV_HEAD; i += 4) {
+      s0 += conv->head[i] * x[i];
+      s1 += conv->head[i + 1] * x[i + 1];
+      s2 += conv->head[i + 2] * x[i + 2];
+      s3 += conv->head[i + 3] * x[i + 3];
+    }
+    out[k] = (s0 + s1) + (s2 + s3) + state->tail[pos];
+
+    if (++pos == CONV_HEAD) {
+      conv_boundary(conv, state);
+      pos = 0;
+    }
+    state->pos = pos;
+  }
+}
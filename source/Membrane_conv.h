@@ -0,0 +1,82 @@
+
+#ifndef Membrane_conv_h
+#define Membrane_conv_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Membrane_mesh.h"
+
+// The mesh as its impulse response. For fixed tension and loss a mesh is a
+// linear filter from the excitation to junction 0, so it can be rendered
+// once and played by convolution, at a cost set by the length of the
+// response instead of the size of the mesh.
+//
+// the first CONV_HEAD taps run directly, so there is no latency. the rest
+// is cut into partitions convolved by FFT (overlap-save, one frequency
+// domain delay line per block size), in blocks growing by CONV_GROWTH up to
+// CONV_MAX_BLOCK. every block size starts at least two of its blocks into
+// the response, so the output of a block can be computed during the block
+// before it, a slice every CONV_HEAD samples, instead of all at once on a
+// block boundary. only the smallest blocks are computed when they are due.
+
+#define CONV_HEAD 64           // direct taps, and the smallest block
+#define CONV_GROWTH 4          // block size ratio between levels
+#define CONV_MAX_BLOCK 16384
+#define CONV_LEVELS_MAX 8
+#define CONV_TAIL_ENERGY 1e-10 // responses are cut where less than this is left
+#define CONV_TOLERANCE 1e-4f   // peak-relative, against mesh_cycle()
+
+// partitions of one block size, the spectra of zero padded pieces of the
+// response, bins 0..size of a 2 * size FFT
+typedef struct {
+  uint32_t size;
+  uint32_t start;  // first sample of the response
+  uint32_t parts;
+  int due;         // computed on its block boundary instead of the block before
+  float *spectra;  // parts * (size + 1) complex, interleaved
+} t_conv_level;
+
+typedef struct {
+  uint32_t length;   // samples of the response
+  uint32_t silence;  // silent input after which the output stays exactly 0
+  float head[CONV_HEAD]; // the first taps, reversed
+  uint32_t levels_n;
+  t_conv_level level[CONV_LEVELS_MAX];
+  uint32_t fft_max;
+  float *twiddle;    // exp(-2 pi i k / fft_max), k < fft_max / 2
+} t_conv;
+
+// NRT: the first length samples of the junction 0 response of a mesh model
+// to a unit impulse, into ir. returns the length it can be cut to
+uint32_t conv_render(const t_mesh *mesh, int model, float yj, float loss, float *ir,
+                     uint32_t length);
+
+// NRT: NULL if out of memory
+t_conv *compile_conv(const float *ir, uint32_t length);
+void free_conv(t_conv *conv);
+
+typedef struct {
+  float *in;        // the last two blocks of input
+  float *fft;       // 2 * size samples, or size + 1 bins
+  float *fdl;       // spectra of the last parts input blocks
+  float *acc;       // size + 1 complex
+  float *out;       // output of the current block
+  float *next;      // and of the next one, while it is computed
+  uint32_t fill;    // samples into the current block
+  uint32_t unit;    // steps of the next block done
+  uint32_t newest;  // fdl slot of the last input block
+} t_conv_level_state;
+
+typedef struct {
+  float *history;   // 2 * CONV_HEAD samples of input
+  float *tail;      // the FFT levels' output for the current CONV_HEAD samples
+  uint32_t pos;
+  t_conv_level_state level[CONV_LEVELS_MAX];
+} t_conv_state;
+
+size_t conv_state_size(const t_conv *conv);
+void conv_state_init(const t_conv *conv, t_conv_state *state, void *block);
+
+void conv_run(const t_conv *conv, t_conv_state *state, const float *in, float *out, int n);
+
+#endif
@@ -0,0 +1,287 @@
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Membrane_kmesh.h"
+#include "Membrane_simd.h"
+
+#define ALIGN_FLOATS(n) (((n) + (MESH_ALIGN / sizeof(float)) - 1) & ~(MESH_ALIGN / sizeof(float) - 1))
+
+////////////////////////////////////////////////////////////////////
+
+t_kmesh *compile_kmesh(const t_shape *shape, int order)
+{
+  uint32_t points_n = (uint32_t) shape->points_n;
+  uint32_t lines_n = (uint32_t) shape->lines_n;
+  uint32_t i;
+
+  t_kmesh *kmesh = (t_kmesh *) calloc(1, sizeof(t_kmesh));
+  uint32_t *point_of = (uint32_t *) calloc(points_n * 2 + 1, sizeof(uint32_t));
+
+  if (kmesh == NULL || point_of == NULL) {
+    free(kmesh);
+    free(point_of);
+    return NULL;
+  }
+  uint32_t *junction_of = point_of + points_n;
+
+  kmesh->points_n = points_n;
+  kmesh->lines_n = lines_n;
+  kmesh->rim_n = (uint32_t) shape->edge_n;
+
+  // offsets, neighbours, rim junctions, then the per junction weights
+  kmesh->nb_off = (uint32_t *) calloc((size_t) points_n * 3 + 1 + lines_n * 2 + kmesh->rim_n,
+                                      sizeof(uint32_t));
+  if (kmesh->nb_off == NULL) {
+    free(point_of);
+    free(kmesh);
+    return NULL;
+  }
+  kmesh->nb = kmesh->nb_off + points_n + 1;
+  kmesh->rim = kmesh->nb + lines_n * 2;
+  kmesh->lines = (float *) (kmesh->rim + kmesh->rim_n);
+  kmesh->edge = kmesh->lines + points_n;
+
+  mesh_order(shape, order, point_of);
+  for (i = 0; i < points_n; ++i) {
+    junction_of[point_of[i]] = i;
+  }
+
+  // neighbours in line order, as the mesh orders its ports
+  for (i = 0; i < lines_n; ++i) {
+    kmesh->nb_off[junction_of[shape->lines[i].a] + 1]++;
+    kmesh->nb_off[junction_of[shape->lines[i].b] + 1]++;
+  }
+  for (i = 0; i < points_n; ++i) {
+    kmesh->lines[i] = (float) kmesh->nb_off[i + 1];
+    kmesh->nb_off[i + 1] += kmesh->nb_off[i];
+  }
+
+  uint32_t *fill = point_of; // no longer needed
+  memcpy(fill, kmesh->nb_off, points_n * sizeof(uint32_t));
+  for (i = 0; i < lines_n; ++i) {
+    uint32_t a = junction_of[shape->lines[i].a], b = junction_of[shape->lines[i].b];
+    kmesh->nb[fill[a]++] = b;
+    kmesh->nb[fill[b]++] = a;
+  }
+
+  uint32_t r = 0;
+  for (i = 0; i < (uint32_t) shape->points_n; ++i) {
+    uint32_t j = junction_of[i];
+    kmesh->edge[j] = shape->points[i].is_edge ? 1.0f : 0.0f;
+  }
+  for (i = 0; i < points_n; ++i) {
+    if (kmesh->edge[i] != 0.f) {
+      kmesh->rim[r++] = i;
+    }
+    kmesh->lines_sum += kmesh->lines[i];
+  }
+
+  // mesh_strike() without the tiles
+  uint32_t struck[MESH_STRIKE_MAX];
+  float x, y;
+  t_mesh_strike *strike = &kmesh->strike;
+
+  mesh_strike_default(shape, &x, &y);
+  strike->n = mesh_strike_points(shape, x, y, struck, strike->weight);
+  strike->output = 0;
+  for (i = 0; i < strike->n; ++i) {
+    strike->junction[i] = junction_of[struck[i]];
+    strike->tile[i] = 0;
+    if (strike->junction[i] == 0) {
+      strike->output = strike->weight[i];
+    }
+  }
+
+  free(point_of);
+  return kmesh;
+}
+
+void free_kmesh(t_kmesh *kmesh)
+{
+  free(kmesh->nb_off);
+  free(kmesh);
+}
+
+////////////////////////////////////////////////////////////////////
+
+size_t kmesh_state_size(const t_kmesh *kmesh)
+{
+  size_t floats = ALIGN_FLOATS(kmesh->points_n) * 2 + ALIGN_FLOATS(kmesh->rim_n) * 3;
+
+  return floats * sizeof(float) + MESH_ALIGN;
+}
+
+void kmesh_state_init(const t_kmesh *kmesh, t_kmesh_state *state, void *block)
+{
+  uintptr_t base = ((uintptr_t) block + MESH_ALIGN - 1) & ~((uintptr_t) MESH_ALIGN - 1);
+
+  memset(block, 0, kmesh_state_size(kmesh));
+
+  state->p = (float *) base;
+  state->d = state->p + ALIGN_FLOATS(kmesh->points_n);
+  state->r = state->d + ALIGN_FLOATS(kmesh->points_n);
+  state->s = state->r + ALIGN_FLOATS(kmesh->rim_n);
+  state->c = state->s + ALIGN_FLOATS(kmesh->rim_n);
+  state->e1 = 0.f;
+  state->e2 = 0.f;
+  state->strike = &kmesh->strike;
+  state->change = 0;
+  state->level = 0;
+  state->offset = 0.f;
+}
+
+float kmesh_state_energy(const t_kmesh *kmesh, const t_kmesh_state *state)
+{
+  float energy = 0;
+
+  for (uint32_t i = 0; i < kmesh->points_n; ++i) {
+    float p = state->p[i] + state->offset;
+    energy += p * p;
+  }
+  return energy;
+}
+
+void kmesh_state_clear(const t_kmesh *kmesh, t_kmesh_state *state)
+{
+  memset(state->p, 0, ALIGN_FLOATS(kmesh->points_n) * sizeof(float));
+  memset(state->d, 0, ALIGN_FLOATS(kmesh->points_n) * sizeof(float));
+  memset(state->r, 0, ALIGN_FLOATS(kmesh->rim_n) * sizeof(float));
+  memset(state->s, 0, ALIGN_FLOATS(kmesh->rim_n) * sizeof(float));
+  memset(state->c, 0, ALIGN_FLOATS(kmesh->rim_n) * sizeof(float));
+  state->e1 = 0.f;
+  state->e2 = 0.f;
+  state->change = 0;
+  state->level = 0;
+  state->offset = 0.f;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// one sample, see Membrane_kmesh.h for the update. it is taken in
+// difference form: with d = p(n) - p(n-1),
+//
+//   sum_k p_k + c p - (L + c) p(n-1) = sum_k (p_k - p) + (L + c) d
+//
+// and d(n+1) replaces p(n-1). a heavy self loop puts every mode close to
+// DC, where p(n) and p(n-1) nearly cancel in the direct form and float
+// rounding detunes the modes audibly within seconds. for the same reason
+// the decay per sample is kept apart from the 1 it is close to
+
+template <int MODEL>
+static float kmesh_cycle_model(const t_kmesh *kmesh, t_kmesh_state *state,
+                               float input, float yj_r, float loss)
+{
+  const uint32_t *nb_off = kmesh->nb_off;
+  const uint32_t *nb = kmesh->nb;
+  float *p = state->p;
+  float *d = state->d;
+  uint32_t i;
+
+  const t_mesh_strike *strike = state->strike;
+  float excite = loss * (input - state->e2);
+  float damping = 1.0f - loss;
+
+  state->e2 = state->e1;
+  state->e1 = input;
+
+  for (i = 0; i < kmesh->points_n; ++i) {
+    float total = 0;
+    float here = p[i];
+
+    for (uint32_t k = nb_off[i]; k < nb_off[i + 1]; ++k) {
+      total += p[nb[k]] - here;
+    }
+
+    float lines = kmesh->lines[i];
+    float rim = (MODEL & MESH_RIM_GUIDES) ? kmesh->edge[i] : 0.f;
+    float damp;
+
+    // d(n+1) = g (2/Y) sum_k (p_k - p) + (1 - damp) d, where 1 - damp is
+    // 2 g (L + c) / Y - 1. damp is formed from 1 - g, which is exact, as
+    // the slowest modes decay by little more than damp itself
+    if (MODEL & MESH_SELF_LOOP) {
+      total = 2.0f * total * yj_r;
+      damp = 2.0f * damping + 2.0f * loss * rim * yj_r;
+    }
+    else {
+      // a one-point mesh has neither: keep it silent instead of 0/0
+      float scale = 2.0f / fmaxf(lines + rim, 1.0f);
+      total *= scale;
+      damp = (damping * lines + rim) * scale;
+    }
+
+    d[i] = d[i] + (loss * total - damp * d[i]);
+  }
+
+  // the strike, after the junctions as in mesh_cycle()
+  for (uint32_t s = 0; s < strike->n; ++s) {
+    d[strike->junction[s]] += strike->weight[s] * excite;
+  }
+
+  // r(n+1) from r(n) and p(n) as mesh_rim() does, then its change since
+  // r(n-1) goes into the junction
+  if (MODEL & MESH_RIM_GUIDES) {
+    for (uint32_t r = 0; r < kmesh->rim_n; ++r) {
+      uint32_t j = kmesh->rim[r];
+      float inverted = state->r[r] - p[j];
+      float next;
+
+      if (MODEL & MESH_RIM_FILTER) {
+        next = (inverted + state->c[r]) * 0.5f;
+        state->c[r] = inverted;
+      }
+      else {
+        next = inverted;
+      }
+
+      float scale = (MODEL & MESH_SELF_LOOP) ? 2.0f * yj_r : 2.0f / (kmesh->lines[j] + 1.0f);
+      d[j] += loss * scale * (next - state->s[r]);
+      state->s[r] = next;
+    }
+
+    float *tmp = state->r;
+    state->r = state->s;
+    state->s = tmp;
+  }
+
+  // every neighbour has read p(n), move on. without rim guides a constant
+  // pressure is a solution of the update that the W mesh does not have:
+  // in exact arithmetic it is never excited, in float rounding feeds it and
+  // nothing takes it out again. its weighted sum sum_i w_i p_i, with w_i
+  // 1 / (2/Y) (1 with the self loop, L without), follows a recursion of its
+  // own, so it is tracked exactly and the drift returned as an offset
+  if (MODEL & MESH_RIM_GUIDES) {
+    for (i = 0; i < kmesh->points_n; ++i) {
+      p[i] += d[i];
+    }
+  }
+  else {
+    double level = 0;
+    for (i = 0; i < kmesh->points_n; ++i) {
+      p[i] += d[i];
+      level += (MODEL & MESH_SELF_LOOP) ? p[i] : kmesh->lines[i] * p[i];
+    }
+
+    double weight = (MODEL & MESH_SELF_LOOP) ? kmesh->points_n : kmesh->lines_sum;
+    double excited = 0;
+    for (uint32_t s = 0; s < strike->n; ++s) {
+      uint32_t j = strike->junction[s];
+      excited += strike->weight[s] * ((MODEL & MESH_SELF_LOOP) ? 1.0 : kmesh->lines[j]);
+    }
+
+    state->change = (1.0 - 2.0 * damping) * state->change + excite * excited;
+    state->level += state->change;
+    state->offset = weight > 0 ? (float) ((state->level - level) / weight) : 0.f;
+  }
+
+  return p[0] + state->offset;
+}
+
+static const t_kmesh_cycle_fn kmesh_cycle_scalar[MESH_MODEL_N] = MESH_MODEL_TABLE(kmesh_cycle_model);
+
+t_kmesh_cycle_fn kmesh_kernel(int model)
+{
+  return kmesh_cycle_scalar[(model >= 0 && model < MESH_MODEL_N) ? model : MESH_MODEL_DEFAULT];
+}
@@ -0,0 +1,90 @@
+
+#ifndef Membrane_kmesh_h
+#define Membrane_kmesh_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Membrane_shape.h"
+#include "Membrane_mesh.h"
+
+// The mesh in K-variable (finite difference) form: instead of two delays
+// per line plus self loops and rim guides, only the junction pressures of
+// the last two samples are kept, two floats per junction (see
+// kmesh_cycle_model() for the form they are kept in), and with rim guides
+// three per rim junction: r(n), r(n-1) and the MESH_RIM_FILTER memory.
+//
+// For a junction with L line ports, rim guide R (0 or 1), self loop weight
+// c = yj - L - R (0 without self loops) and admittance Y (yj, or L + R
+// without self loops), the W-variable mesh gives
+//
+//   p(n+1) = g (2/Y) (sum_k p_k(n) + c p(n) - (L + c) p(n-1) + R dr(n))
+//            + g (e(n+1) - e(n-1)) + p(n-1)
+//
+// where p_k are the neighbours, g the loss, e the excitation a junction
+// takes and dr(n) = r(n+1) - r(n-1) the change of its rim guide, which
+// with MESH_RIM_FILTER has memory of its own and so is still run as a
+// delay. it follows from eliminating the line and self loop delays from
+// mesh_cycle(), and starting both from silence the outputs are the same
+// up to rounding: in double precision the two agree to 1e-12. the W mesh's
+// lossless parasitic modes, which are never heard, do not exist here.
+//
+// in float neither is exact. over two seconds of a struck StoneChime3 or
+// SCFrag46 the W mesh drifts up to 2.3e-3 of the peak from the double
+// precision result, this form at most 8e-4 (7e-5 for the default model).
+// MembraneBench checks every model against mesh_cycle() within
+// KMESH_TOLERANCE, which has to allow for the errors of both.
+
+#define KMESH_TOLERANCE 5e-3f // peak-relative, against mesh_cycle()
+
+// junctions numbered as compile_mesh() does, so a t_mesh_strike of the
+// compiled mesh strikes the same junctions here
+typedef struct {
+  uint32_t points_n;
+  uint32_t lines_n;
+  uint32_t rim_n;
+
+  uint32_t *nb_off;  // neighbours of junction i: nb[nb_off[i] .. nb_off[i+1]-1]
+  uint32_t *nb;
+  uint32_t *rim;     // the junction of every rim guide
+  float *lines;      // L per junction
+  float *edge;       // R per junction
+  double lines_sum;  // sum of L
+  t_mesh_strike strike; // at the mesh's default point, tiles unused
+} t_kmesh;
+
+// the pressures and their last change, updated in place; the rim guides
+// as two levels swapped after every sample
+typedef struct {
+  float *p;      // p(n), less offset
+  float *d;      // p(n) - p(n-1)
+  float *r;      // rim guides r(n)
+  float *s;      // r(n-1), overwritten with r(n+1)
+  float *c;      // previous inverted rim output (MESH_RIM_FILTER)
+  float e1;      // input u(n) and u(n-1); junction i takes e = weight u
+  float e2;
+  const t_mesh_strike *strike; // the kmesh's own after kmesh_state_init()
+  // the constant pressure mode without rim guides, see kmesh_cycle_model()
+  double change;
+  double level;
+  float offset;  // added to every p
+} t_kmesh_state;
+
+// NRT: NULL if out of memory
+t_kmesh *compile_kmesh(const t_shape *shape, int order);
+void free_kmesh(t_kmesh *kmesh);
+
+size_t kmesh_state_size(const t_kmesh *kmesh);
+void kmesh_state_init(const t_kmesh *kmesh, t_kmesh_state *state, void *block);
+// like mesh_state_energy(), the junction pressures are the state
+float kmesh_state_energy(const t_kmesh *kmesh, const t_kmesh_state *state);
+void kmesh_state_clear(const t_kmesh *kmesh, t_kmesh_state *state);
+
+// yj enters only as its reciprocal
+typedef float (*t_kmesh_cycle_fn)(const t_kmesh *kmesh, t_kmesh_state *state,
+                                  float input, float yj_r, float loss);
+
+// one sample, returns the junction-0 pressure like mesh_cycle(). unknown
+// model ids fall back to MESH_MODEL_DEFAULT
+t_kmesh_cycle_fn kmesh_kernel(int model);
+
+#endif
@@ -0,0 +1,899 @@
+//Reference: Membrane.cpp by Alex McLean (c) 2008
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "Membrane_mesh.h"
+#include "Membrane_simd.h"
+#include "Membrane_stencil.h"
+
+#define ALIGN_FLOATS(n) (((n) + (MESH_ALIGN / sizeof(float)) - 1) & ~(MESH_ALIGN / sizeof(float) - 1))
+
+////////////////////////////////////////////////////////////////////
+
+#define NO_RIM 0xffffffffu
+
+// the rim guide delay of junction i, or NO_RIM. a rim guide is always the
+// junction's last port
+static uint32_t rim_of(const t_mesh *mesh, uint32_t i)
+{
+  uint32_t p0 = mesh->port_off[i];
+  uint32_t p1 = mesh->port_off[i + 1];
+
+  if (p1 > p0 && mesh->out[p1 - 1] >= mesh->line_d) {
+    return mesh->out[p1 - 1];
+  }
+  return NO_RIM;
+}
+
+// Cuthill-McKee: breadth first from junction 0, neighbours taken in order
+// of increasing degree, so junctions that exchange waves get nearby
+// numbers. junction 0 stays the pickup. fills point_of[junction] = shape id;
+// 0 if out of memory
+static int mesh_order_cm(const t_shape *shape, uint32_t *point_of)
+{
+  uint32_t points_n = shape->points_n;
+  uint32_t *adj_off = (uint32_t *) calloc(points_n + 1, sizeof(uint32_t));
+  uint32_t *adj = (uint32_t *) calloc((size_t) shape->lines_n * 2 + 1, sizeof(uint32_t));
+  char *visited = (char *) calloc(points_n + 1, 1);
+  uint32_t *fill = (uint32_t *) calloc(points_n + 1, sizeof(uint32_t));
+  uint32_t i, n = 0;
+
+  if (!adj_off || !adj || !visited || !fill) {
+    free(adj_off);
+    free(adj);
+    free(visited);
+    free(fill);
+    return 0;
+  }
+
+  for (i = 0; i < (uint32_t) shape->lines_n; ++i) {
+    adj_off[shape->lines[i].a + 1]++;
+    adj_off[shape->lines[i].b + 1]++;
+  }
+  for (i = 0; i < points_n; ++i) {
+    adj_off[i + 1] += adj_off[i];
+  }
+  for (i = 0; i < (uint32_t) shape->lines_n; ++i) {
+    uint32_t a = shape->lines[i].a, b = shape->lines[i].b;
+    adj[adj_off[a] + fill[a]++] = b;
+    adj[adj_off[b] + fill[b]++] = a;
+  }
+  free(fill);
+
+  // point_of doubles as the breadth first queue
+  uint32_t head = 0;
+  uint32_t seed = 0;
+
+  while (1) {
+    for (; head < n; ++head) {
+      uint32_t j = point_of[head];
+      uint32_t first = n;
+
+      for (uint32_t q = adj_off[j]; q < adj_off[j + 1]; ++q) {
+        uint32_t k = adj[q];
+        if (!visited[k]) {
+          visited[k] = 1;
+          point_of[n++] = k;
+        }
+      }
+      // insertion sort the new neighbours by degree, at most six
+      for (uint32_t x = first + 1; x < n; ++x) {
+        uint32_t k = point_of[x];
+        uint32_t deg = adj_off[k + 1] - adj_off[k];
+        uint32_t y = x;
+        while (y > first && adj_off[point_of[y - 1] + 1] - adj_off[point_of[y - 1]] > deg) {
+          point_of[y] = point_of[y - 1];
+          --y;
+        }
+        point_of[y] = k;
+      }
+    }
+
+    // disconnected parts start again from their lowest id
+    while (seed < points_n && visited[seed]) {
+      ++seed;
+    }
+    if (seed >= points_n) {
+      break;
+    }
+    visited[seed] = 1;
+    point_of[n++] = seed;
+  }
+
+  free(visited);
+  free(adj);
+  free(adj_off);
+  return 1;
+}
+
+// lattice rows top to bottom, left to right within a row: neighbours are
+// at most a row apart, so the delays a row reads were touched a row ago.
+// junction 0 still comes first
+static void mesh_order_rows(const t_shape *shape, uint32_t *point_of)
+{
+  const t_point *points = shape->points;
+
+  for (uint32_t i = 0; i < (uint32_t) shape->points_n; ++i) {
+    point_of[i] = i;
+  }
+  std::sort(point_of, point_of + shape->points_n, [&](uint32_t x, uint32_t y) {
+    if ((x == 0) != (y == 0)) return x == 0;
+    if (points[x].y != points[y].y) return points[x].y < points[y].y;
+    return points[x].x < points[y].x;
+  });
+}
+
+void mesh_order(const t_shape *shape, int order, uint32_t *point_of)
+{
+  if (order == MESH_ORDER_CM && mesh_order_cm(shape, point_of)) {
+    return;
+  }
+  if (order == MESH_ORDER_ROWS) {
+    mesh_order_rows(shape, point_of);
+  }
+  else {
+    for (uint32_t i = 0; i < (uint32_t) shape->points_n; ++i) {
+      point_of[i] = i;
+    }
+  }
+}
+
+// out of memory half way through compile_mesh()
+static t_mesh *compile_mesh_fail(t_mesh *mesh, uint32_t *count, uint32_t *slot, uint32_t *point_of)
+{
+  free(count);
+  free(slot);
+  free(point_of);
+  free_mesh(mesh);
+  return NULL;
+}
+
+t_mesh *compile_mesh(const t_shape *shape, int order)
+{
+  uint32_t points_n = shape->points_n;
+  uint32_t *count = NULL;
+  uint32_t *point_of = NULL;
+  uint32_t *slot = NULL;
+  uint32_t i, p;
+
+  t_mesh *mesh = (t_mesh *) calloc(1, sizeof(t_mesh));
+  if (!mesh) {
+    return NULL;
+  }
+
+  mesh->points_n = points_n;
+  mesh->lines_n = shape->lines_n;
+  mesh->edge_n = shape->edge_n;
+  mesh->line_d = shape->lines_n * 2;
+  mesh->rim_d = mesh->line_d + shape->edge_n;
+  mesh->port_n = mesh->rim_d;
+  mesh->delay_n = mesh->rim_d + points_n;
+
+  // offsets, line ends, junction numbers, in and out live in one allocation
+  mesh->port_off = (uint32_t *) calloc((size_t) points_n * 3 + 1 + (size_t) mesh->port_n * 2,
+                                       sizeof(uint32_t));
+  point_of = (uint32_t *) calloc(points_n + 1, sizeof(uint32_t));
+  count = (uint32_t *) calloc(points_n + 1, sizeof(uint32_t));
+  slot = (uint32_t *) calloc(mesh->lines_n + 1, sizeof(uint32_t));
+  if (!mesh->port_off || !point_of || !count || !slot) {
+    return compile_mesh_fail(mesh, count, slot, point_of);
+  }
+  mesh->line_end = mesh->port_off + points_n + 1;
+  mesh->junction_of = mesh->line_end + points_n;
+  mesh->in = mesh->junction_of + points_n;
+  mesh->out = mesh->in + mesh->port_n;
+
+  // junction numbering
+  mesh_order(shape, order, point_of);
+  for (i = 0; i < points_n; ++i) {
+    mesh->junction_of[point_of[i]] = i;
+  }
+  const uint32_t *jof = mesh->junction_of;
+
+  // line delays in order of their lower junction, so a junction's delays
+  // sit next to its neighbours'
+  for (i = 0; i < mesh->lines_n; ++i) {
+    uint32_t a = jof[shape->lines[i].a], b = jof[shape->lines[i].b];
+    count[(a < b ? a : b) + 1]++;
+  }
+  for (i = 0; i < points_n; ++i) {
+    count[i + 1] += count[i];
+  }
+  for (i = 0; i < mesh->lines_n; ++i) {
+    uint32_t a = jof[shape->lines[i].a], b = jof[shape->lines[i].b];
+    slot[i] = count[a < b ? a : b]++;
+  }
+  memset(count, 0, (points_n + 1) * sizeof(uint32_t));
+
+  // count ports per junction, then prefix sum
+  for (i = 0; i < mesh->lines_n; ++i) {
+    count[jof[shape->lines[i].a]]++;
+    count[jof[shape->lines[i].b]]++;
+  }
+  for (i = 0; i < points_n; ++i) {
+    count[i] += shape->points[point_of[i]].is_edge ? 1 : 0;
+  }
+
+  mesh->port_off[0] = 0;
+  for (i = 0; i < points_n; ++i) {
+    mesh->port_off[i + 1] = mesh->port_off[i] + count[i];
+    count[i] = mesh->port_off[i];
+  }
+
+  // same port order as the original pointer mesh, so sums round identically
+  for (i = 0; i < mesh->lines_n; ++i) {
+    const t_line *line = &shape->lines[i];
+    uint32_t d = slot[i] * 2;
+
+    // leftward delay d is written by a and read by b, rightward d+1 the reverse
+    p = count[jof[line->a]]++;
+    mesh->out[p] = d;
+    mesh->in[p] = d + 1;
+
+    p = count[jof[line->b]]++;
+    mesh->in[p] = d;
+    mesh->out[p] = d + 1;
+  }
+  free(slot);
+  slot = NULL;
+
+  uint32_t r = mesh->line_d;
+  for (i = 0; i < points_n; ++i) {
+    mesh->line_end[i] = count[i];
+    if (shape->points[point_of[i]].is_edge) {
+      p = count[i]++;
+      mesh->in[p] = r;
+      mesh->out[p] = r;
+      r++;
+    }
+  }
+
+  free(count);
+  count = NULL;
+
+  // padded slot-major copy for the SIMD kernels
+  uint32_t pad = (points_n + MESH_SIMD_WIDTH - 1) & ~(MESH_SIMD_WIDTH - 1);
+  size_t ell_n = (size_t) pad * MESH_MAX_PORTS;
+
+  mesh->points_pad = pad;
+  mesh->zero_d = mesh->rim_d + pad;
+  mesh->dump_d = mesh->zero_d + 1;
+
+  for (int rim = 0; rim < 2; ++rim) {
+    t_mesh_ell *ell = &mesh->ell[rim];
+    const uint32_t *end = rim ? mesh->port_off + 1 : mesh->line_end;
+
+    ell->in = (uint32_t *) calloc(ell_n * 2 + pad, sizeof(uint32_t));
+    if (!ell->in) {
+      return compile_mesh_fail(mesh, count, slot, point_of);
+    }
+    ell->out = ell->in + ell_n;
+    ell->ports = (float *) (ell->out + ell_n);
+
+    for (i = 0; i < pad; ++i) {
+      uint32_t p0 = i < points_n ? mesh->port_off[i] : 0;
+      uint32_t ports = i < points_n ? end[i] - p0 : 0;
+
+      for (uint32_t s = 0; s < MESH_MAX_PORTS; ++s) {
+        ell->in[s * pad + i] = s < ports ? mesh->in[p0 + s] : mesh->zero_d;
+        ell->out[s * pad + i] = s < ports ? mesh->out[p0 + s] : mesh->dump_d;
+      }
+      // padding junctions count one port so the divide without self loops stays finite
+      ell->ports[i] = i < points_n ? (float) ports : 1.0f;
+    }
+  }
+
+  // bands of lattice rows for the temporally blocked mode. neighbours are
+  // at most one row apart, so a tile only touches the tiles next to it
+  int y_min = 0, y_max = 0;
+  for (i = 0; i < points_n; ++i) {
+    int y = shape->points[point_of[i]].y;
+    y_min = (i == 0 || y < y_min) ? y : y_min;
+    y_max = (i == 0 || y > y_max) ? y : y_max;
+  }
+
+  mesh->tile_n = (uint32_t) ((y_max - y_min) / MESH_TILE_ROWS + 1);
+  mesh->tile_off = (uint32_t *) calloc(((size_t) mesh->tile_n + 1) * 2 + (size_t) points_n * 2,
+                                       sizeof(uint32_t));
+  count = (uint32_t *) calloc((size_t) mesh->tile_n * 2, sizeof(uint32_t));
+  if (!mesh->tile_off || !count) {
+    return compile_mesh_fail(mesh, count, slot, point_of);
+  }
+  mesh->tile_rim_off = mesh->tile_off + mesh->tile_n + 1;
+  mesh->tile_junctions = mesh->tile_rim_off + mesh->tile_n + 1;
+  mesh->tile_rim = mesh->tile_junctions + points_n;
+
+  for (i = 0; i < points_n; ++i) {
+    uint32_t k = (uint32_t) ((shape->points[point_of[i]].y - y_min) / MESH_TILE_ROWS);
+    mesh->tile_off[k + 1]++;
+    mesh->tile_rim_off[k + 1] += rim_of(mesh, i) != NO_RIM ? 1 : 0;
+  }
+  for (i = 0; i < mesh->tile_n; ++i) {
+    mesh->tile_off[i + 1] += mesh->tile_off[i];
+    mesh->tile_rim_off[i + 1] += mesh->tile_rim_off[i];
+  }
+
+  for (i = 0; i < points_n; ++i) {
+    uint32_t k = (uint32_t) ((shape->points[point_of[i]].y - y_min) / MESH_TILE_ROWS);
+    uint32_t rim = rim_of(mesh, i);
+
+    mesh->tile_junctions[mesh->tile_off[k] + count[k]++] = i;
+    if (rim != NO_RIM) {
+      mesh->tile_rim[mesh->tile_rim_off[k] + count[mesh->tile_n + k]++] = rim;
+    }
+  }
+  free(count);
+  free(point_of);
+
+  float x, y;
+  mesh_strike_default(shape, &x, &y);
+  mesh_strike(mesh, shape, x, y, &mesh->strike);
+
+  return mesh;
+}
+
+void free_mesh(t_mesh *mesh)
+{
+  free(mesh->port_off);
+  free(mesh->ell[0].in);
+  free(mesh->ell[1].in);
+  free(mesh->tile_off);
+  free(mesh);
+}
+
+////////////////////////////////////////////////////////////////////
+
+size_t mesh_state_size(const t_mesh *mesh)
+{
+  // room for padded self loops and the zero/dump slots of the SIMD kernels
+  size_t floats = ALIGN_FLOATS(mesh->dump_d + 1) * 2
+    + ALIGN_FLOATS(mesh->rim_d - mesh->line_d);
+
+  return floats * sizeof(float) + MESH_ALIGN;
+}
+
+void mesh_state_init(const t_mesh *mesh, t_mesh_state *state, void *block)
+{
+  uintptr_t base = ((uintptr_t) block + MESH_ALIGN - 1) & ~((uintptr_t) MESH_ALIGN - 1);
+
+  memset(block, 0, mesh_state_size(mesh));
+
+  state->a = (float *) base;
+  state->b = state->a + ALIGN_FLOATS(mesh->dump_d + 1);
+  state->c = state->b + ALIGN_FLOATS(mesh->dump_d + 1);
+  state->strike = &mesh->strike;
+}
+
+// every delay pair satisfies outgoing + incoming = junction pressure, with
+// the incoming value still in a after the swap. the delay values themselves
+// also carry the mesh's lossless parasitic modes (pressures summing to
+// zero), which never decay but are never heard either
+float mesh_state_energy(const t_mesh *mesh, int model, const t_mesh_state *state)
+{
+  float energy = 0;
+
+  for (uint32_t i = 0; i < mesh->points_n; ++i) {
+    float total;
+
+    if (model & MESH_SELF_LOOP) {
+      uint32_t d = mesh->rim_d + i;
+      total = state->b[d] + state->a[d];
+    }
+    else {
+      uint32_t p = mesh->port_off[i];
+      // rim guides are filtered in place, only line ports keep the relation
+      if (p == mesh->line_end[i]) {
+        continue;
+      }
+      total = state->b[mesh->out[p]] + state->a[mesh->in[p]];
+    }
+    energy += total * total;
+  }
+  return energy;
+}
+
+void mesh_state_clear(const t_mesh *mesh, t_mesh_state *state)
+{
+  memset(state->a, 0, ALIGN_FLOATS(mesh->dump_d + 1) * sizeof(float));
+  memset(state->b, 0, ALIGN_FLOATS(mesh->dump_d + 1) * sizeof(float));
+  memset(state->c, 0, ALIGN_FLOATS(mesh->rim_d - mesh->line_d) * sizeof(float));
+}
+
+////////////////////////////////////////////////////////////////////
+
+uint32_t mesh_point_near(const t_shape *shape, float x, float y)
+{
+  const t_point *points = shape->points;
+  uint32_t best = 0;
+  float best_d = 0;
+
+  x += points[0].x;
+  y += points[0].y;
+  for (uint32_t i = 0; i < (uint32_t) shape->points_n; ++i) {
+    float dx = points[i].x - x;
+    float dy = points[i].y - y;
+    float d = dx * dx + 3.0f * dy * dy;
+
+    if (i == 0 || d < best_d) {
+      best = i;
+      best_d = d;
+    }
+  }
+  return best;
+}
+
+int mesh_pickup(const t_mesh *mesh, int model, uint32_t point, t_mesh_pickup *pickup)
+{
+  uint32_t i = mesh->junction_of[point];
+  uint32_t p = mesh->port_off[i];
+
+  if (model & MESH_SELF_LOOP) {
+    pickup->out = mesh->rim_d + i;
+    pickup->in = mesh->rim_d + i;
+    return 1;
+  }
+  // rim guides are filtered in place, only line ports keep the relation
+  if (p == mesh->line_end[i]) {
+    return 0;
+  }
+  pickup->out = mesh->out[p];
+  pickup->in = mesh->in[p];
+  return 1;
+}
+
+uint32_t mesh_strike_points(const t_shape *shape, float x, float y, uint32_t *points,
+                            float *weights)
+{
+  const t_point *shape_points = shape->points;
+  const float reach = MESH_STRIKE_RADIUS * MESH_STRIKE_RADIUS;
+  uint32_t n = 0;
+  float sum = 0;
+
+  // a lone junction without lines stays silent, as it always has. the
+  // K-variable form of it (Membrane_kmesh.h) has undamped modes at DC and
+  // Nyquist that rounding would drive
+  if (shape->lines_n == 0) {
+    return 0;
+  }
+  const t_point *centre = &shape_points[mesh_point_near(shape, x, y)];
+
+  for (uint32_t i = 0; i < (uint32_t) shape->points_n && n < MESH_STRIKE_MAX; ++i) {
+    float dx = (float) (shape_points[i].x - centre->x);
+    float dy = (float) (shape_points[i].y - centre->y);
+    float d = dx * dx + 3.0f * dy * dy;
+
+    if (d < reach) {
+      points[n] = i;
+      weights[n] = 0.5f + 0.5f * cosf((float) M_PI * sqrtf(d) / MESH_STRIKE_RADIUS);
+      sum += weights[n];
+      n++;
+    }
+  }
+  for (uint32_t k = 0; k < n; ++k) {
+    weights[k] /= sum;
+  }
+  return n;
+}
+
+void mesh_strike_default(const t_shape *shape, float *x, float *y)
+{
+  const t_point *points = shape->points;
+  int half = shape->points_n / 2;
+  double sx = 0, sy = 0;
+
+  for (int i = 0; i < half; ++i) {
+    sx += points[i].x - points[0].x;
+    sy += points[i].y - points[0].y;
+  }
+  *x = half > 0 ? (float) (sx / half) : 0.f;
+  *y = half > 0 ? (float) (sy / half) : 0.f;
+}
+
+void mesh_strike(const t_mesh *mesh, const t_shape *shape, float x, float y,
+                 t_mesh_strike *strike)
+{
+  uint32_t points[MESH_STRIKE_MAX];
+
+  strike->n = mesh_strike_points(shape, x, y, points, strike->weight);
+  strike->output = 0;
+  for (uint32_t s = 0; s < strike->n; ++s) {
+    strike->junction[s] = mesh->junction_of[points[s]];
+    strike->tile[s] = 0;
+    if (strike->junction[s] == 0) {
+      strike->output = strike->weight[s];
+    }
+  }
+
+  for (uint32_t k = 0; k < mesh->tile_n; ++k) {
+    for (uint32_t j = mesh->tile_off[k]; j < mesh->tile_off[k + 1]; ++j) {
+      for (uint32_t s = 0; s < strike->n; ++s) {
+        if (strike->junction[s] == mesh->tile_junctions[j]) {
+          strike->tile[s] = k;
+        }
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+
+#define MXCSR_FTZ 0x8000
+#define MXCSR_DAZ 0x0040
+#define FPCR_FZ (1u << 24)
+
+unsigned int mesh_denormals_flush()
+{
+#if defined(__SSE__)
+  unsigned int mode = _mm_getcsr();
+  _mm_setcsr(mode | MXCSR_FTZ | MXCSR_DAZ);
+  return mode;
+#elif defined(__aarch64__)
+  uint64_t mode;
+  __asm__ __volatile__("mrs %0, fpcr" : "=r"(mode));
+  __asm__ __volatile__("msr fpcr, %0" : : "r"(mode | FPCR_FZ));
+  return (unsigned int) mode;
+#else
+  return 0;
+#endif
+}
+
+void mesh_denormals_restore(unsigned int mode)
+{
+#if defined(__SSE__)
+  _mm_setcsr(mode);
+#elif defined(__aarch64__)
+  uint64_t fpcr = mode;
+  __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+#else
+  (void) mode;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////
+
+// scatter one junction: read its incoming delays from b, write the outgoing
+// ones to a and return the junction pressure. the model is a template
+// argument, so every variant compiles to its own branch-free loop. the
+// input comes in afterwards, see mesh_strike_add()
+
+template <int MODEL>
+static inline float mesh_junction(const t_mesh *mesh, uint32_t i, float *a, const float *b,
+                                  float yj, float yj_r, float loss)
+{
+  const uint32_t *in = mesh->in;
+  const uint32_t *out = mesh->out;
+  uint32_t p0 = mesh->port_off[i];
+  uint32_t p1 = (MODEL & MESH_RIM_GUIDES) ? mesh->port_off[i + 1] : mesh->line_end[i];
+  uint32_t p;
+  float total = 0;
+
+  for (p = p0; p < p1; ++p) {
+    total += b[in[p]];
+  }
+
+  if (MODEL & MESH_SELF_LOOP) {
+    float yc = yj - (int) (p1 - p0);
+    total = 2.0f * (total + (yc * b[mesh->rim_d + i])) * yj_r;
+  }
+  else {
+    // a junction without ports (a one-point mesh) sums nothing: it stays
+    // silent instead of 0/0
+    total *= (2.0f / ((float) (p1 > p0 ? p1 - p0 : 1)));
+  }
+
+  total *= loss;
+
+  for (p = p0; p < p1; ++p) {
+    a[out[p]] = total - b[in[p]];
+  }
+  if (MODEL & MESH_SELF_LOOP) {
+    a[mesh->rim_d + i] = total - b[mesh->rim_d + i];
+  }
+
+  return total;
+}
+
+// the inverting rim guide d has just been written to a; turn it into what
+// is read next sample
+template <int MODEL>
+static inline void mesh_rim(float *a, float *c, uint32_t d)
+{
+  if (MODEL & MESH_RIM_FILTER) {
+    float inverted = 0.0f - a[d];
+    a[d] = (inverted + *c) * 0.5f;
+    *c = inverted;
+  }
+  else {
+    a[d] = 0.f - a[d];
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+
+int mesh_lanes_stride(int lanes)
+{
+  int w = mesh_lanes_width;
+  return ((lanes + w - 1) / w) * w;
+}
+
+size_t mesh_lanes_size(const t_mesh *mesh, int lanes)
+{
+  size_t stride = (size_t) mesh_lanes_stride(lanes);
+  size_t floats = ALIGN_FLOATS(mesh->delay_n * stride) * 2
+    + ALIGN_FLOATS((mesh->rim_d - mesh->line_d) * stride);
+
+  return floats * sizeof(float) + MESH_ALIGN;
+}
+
+void mesh_lanes_init(const t_mesh *mesh, t_mesh_lanes *state, int lanes, void *block)
+{
+  uintptr_t base = ((uintptr_t) block + MESH_ALIGN - 1) & ~((uintptr_t) MESH_ALIGN - 1);
+
+  memset(block, 0, mesh_lanes_size(mesh, lanes));
+
+  state->lanes = lanes;
+  state->stride = mesh_lanes_stride(lanes);
+  state->a = (float *) base;
+  state->b = state->a + ALIGN_FLOATS(mesh->delay_n * state->stride);
+  state->c = state->b + ALIGN_FLOATS(mesh->delay_n * state->stride);
+  state->strike = &mesh->strike;
+}
+
+template <int MODEL>
+static void mesh_cycle_lanes(const t_mesh *mesh, t_mesh_lanes *state, const float *input,
+                             const float *yj, const float *yj_r, const float *loss, float *result)
+{
+  mesh_cycle_lanes_simd<V_scalar, MODEL>(mesh, state, input, yj, yj_r, loss, result);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// execute one sample cycle over the mesh
+
+template <int MODEL>
+static float mesh_cycle_model(const t_mesh *mesh, t_mesh_state *state,
+                              float input, float yj, float yj_r, float loss)
+{
+  float *a = state->a;
+  float *b = state->b;
+  uint32_t i;
+
+  float result = 0;
+
+  for (i = 0; i < mesh->points_n; ++i) {
+    float total = mesh_junction<MODEL>(mesh, i, a, b, yj, yj_r, loss);
+
+    if (i == 0) {
+      result = total;
+    }
+  }
+  result += mesh_strike_add<MODEL>(mesh, state->strike, a, loss * input);
+
+  // circulate the unit delays: filter the inverting rim guides in place,
+  // then what was written becomes what is read
+  if (MODEL & MESH_RIM_GUIDES) {
+    for (i = mesh->line_d; i < mesh->rim_d; ++i) {
+      mesh_rim<MODEL>(a, state->c + (i - mesh->line_d), i);
+    }
+  }
+
+  state->a = b;
+  state->b = a;
+
+  return(result);
+}
+
+float mesh_cycle(const t_mesh *mesh, t_mesh_state *state,
+                 float input, float yj, float yj_r, float loss)
+{
+  return mesh_cycle_model<MESH_MODEL_DEFAULT>(mesh, state, input, yj, yj_r, loss);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// temporal blocking. tile k is advanced to step t (1-based within the sweep)
+// in wave k + t - 1, tiles of the same wave in increasing step order. so
+// neighbouring tiles are never more than one step apart, which is all the
+// two ping-pong buffers need: a tile overwrites the step t-2 values only after
+// both neighbours have read them.
+
+int mesh_use_tiled(const t_mesh *mesh)
+{
+  return mesh->tile_n > 1 && mesh->delay_n >= MESH_TILE_MIN_DELAYS;
+}
+
+template <int MODEL>
+static void mesh_run_tiled_model(const t_mesh *mesh, t_mesh_state *state, const float *in,
+                                 float *out, int n, float yj, float yj_r, float loss)
+{
+  const t_mesh_strike *strike = state->strike;
+  int tile_n = (int) mesh->tile_n;
+
+  while (n > 0) {
+    int steps = n < MESH_TILE_STEPS ? n : MESH_TILE_STEPS;
+
+    for (int w = 0; w < tile_n + steps - 1; ++w) {
+      for (int t = 1; t <= steps; ++t) {
+        int k = w - (t - 1);
+        if (k < 0 || k >= tile_n) {
+          continue;
+        }
+
+        // odd steps write a, even steps write b
+        float *write = (t & 1) ? state->a : state->b;
+        const float *read = (t & 1) ? state->b : state->a;
+        float drive = loss * in[t - 1];
+
+        for (uint32_t j = mesh->tile_off[k]; j < mesh->tile_off[k + 1]; ++j) {
+          uint32_t i = mesh->tile_junctions[j];
+          float total = mesh_junction<MODEL>(mesh, i, write, read, yj, yj_r, loss);
+
+          if (i == 0) {
+            out[t - 1] = total + drive * strike->output;
+          }
+        }
+        // the struck junctions of this tile, before anything reads them
+        for (uint32_t s = 0; s < strike->n; ++s) {
+          if (strike->tile[s] == (uint32_t) k) {
+            mesh_strike_junction<MODEL>(mesh, strike->junction[s], write,
+                                        drive * strike->weight[s]);
+          }
+        }
+        if (!(MODEL & MESH_RIM_GUIDES)) {
+          continue;
+        }
+        for (uint32_t r = mesh->tile_rim_off[k]; r < mesh->tile_rim_off[k + 1]; ++r) {
+          uint32_t d = mesh->tile_rim[r];
+          mesh_rim<MODEL>(write, state->c + (d - mesh->line_d), d);
+        }
+      }
+    }
+
+    if (steps & 1) {
+      float *tmp = state->a;
+      state->a = state->b;
+      state->b = tmp;
+    }
+
+    in += steps;
+    out += steps;
+    n -= steps;
+  }
+}
+
+void mesh_run_tiled(const t_mesh *mesh, t_mesh_state *state, const float *in, float *out,
+                    int n, float yj, float yj_r, float loss)
+{
+  mesh_run_tiled_model<MESH_MODEL_DEFAULT>(mesh, state, in, out, n, yj, yj_r, loss);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// runtime kernel dispatch. the SIMD kernels live in Membrane_simd_*.cpp,
+// which are only compiled in on x86 (MEMBRANE_SIMD). every table is indexed
+// by model id
+
+#ifdef MEMBRANE_SIMD
+extern const t_mesh_cycle_fn mesh_cycle_sse2[MESH_MODEL_N];
+extern const t_mesh_cycle_fn mesh_cycle_avx2[MESH_MODEL_N];
+extern const t_mesh_cycle_fn mesh_cycle_avx512[MESH_MODEL_N];
+extern const t_mesh_lanes_fn mesh_cycle_lanes_sse2[MESH_MODEL_N];
+extern const t_mesh_lanes_fn mesh_cycle_lanes_avx2[MESH_MODEL_N];
+extern const t_mesh_lanes_fn mesh_cycle_lanes_avx512[MESH_MODEL_N];
+#endif
+
+static const t_mesh_cycle_fn mesh_cycle_scalar[MESH_MODEL_N] = MESH_MODEL_TABLE(mesh_cycle_model);
+static const t_mesh_lanes_fn mesh_cycle_lanes_scalar[MESH_MODEL_N] = MESH_MODEL_TABLE(mesh_cycle_lanes);
+static const t_mesh_run_fn mesh_run_tiled_scalar[MESH_MODEL_N] = MESH_MODEL_TABLE(mesh_run_tiled_model);
+
+static t_mesh_kernels mesh_kernels_best[MESH_MODEL_N] = {
+#define MESH_KERNELS_SCALAR(m) {mesh_cycle_model<m>, mesh_cycle_lanes<m>, mesh_run_tiled_model<m>}
+  MESH_KERNELS_SCALAR(0), MESH_KERNELS_SCALAR(1), MESH_KERNELS_SCALAR(2), MESH_KERNELS_SCALAR(3),
+  MESH_KERNELS_SCALAR(4), MESH_KERNELS_SCALAR(5), MESH_KERNELS_SCALAR(6), MESH_KERNELS_SCALAR(7)
+#undef MESH_KERNELS_SCALAR
+};
+int mesh_lanes_width = 1;
+
+static int mesh_model_valid(int model)
+{
+  return model >= 0 && model < MESH_MODEL_N;
+}
+
+const t_mesh_kernels *mesh_kernels(int model)
+{
+  return &mesh_kernels_best[mesh_model_valid(model) ? model : MESH_MODEL_DEFAULT];
+}
+
+t_mesh_cycle_fn mesh_kernel(int kernel, int model)
+{
+  if (!mesh_model_valid(model)) {
+    return NULL;
+  }
+  switch (kernel) {
+  case MESH_KERNEL_SCALAR:
+    return mesh_cycle_scalar[model];
+#ifdef MEMBRANE_SIMD
+  case MESH_KERNEL_SSE2:
+    return __builtin_cpu_supports("sse2") ? mesh_cycle_sse2[model] : NULL;
+  case MESH_KERNEL_AVX2:
+    return __builtin_cpu_supports("avx2") ? mesh_cycle_avx2[model] : NULL;
+  case MESH_KERNEL_AVX512:
+    return __builtin_cpu_supports("avx512f") ? mesh_cycle_avx512[model] : NULL;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+const char *mesh_kernel_name(int kernel)
+{
+  static const char *names[MESH_KERNEL_N] = {"scalar", "sse2", "avx2", "avx512"};
+  return (kernel >= 0 && kernel < MESH_KERNEL_N) ? names[kernel] : "unknown";
+}
+
+const char *mesh_model_name(int model)
+{
+  static const char *names[MESH_MODEL_N] = {
+    "plain", "self", "rim", "self+rim",
+    "filter", "self+filter", "rim+filter", "self+rim+filter"
+  };
+  return mesh_model_valid(model) ? names[model] : "unknown";
+}
+
+int mesh_model_of(float input)
+{
+  // compared as a float: NaN or a huge value cast to int is undefined
+  return (input >= 0.f && input < (float) MESH_MODEL_N) ? (int) input : -1;
+}
+
+int mesh_select_kernel(int max_kernel)
+{
+  const t_mesh_lanes_fn *lanes = mesh_cycle_lanes_scalar;
+  int kernel;
+
+#ifdef MEMBRANE_SIMD
+  __builtin_cpu_init();
+#endif
+
+  if (max_kernel >= MESH_KERNEL_N) {
+    max_kernel = MESH_KERNEL_N - 1;
+  }
+  for (kernel = max_kernel; kernel > MESH_KERNEL_SCALAR; --kernel) {
+    if (mesh_kernel(kernel, MESH_MODEL_DEFAULT)) {
+      break;
+    }
+  }
+
+  switch (kernel) {
+#ifdef MEMBRANE_SIMD
+  case MESH_KERNEL_SSE2:
+    lanes = mesh_cycle_lanes_sse2;
+    mesh_lanes_width = 4;
+    break;
+  case MESH_KERNEL_AVX2:
+    lanes = mesh_cycle_lanes_avx2;
+    mesh_lanes_width = 8;
+    break;
+  case MESH_KERNEL_AVX512:
+    lanes = mesh_cycle_lanes_avx512;
+    mesh_lanes_width = 16;
+    break;
+#endif
+  default:
+    mesh_lanes_width = 1;
+  }
+
+  for (int model = 0; model < MESH_MODEL_N; ++model) {
+    mesh_kernels_best[model].cycle = mesh_kernel(kernel, model);
+    mesh_kernels_best[model].lanes = lanes[model];
+    mesh_kernels_best[model].tiled = mesh_run_tiled_scalar[model];
+  }
+  stencil_select_kernel(kernel);
+  return kernel;
+}
@@ -0,0 +1,293 @@
+
+#ifndef Membrane_mesh_h
+#define Membrane_mesh_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Membrane_shape.h"
+
+// twiddle-ables for the mesh model, or-ed together into a model id that every
+// kernel is instantiated for, so a unit can pick its variant at init time
+enum {
+  MESH_SELF_LOOP = 1,  // for control over tension
+  MESH_RIM_GUIDES = 2, // extra self-loops around edge, which invert signal //엣지 룹
+  MESH_RIM_FILTER = 4, // average each rim reflection with the previous one
+  MESH_MODEL_N = 8,
+  MESH_MODEL_DEFAULT = MESH_SELF_LOOP | MESH_RIM_GUIDES | MESH_RIM_FILTER
+};
+
+#define MESH_ALIGN 64 // cache line
+#define MESH_MAX_PORTS 6 // six neighbours, or fewer plus a rim guide
+#define MESH_SIMD_WIDTH 16 // widest vector the junction table is padded for
+#define MESH_TILE_ROWS 4 // lattice rows per tile in the temporally blocked mode
+#define MESH_TILE_STEPS 8 // samples each tile advances per sweep
+#define MESH_TILE_MIN_DELAYS (16 * 1024) // below this the state stays in cache anyway
+#define MESH_QUIET_ENERGY 1e-14f // junction energy under which a silent mesh may sleep (~ -140 dB)
+#define MESH_TRIGGER_DURATION 1024 // samples of white noise a trigger injects
+
+// where the excitation enters: the junctions within MESH_STRIKE_RADIUS
+// lattice units of the struck one, weighted by a raised cosine of their
+// distance and normalised to a sum of 1. two rings of neighbours at most
+#define MESH_STRIKE_RADIUS 4.0f
+#define MESH_STRIKE_MAX 13
+
+// SIMD kernels keep the scalar operation order and never contract to FMA, so
+// they are expected to agree with mesh_cycle() up to the sign of zero. The
+// contract checked by MembraneBench is a peak-relative error below this.
+#define MESH_SIMD_TOLERANCE 1e-6f
+
+// the ports of every junction padded to MESH_MAX_PORTS slots, slot-major
+// (slot s of junction j at s * points_pad + j), for the SIMD kernels.
+// unused slots read zero_d and write dump_d, padding junctions do nothing.
+typedef struct {
+  uint32_t *in;
+  uint32_t *out;
+  float *ports; // number of ports per junction
+} t_mesh_ell;
+
+// a strike footprint, see MESH_STRIKE_RADIUS. the kernels take no input
+// in their junction loops: once those are done, loss * weight * input is
+// added to every delay a struck junction wrote, which by linearity is
+// what adding it to the junction's pressure would have done, and the rim
+// pass then filters it like the rest. a few dozen adds per sample
+typedef struct {
+  uint32_t n;
+  uint32_t junction[MESH_STRIKE_MAX];
+  uint32_t tile[MESH_STRIKE_MAX]; // for mesh_run_tiled()
+  float weight[MESH_STRIKE_MAX];
+  float output; // the weight of junction 0, whose pressure the kernels return
+} t_mesh_strike;
+
+// A shape compiled into flat index arrays (compressed sparse rows).
+// Each junction owns the ports port_off[i] .. port_off[i+1]-1; a port reads
+// the delay in[p] and writes the paired delay out[p]. Line ports come first
+// in line order, followed by the junction's rim guide if it has one, so the
+// line ports alone end at line_end[i].
+//
+// junctions are renumbered for locality at compile time (MESH_ORDER_ROWS);
+// junction_of[] maps a shape point id to its junction. junction 0 is always
+// shape point 0, the output.
+//
+// every model shares one topology: rim guides and self loops always have
+// their delays, models without them simply never touch those.
+//
+// delays are numbered by class:
+//   [0, line_d)        travelling waves, two per line
+//   [line_d, rim_d)    inverting rim guides, one per edge junction
+//   [rim_d, delay_n)   self loops, one per junction
+typedef struct {
+  uint32_t points_n;
+  uint32_t lines_n;
+  uint32_t edge_n;
+  uint32_t port_n;
+  uint32_t line_d;
+  uint32_t rim_d;
+  uint32_t delay_n;
+
+  uint32_t *port_off;
+  uint32_t *line_end;
+  uint32_t *junction_of;
+  uint32_t *in;
+  uint32_t *out;
+
+  // padded tables without ([0]) and with ([1]) the rim guide ports
+  uint32_t points_pad;
+  uint32_t zero_d;
+  uint32_t dump_d;
+  t_mesh_ell ell[2];
+
+  // junctions grouped into bands of MESH_TILE_ROWS lattice rows, for
+  // mesh_run_tiled(). tile k holds tile_junctions[tile_off[k] .. tile_off[k+1]-1]
+  // and owns the rim guides tile_rim[tile_rim_off[k] .. tile_rim_off[k+1]-1]
+  uint32_t tile_n;
+  uint32_t *tile_off;
+  uint32_t *tile_junctions;
+  uint32_t *tile_rim_off;
+  uint32_t *tile_rim;
+
+  // where a state is struck unless told otherwise, see mesh_strike_default()
+  t_mesh_strike strike;
+} t_mesh;
+
+// per-instance delay state, carved out of a single aligned block.
+// a and b are ping-pong buffers swapped after every sample, so circulating
+// the line and self loop delays costs nothing; only the rim guides are
+// filtered in place before the swap.
+typedef struct {
+  float *a; // written by the junctions this sample
+  float *b; // read by the junctions this sample
+  float *c; // previous inverted output of each rim guide (MESH_RIM_FILTER)
+  const t_mesh_strike *strike; // the mesh's own after mesh_state_init()
+} t_mesh_state;
+
+// delay state for several voices of one mesh, interleaved lane-major per
+// delay: lane l of delay d lives at d * stride + l. stride is the lane count
+// padded to the vector width of the selected lanes kernel
+typedef struct {
+  int lanes;
+  int stride;
+  float *a;
+  float *b;
+  float *c;
+  const t_mesh_strike *strike; // shared by every lane
+} t_mesh_lanes;
+
+// junction numbering for compile_mesh()
+enum {
+  MESH_ORDER_SHAPE = 0, // the shape's flood fill order
+  MESH_ORDER_CM,        // Cuthill-McKee from junction 0
+  MESH_ORDER_ROWS,      // lattice rows, fewest cache misses on big meshes
+  MESH_ORDER_DEFAULT = MESH_ORDER_ROWS
+};
+
+// fill point_of[junction] = shape point id for a MESH_ORDER_* numbering
+void mesh_order(const t_shape *shape, int order, uint32_t *point_of);
+
+// NRT: compile / free the shared topology. NULL if out of memory
+t_mesh *compile_mesh(const t_shape *shape, int order);
+void free_mesh(t_mesh *mesh);
+
+// bytes needed for one instance's state, including alignment slack
+size_t mesh_state_size(const t_mesh *mesh);
+// lay out and zero the state inside a block of mesh_state_size() bytes
+void mesh_state_init(const t_mesh *mesh, t_mesh_state *state, void *block);
+// sum of the squared junction pressures of the last cycle, O(junctions)
+float mesh_state_energy(const t_mesh *mesh, int model, const t_mesh_state *state);
+// zero a decayed mesh, e.g. before putting it to sleep
+void mesh_state_clear(const t_mesh *mesh, t_mesh_state *state);
+
+// a point to listen at besides junction 0. every delay pair of a junction
+// satisfies outgoing + incoming = its pressure, so after a cycle the
+// pressure is b[out] + a[in] of the swapped state: the self loop when the
+// model has them, else the first line port. no kernel has to know about
+// pickups, and one costs two loads and an add per sample. the pressure
+// equals what the kernel computed up to rounding
+typedef struct {
+  uint32_t out;
+  uint32_t in;
+} t_mesh_pickup;
+
+// the shape point nearest to (x, y) lattice units from point 0, in the
+// lattice's own metric (a row is sqrt(3) units of x apart)
+uint32_t mesh_point_near(const t_shape *shape, float x, float y);
+// the pickup of shape point id; 0 if the junction keeps no delay pair
+// under model (a one point mesh without self loops). zero_d always reads
+// zero, in every state
+int mesh_pickup(const t_mesh *mesh, int model, uint32_t point, t_mesh_pickup *pickup);
+
+static inline float mesh_pickup_read(const t_mesh_pickup *pickup, const float *a, const float *b)
+{
+  return b[pickup->out] + a[pickup->in];
+}
+
+// the footprint around the shape point nearest to (x, y) lattice units
+// from point 0, as shape point ids and weights; returns how many, none
+// for a mesh without lines
+uint32_t mesh_strike_points(const t_shape *shape, float x, float y, uint32_t *points,
+                            float *weights);
+// the point every mesh is struck at by default: the centre of the first
+// half of the shape's points, which took the whole input before strikes
+// had a position
+void mesh_strike_default(const t_shape *shape, float *x, float *y);
+// the footprint for the mesh compiled from shape. O(points) per struck
+// junction, no allocation: VarMembrane places it on the NRT thread
+void mesh_strike(const t_mesh *mesh, const t_shape *shape, float x, float y,
+                 t_mesh_strike *strike);
+
+// the unit parameters as the kernels take them, shared by every host.
+// some constants from Brook Eaton's roto-drum
+// http://www-ccrma.stanford.edu/~be/drum/drum.htm
+
+#define MESH_DELTA 6.0f // distance between junctions
+#define MESH_GAMMA 8.0f // wave speed
+
+// junction admittance from the tension parameter
+static inline float mesh_admittance(float tension)
+{
+  if (tension == 0) {
+    // default tension
+    tension =  0.0001;
+  }
+  return 2.f * MESH_DELTA * MESH_DELTA / (tension * tension * MESH_GAMMA * MESH_GAMMA);
+}
+
+static inline float mesh_loss(float loss)
+{
+  if (loss >= 1) {
+    loss = 0.99999;
+  }
+  return loss;
+}
+
+// subnormal floats make every kernel many times slower while decaying into
+// inaudibility. flush them to zero (FTZ/DAZ) until mesh_denormals_restore();
+// returns the previous mode. a no-op where the platform has no such mode
+unsigned int mesh_denormals_flush();
+void mesh_denormals_restore(unsigned int mode);
+
+// execute one sample cycle over the mesh, returns the junction-0 output.
+// this is the scalar reference kernel for MESH_MODEL_DEFAULT
+float mesh_cycle(const t_mesh *mesh, t_mesh_state *state,
+                 float input, float yj, float yj_r, float loss);
+
+// lane stride for a given voice count, padded for mesh_cycle_lanes_best
+int mesh_lanes_stride(int lanes);
+size_t mesh_lanes_size(const t_mesh *mesh, int lanes);
+void mesh_lanes_init(const t_mesh *mesh, t_mesh_lanes *state, int lanes, void *block);
+
+// one sample for all voices. input, yj, yj_r, loss and result hold stride
+// values each; padding lanes must have yj = yj_r = 1 and loss = 0
+typedef void (*t_mesh_lanes_fn)(const t_mesh *mesh, t_mesh_lanes *state, const float *input,
+                                const float *yj, const float *yj_r, const float *loss,
+                                float *result);
+
+// vector width of the lanes kernels picked by mesh_select_kernel()
+extern int mesh_lanes_width;
+
+// run n samples with temporal blocking: each sweep advances every tile
+// MESH_TILE_STEPS samples along a skewed wavefront, so a tile's delays are
+// touched once per sweep instead of once per sample. bit-identical to
+// calling mesh_cycle() n times
+void mesh_run_tiled(const t_mesh *mesh, t_mesh_state *state, const float *in, float *out,
+                    int n, float yj, float yj_r, float loss);
+
+typedef void (*t_mesh_run_fn)(const t_mesh *mesh, t_mesh_state *state, const float *in,
+                              float *out, int n, float yj, float yj_r, float loss);
+
+// whether mesh_run_tiled() is worth it for this mesh
+int mesh_use_tiled(const t_mesh *mesh);
+
+typedef float (*t_mesh_cycle_fn)(const t_mesh *mesh, t_mesh_state *state,
+                                 float input, float yj, float yj_r, float loss);
+
+enum {
+  MESH_KERNEL_SCALAR = 0,
+  MESH_KERNEL_SSE2,
+  MESH_KERNEL_AVX2,
+  MESH_KERNEL_AVX512,
+  MESH_KERNEL_N
+};
+
+// every kernel of one model, as picked by mesh_select_kernel()
+typedef struct {
+  t_mesh_cycle_fn cycle;
+  t_mesh_lanes_fn lanes;
+  t_mesh_run_fn tiled;
+} t_mesh_kernels;
+
+// pick the widest kernel this CPU supports, up to max_kernel. call once at
+// load time; returns the chosen MESH_KERNEL_* id
+int mesh_select_kernel(int max_kernel);
+// the selected kernels for a model, scalar until mesh_select_kernel().
+// unknown model ids fall back to MESH_MODEL_DEFAULT
+const t_mesh_kernels *mesh_kernels(int model);
+// a specific kernel, or NULL if it is not compiled in or the CPU lacks it
+t_mesh_cycle_fn mesh_kernel(int kernel, int model);
+const char *mesh_kernel_name(int kernel);
+// e.g. "self+rim+filter", for reports
+const char *mesh_model_name(int model);
+// the model id a UGen input selects, truncated like the other integer
+// inputs; -1 for anything outside 0..MESH_MODEL_N-1, NaN included
+int mesh_model_of(float input);
+
+#endif
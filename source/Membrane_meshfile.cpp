@@ -0,0 +1,689 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Membrane_meshfile.h"
+
+#define MESHFILE_MAGIC "SCMESH\r\n"
+#define ALIGN_FLOATS(n) (((n) + (MESH_ALIGN / sizeof(float)) - 1) & ~(MESH_ALIGN / sizeof(float) - 1))
+#define MESHFILE_BYTE_ORDER 0x01020304u
+
+// the compile-time constants the stored arrays depend on. a change to how
+// compile_mesh() or compile_stencil() fill them bumps MESHFILE_VERSION
+#define MESHFILE_LAYOUT ((uint32_t) MESH_SIMD_WIDTH | (MESH_MAX_PORTS << 8) \
+                         | (MESH_TILE_ROWS << 12) | (STENCIL_DIRS << 16) \
+                         | (MESH_ORDER_DEFAULT << 20) | ((sizeof(t_point) / 4) << 24) \
+                         | ((sizeof(t_line) / 4) << 28))
+
+// what is stored; offsets are bytes from the start of the file
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t layout;
+  uint32_t item_n;
+  uint64_t size;
+  uint64_t items;
+} t_file_header;
+
+typedef struct {
+  int32_t shape_type;
+  float angle;
+  int32_t frag;
+  uint32_t unused;
+  uint64_t shape;
+  uint64_t mesh;
+  uint64_t stencil; // 0 for none
+} t_file_item;
+
+typedef struct {
+  int32_t shape_type;
+  int32_t points_n;
+  int32_t lines_n;
+  int32_t edge_n;
+  uint64_t points;
+  uint64_t lines;
+} t_file_shape;
+
+typedef struct {
+  uint32_t points_n, lines_n, edge_n, port_n, line_d, rim_d, delay_n;
+  uint32_t points_pad, zero_d, dump_d, tile_n, strike_size;
+  uint64_t ports;   // port_off, line_end, junction_of, in, out
+  uint64_t ell[2];  // in, out, ports
+  uint64_t tiles;   // tile_off, tile_rim_off, tile_junctions, tile_rim
+  uint64_t strike;  // the t_mesh_strike as it is
+} t_file_mesh;
+
+typedef struct {
+  uint32_t points_n, rows, stride, plane, rim_off, rim_n, state_n;
+  int32_t offset[STENCIL_DIRS];
+  uint32_t run_n, interior_n, edge_n, port_n, strike_size;
+  uint64_t tables;  // run_start, run_end, edge_cell, line_end, port_off, in, out
+  uint64_t strike;  // the t_stencil_strike as it is
+} t_file_stencil;
+
+// array sizes in bytes, as the compile functions allocate them
+
+static uint64_t ports_bytes(uint32_t points_n, uint32_t port_n)
+{
+  return ((uint64_t) points_n * 3 + 1 + (uint64_t) port_n * 2) * sizeof(uint32_t);
+}
+
+static uint64_t ell_bytes(uint32_t points_pad)
+{
+  return ((uint64_t) points_pad * MESH_MAX_PORTS * 2 + points_pad) * sizeof(uint32_t);
+}
+
+static uint64_t tiles_bytes(uint32_t tile_n, uint32_t points_n)
+{
+  return (((uint64_t) tile_n + 1) * 2 + (uint64_t) points_n * 2) * sizeof(uint32_t);
+}
+
+static uint64_t stencil_bytes(uint32_t run_n, uint32_t edge_n, uint32_t port_n)
+{
+  return ((uint64_t) run_n * 2 + (uint64_t) edge_n * 3 + 1 + (uint64_t) port_n * 2)
+    * sizeof(uint32_t);
+}
+
+////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  FILE *file;
+  uint64_t pos;
+  int ok;
+} t_writer;
+
+static void write_bytes(t_writer *w, const void *data, uint64_t bytes)
+{
+  if (w->ok && bytes > 0 && fwrite(data, 1, bytes, w->file) != bytes) {
+    w->ok = 0;
+  }
+  w->pos += bytes;
+}
+
+// writes data at the next MESH_ALIGN boundary and returns its offset
+static uint64_t write_aligned(t_writer *w, const void *data, uint64_t bytes)
+{
+  static const char zeros[MESH_ALIGN] = {0};
+  uint64_t pad = (MESH_ALIGN - w->pos % MESH_ALIGN) % MESH_ALIGN;
+
+  write_bytes(w, zeros, pad);
+  uint64_t offset = w->pos;
+  write_bytes(w, data, bytes);
+  return offset;
+}
+
+static uint64_t write_shape(t_writer *w, const t_shape *shape)
+{
+  t_file_shape record;
+
+  memset(&record, 0, sizeof(record));
+  record.shape_type = shape->shape_type;
+  record.points_n = shape->points_n;
+  record.lines_n = shape->lines_n;
+  record.edge_n = shape->edge_n;
+  record.points = write_aligned(w, shape->points, (uint64_t) shape->points_n * sizeof(t_point));
+  record.lines = write_aligned(w, shape->lines, (uint64_t) shape->lines_n * sizeof(t_line));
+  return write_aligned(w, &record, sizeof(record));
+}
+
+static uint64_t write_mesh(t_writer *w, const t_mesh *mesh)
+{
+  t_file_mesh record;
+
+  memset(&record, 0, sizeof(record));
+  record.points_n = mesh->points_n;
+  record.lines_n = mesh->lines_n;
+  record.edge_n = mesh->edge_n;
+  record.port_n = mesh->port_n;
+  record.line_d = mesh->line_d;
+  record.rim_d = mesh->rim_d;
+  record.delay_n = mesh->delay_n;
+  record.points_pad = mesh->points_pad;
+  record.zero_d = mesh->zero_d;
+  record.dump_d = mesh->dump_d;
+  record.tile_n = mesh->tile_n;
+  record.ports = write_aligned(w, mesh->port_off, ports_bytes(mesh->points_n, mesh->port_n));
+  for (int rim = 0; rim < 2; ++rim) {
+    record.ell[rim] = write_aligned(w, mesh->ell[rim].in, ell_bytes(mesh->points_pad));
+  }
+  record.tiles = write_aligned(w, mesh->tile_off, tiles_bytes(mesh->tile_n, mesh->points_n));
+  record.strike_size = sizeof(t_mesh_strike);
+  record.strike = write_aligned(w, &mesh->strike, sizeof(t_mesh_strike));
+  return write_aligned(w, &record, sizeof(record));
+}
+
+static uint64_t write_stencil(t_writer *w, const t_stencil *stencil)
+{
+  t_file_stencil record;
+
+  memset(&record, 0, sizeof(record));
+  record.points_n = stencil->points_n;
+  record.rows = stencil->rows;
+  record.stride = stencil->stride;
+  record.plane = stencil->plane;
+  record.rim_off = stencil->rim_off;
+  record.rim_n = stencil->rim_n;
+  record.state_n = stencil->state_n;
+  memcpy(record.offset, stencil->offset, sizeof(record.offset));
+  record.run_n = stencil->run_n;
+  record.interior_n = stencil->interior_n;
+  record.edge_n = stencil->edge_n;
+  record.port_n = stencil->port_off[stencil->edge_n];
+  record.tables = write_aligned(w, stencil->run_start,
+                                stencil_bytes(record.run_n, record.edge_n, record.port_n));
+  record.strike_size = sizeof(t_stencil_strike);
+  record.strike = write_aligned(w, &stencil->strike, sizeof(t_stencil_strike));
+  return write_aligned(w, &record, sizeof(record));
+}
+
+int meshfile_write(const char *path, const t_meshfile_item *items, uint32_t n)
+{
+  t_writer w;
+  t_file_header header;
+  t_file_item *records = (t_file_item *) calloc(n + 1, sizeof(t_file_item));
+
+  w.file = fopen(path, "wb");
+  w.pos = 0;
+  w.ok = w.file != NULL && records != NULL;
+  if (!w.ok) {
+    printf("StoneChime: cannot write %s\n", path);
+    if (w.file) {
+      fclose(w.file);
+    }
+    free(records);
+    return 0;
+  }
+
+  // the header goes in last, once the offsets are known
+  memset(&header, 0, sizeof(header));
+  write_bytes(&w, &header, sizeof(header));
+
+  for (uint32_t i = 0; i < n; ++i) {
+    uint32_t same = 0;
+
+    records[i].shape_type = items[i].shape_type;
+    records[i].angle = items[i].angle;
+    records[i].frag = items[i].frag;
+
+    // keys sharing one cached mesh share its arrays
+    while (same < i && items[same].shape != items[i].shape) {
+      same++;
+    }
+    if (same < i) {
+      records[i].shape = records[same].shape;
+      records[i].mesh = records[same].mesh;
+      records[i].stencil = records[same].stencil;
+      continue;
+    }
+    records[i].shape = write_shape(&w, items[i].shape);
+    records[i].mesh = write_mesh(&w, items[i].mesh);
+    records[i].stencil = items[i].stencil ? write_stencil(&w, items[i].stencil) : 0;
+  }
+
+  memcpy(header.magic, MESHFILE_MAGIC, sizeof(header.magic));
+  header.version = MESHFILE_VERSION;
+  header.byte_order = MESHFILE_BYTE_ORDER;
+  header.layout = MESHFILE_LAYOUT;
+  header.item_n = n;
+  header.items = write_aligned(&w, records, (uint64_t) n * sizeof(t_file_item));
+  header.size = w.pos;
+  free(records);
+
+  if (w.ok && (fseek(w.file, 0, SEEK_SET) != 0
+               || fwrite(&header, sizeof(header), 1, w.file) != 1)) {
+    w.ok = 0;
+  }
+  if (fclose(w.file) != 0) {
+    w.ok = 0;
+  }
+  if (!w.ok) {
+    printf("StoneChime: cannot write %s\n", path);
+  }
+  return w.ok;
+}
+
+////////////////////////////////////////////////////////////////////
+
+struct t_meshfile {
+  const char *base;
+  size_t size;
+  uint32_t item_n;
+  t_meshfile_item *items;
+  t_shape *shapes;
+  t_mesh *meshes;
+  t_stencil *stencils;
+};
+
+// bytes of the file at offset, NULL if they are not all inside it or the
+// offset is misaligned
+static const void *meshfile_at(const t_meshfile *file, uint64_t offset, uint64_t bytes,
+                               uint64_t align)
+{
+  if (offset % align != 0 || offset > file->size || bytes > file->size - offset) {
+    return NULL;
+  }
+  return file->base + offset;
+}
+
+// the index checks below hold for anything compile_mesh() and
+// compile_stencil() build, and keep every kernel, pickup and strike inside
+// its arrays whatever else a damaged file holds
+
+// off[0] = 0, off[n] = total and at most step from one to the next
+static int offsets_valid(const uint32_t *off, uint32_t n, uint32_t total, uint32_t step)
+{
+  if (off[0] != 0 || off[n] != total) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < n; ++i) {
+    if (off[i + 1] < off[i] || off[i + 1] - off[i] > step) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int indices_below(const uint32_t *index, uint64_t n, uint32_t limit)
+{
+  for (uint64_t i = 0; i < n; ++i) {
+    if (index[i] >= limit) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// line ports end within a junction's ports, leaving at most a rim guide
+static int line_ends_valid(const uint32_t *port_off, const uint32_t *line_end, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; ++i) {
+    if (line_end[i] < port_off[i] || line_end[i] > port_off[i + 1]
+        || port_off[i + 1] - line_end[i] > 1) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int view_shape(const t_meshfile *file, uint64_t offset, t_shape *shape)
+{
+  const t_file_shape *record = (const t_file_shape *) meshfile_at(file, offset, sizeof(t_file_shape),
+                                                                  MESH_ALIGN);
+  if (!record || record->points_n <= 0 || record->lines_n < 0 || record->edge_n < 0
+      || record->edge_n > record->points_n) {
+    return 0;
+  }
+
+  shape->shape_type = record->shape_type;
+  shape->points_n = shape->points_max = record->points_n;
+  shape->lines_n = shape->lines_max = record->lines_n;
+  shape->edge_n = record->edge_n;
+  shape->points = (t_point *) meshfile_at(file, record->points,
+                                          (uint64_t) record->points_n * sizeof(t_point), MESH_ALIGN);
+  shape->lines = (t_line *) meshfile_at(file, record->lines,
+                                        (uint64_t) record->lines_n * sizeof(t_line), MESH_ALIGN);
+  if (!shape->points || !shape->lines) {
+    return 0;
+  }
+  for (int i = 0; i < shape->lines_n; ++i) {
+    const t_line *line = &shape->lines[i];
+    if (line->a < 0 || line->a >= shape->points_n || line->b < 0 || line->b >= shape->points_n) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int view_mesh(const t_meshfile *file, uint64_t offset, t_mesh *mesh)
+{
+  const t_file_mesh *record = (const t_file_mesh *) meshfile_at(file, offset, sizeof(t_file_mesh),
+                                                                MESH_ALIGN);
+  // the counts as compile_mesh() derives them from each other
+  if (!record || record->points_n == 0 || record->edge_n > record->points_n
+      || record->line_d != (uint64_t) record->lines_n * 2
+      || record->rim_d != (uint64_t) record->line_d + record->edge_n
+      || record->port_n != record->rim_d
+      || record->delay_n != (uint64_t) record->rim_d + record->points_n
+      || record->points_pad < record->points_n
+      || record->points_pad % MESH_SIMD_WIDTH != 0
+      || record->points_pad - record->points_n >= MESH_SIMD_WIDTH
+      || record->zero_d != (uint64_t) record->rim_d + record->points_pad
+      || record->dump_d != (uint64_t) record->zero_d + 1
+      || record->tile_n == 0 || record->tile_n > record->points_n) {
+    return 0;
+  }
+
+  mesh->points_n = record->points_n;
+  mesh->lines_n = record->lines_n;
+  mesh->edge_n = record->edge_n;
+  mesh->port_n = record->port_n;
+  mesh->line_d = record->line_d;
+  mesh->rim_d = record->rim_d;
+  mesh->delay_n = record->delay_n;
+  mesh->points_pad = record->points_pad;
+  mesh->zero_d = record->zero_d;
+  mesh->dump_d = record->dump_d;
+  mesh->tile_n = record->tile_n;
+
+  // the pointers compile_mesh() derives from each allocation
+  mesh->port_off = (uint32_t *) meshfile_at(file, record->ports,
+                                            ports_bytes(mesh->points_n, mesh->port_n), MESH_ALIGN);
+  if (!mesh->port_off
+      || !offsets_valid(mesh->port_off, mesh->points_n, mesh->port_n, MESH_MAX_PORTS)) {
+    return 0;
+  }
+  mesh->line_end = mesh->port_off + mesh->points_n + 1;
+  mesh->junction_of = mesh->line_end + mesh->points_n;
+  mesh->in = mesh->junction_of + mesh->points_n;
+  mesh->out = mesh->in + mesh->port_n;
+  if (!line_ends_valid(mesh->port_off, mesh->line_end, mesh->points_n)
+      || !indices_below(mesh->junction_of, mesh->points_n, mesh->points_n)
+      || mesh->junction_of[0] != 0
+      || !indices_below(mesh->in, mesh->port_n, mesh->rim_d)
+      || !indices_below(mesh->out, mesh->port_n, mesh->rim_d)) {
+    return 0;
+  }
+
+  size_t ell_n = (size_t) mesh->points_pad * MESH_MAX_PORTS;
+  for (int rim = 0; rim < 2; ++rim) {
+    t_mesh_ell *ell = &mesh->ell[rim];
+
+    ell->in = (uint32_t *) meshfile_at(file, record->ell[rim], ell_bytes(mesh->points_pad),
+                                       MESH_ALIGN);
+    if (!ell->in) {
+      return 0;
+    }
+    ell->out = ell->in + ell_n;
+    ell->ports = (float *) (ell->out + ell_n);
+
+    // unused slots read zero_d and write dump_d, nothing else past rim_d
+    for (size_t k = 0; k < ell_n; ++k) {
+      if ((ell->in[k] >= mesh->rim_d && ell->in[k] != mesh->zero_d)
+          || (ell->out[k] >= mesh->rim_d && ell->out[k] != mesh->dump_d)) {
+        return 0;
+      }
+    }
+    for (uint32_t i = 0; i < mesh->points_pad; ++i) {
+      if (!(ell->ports[i] >= 0.f && ell->ports[i] <= MESH_MAX_PORTS)) {
+        return 0;
+      }
+    }
+  }
+
+  mesh->tile_off = (uint32_t *) meshfile_at(file, record->tiles,
+                                            tiles_bytes(mesh->tile_n, mesh->points_n), MESH_ALIGN);
+  if (!mesh->tile_off) {
+    return 0;
+  }
+  mesh->tile_rim_off = mesh->tile_off + mesh->tile_n + 1;
+  mesh->tile_junctions = mesh->tile_rim_off + mesh->tile_n + 1;
+  mesh->tile_rim = mesh->tile_junctions + mesh->points_n;
+  if (!offsets_valid(mesh->tile_off, mesh->tile_n, mesh->points_n, mesh->points_n)
+      || !offsets_valid(mesh->tile_rim_off, mesh->tile_n, mesh->edge_n, mesh->edge_n)
+      || !indices_below(mesh->tile_junctions, mesh->points_n, mesh->points_n)) {
+    return 0;
+  }
+  for (uint32_t r = 0; r < mesh->edge_n; ++r) {
+    if (mesh->tile_rim[r] < mesh->line_d || mesh->tile_rim[r] >= mesh->rim_d) {
+      return 0;
+    }
+  }
+
+  // the kernels index with the strike unchecked
+  const t_mesh_strike *strike = (const t_mesh_strike *) meshfile_at(file, record->strike,
+                                                                     sizeof(t_mesh_strike),
+                                                                     MESH_ALIGN);
+  if (!strike || record->strike_size != sizeof(t_mesh_strike) || strike->n > MESH_STRIKE_MAX) {
+    return 0;
+  }
+  mesh->strike = *strike;
+  for (uint32_t s = 0; s < strike->n; ++s) {
+    if (strike->junction[s] >= mesh->points_n || strike->tile[s] >= mesh->tile_n) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int view_stencil(const t_meshfile *file, uint64_t offset, t_stencil *stencil)
+{
+  const t_file_stencil *record = (const t_file_stencil *) meshfile_at(file, offset,
+                                                                      sizeof(t_file_stencil),
+                                                                      MESH_ALIGN);
+  // the plane and state sizes as compile_stencil() derives them
+  uint64_t cells = record ? (uint64_t) record->rows * record->stride : 0;
+  if (!record || cells == 0 || cells > UINT32_MAX / (STENCIL_DIRS + 2)
+      || record->plane != ALIGN_FLOATS(cells)
+      || record->rim_off != (STENCIL_DIRS + 1) * record->plane
+      || record->rim_n > record->points_n
+      || record->state_n != ALIGN_FLOATS((uint64_t) record->rim_off + record->rim_n)
+      || record->edge_n == 0 || record->interior_n > record->points_n
+      || record->edge_n != record->points_n - record->interior_n
+      || record->run_n > record->interior_n) {
+    return 0;
+  }
+  for (int k = 0; k < STENCIL_DIRS; ++k) {
+    if (record->offset[k] > (int64_t) record->stride + 1
+        || record->offset[k] < -(int64_t) record->stride - 1) {
+      return 0;
+    }
+  }
+
+  stencil->points_n = record->points_n;
+  stencil->rows = record->rows;
+  stencil->stride = record->stride;
+  stencil->plane = record->plane;
+  stencil->rim_off = record->rim_off;
+  stencil->rim_n = record->rim_n;
+  stencil->state_n = record->state_n;
+  memcpy(stencil->offset, record->offset, sizeof(stencil->offset));
+  stencil->run_n = record->run_n;
+  stencil->interior_n = record->interior_n;
+  stencil->edge_n = record->edge_n;
+
+  // as compile_stencil() carves up its allocation
+  stencil->run_start = (uint32_t *) meshfile_at(file, record->tables,
+                                                stencil_bytes(record->run_n, record->edge_n,
+                                                              record->port_n), MESH_ALIGN);
+  const t_stencil_strike *strike = (const t_stencil_strike *) meshfile_at(file, record->strike,
+                                                                           sizeof(t_stencil_strike),
+                                                                           MESH_ALIGN);
+  if (!stencil->run_start || !strike || record->strike_size != sizeof(t_stencil_strike)
+      || strike->n > MESH_STRIKE_MAX) {
+    return 0;
+  }
+  stencil->run_end = stencil->run_start + stencil->run_n;
+  stencil->edge_cell = stencil->run_end + stencil->run_n;
+  stencil->line_end = stencil->edge_cell + stencil->edge_n;
+  stencil->port_off = stencil->line_end + stencil->edge_n;
+  stencil->in = stencil->port_off + stencil->edge_n + 1;
+  stencil->out = stencil->in + record->port_n;
+
+  // runs in cell order whose neighbours stay in the plane, then the
+  // irregular junctions' cells and ports
+  uint64_t interior = 0;
+  for (uint32_t r = 0; r < stencil->run_n; ++r) {
+    uint32_t start = stencil->run_start[r], end = stencil->run_end[r];
+    if (start >= end || end > cells || (r > 0 && start < stencil->run_end[r - 1])) {
+      return 0;
+    }
+    for (int k = 0; k < STENCIL_DIRS; ++k) {
+      if ((int64_t) start + stencil->offset[k] < 0
+          || (int64_t) end - 1 + stencil->offset[k] >= (int64_t) cells) {
+        return 0;
+      }
+    }
+    interior += end - start;
+  }
+  if (interior != stencil->interior_n
+      || !indices_below(stencil->edge_cell, stencil->edge_n, (uint32_t) cells)
+      || !offsets_valid(stencil->port_off, stencil->edge_n, record->port_n, MESH_MAX_PORTS)
+      || !line_ends_valid(stencil->port_off, stencil->line_end, stencil->edge_n)
+      || !indices_below(stencil->in, record->port_n, stencil->rim_off + stencil->rim_n)
+      || !indices_below(stencil->out, record->port_n, stencil->rim_off + stencil->rim_n)) {
+    return 0;
+  }
+
+  stencil->strike = *strike;
+  for (uint32_t s = 0; s < strike->n; ++s) {
+    if (strike->cell[s] >= stencil->plane || strike->edge[s] > stencil->edge_n) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void meshfile_unmap(const char *base, size_t size)
+{
+#ifdef _WIN32
+  free((void *) base);
+#else
+  munmap((void *) base, size);
+#endif
+}
+
+t_meshfile *meshfile_open(const char *path)
+{
+  const char *base;
+  size_t size;
+
+#ifdef _WIN32
+  // no mmap: read it whole, still no building
+  FILE *in = fopen(path, "rb");
+  if (!in) {
+    return NULL;
+  }
+  std::vector<char> bytes;
+  char chunk[65536];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+    bytes.insert(bytes.end(), chunk, chunk + got);
+  }
+  fclose(in);
+  size = bytes.size();
+  base = (const char *) malloc(size + 1);
+  if (!base) {
+    return NULL;
+  }
+  memcpy((void *) base, bytes.data(), size);
+#else
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+
+  if (fd < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(t_file_header)) {
+    printf("StoneChime: %s is not a mesh file\n", path);
+    close(fd);
+    return NULL;
+  }
+  size = (size_t) st.st_size;
+  void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    printf("StoneChime: cannot map %s\n", path);
+    return NULL;
+  }
+  base = (const char *) map;
+#endif
+
+  const t_file_header *header = (const t_file_header *) base;
+  if (size < sizeof(t_file_header) || memcmp(header->magic, MESHFILE_MAGIC, sizeof(header->magic))
+      || header->size != size) {
+    printf("StoneChime: %s is not a mesh file\n", path);
+    meshfile_unmap(base, size);
+    return NULL;
+  }
+  if (header->version != MESHFILE_VERSION || header->byte_order != MESHFILE_BYTE_ORDER
+      || header->layout != MESHFILE_LAYOUT) {
+    printf("StoneChime: %s was written by another build, building meshes instead\n", path);
+    meshfile_unmap(base, size);
+    return NULL;
+  }
+
+  t_meshfile *file = (t_meshfile *) calloc(1, sizeof(t_meshfile));
+  uint32_t n = header->item_n;
+  const t_file_item *records = NULL;
+  int ok = file != NULL;
+
+  if (ok) {
+    file->base = base;
+    file->size = size;
+    file->item_n = n;
+    records = (const t_file_item *) meshfile_at(file, header->items,
+                                                (uint64_t) n * sizeof(t_file_item), MESH_ALIGN);
+    file->items = (t_meshfile_item *) calloc(n + 1, sizeof(t_meshfile_item));
+    file->shapes = (t_shape *) calloc(n + 1, sizeof(t_shape));
+    file->meshes = (t_mesh *) calloc(n + 1, sizeof(t_mesh));
+    file->stencils = (t_stencil *) calloc(n + 1, sizeof(t_stencil));
+    ok = records && file->items && file->shapes && file->meshes && file->stencils;
+  }
+
+  for (uint32_t i = 0; ok && i < n; ++i) {
+    t_meshfile_item *item = &file->items[i];
+
+    item->shape_type = records[i].shape_type;
+    item->angle = records[i].angle;
+    item->frag = records[i].frag;
+    item->shape = &file->shapes[i];
+    item->mesh = &file->meshes[i];
+    item->stencil = records[i].stencil ? &file->stencils[i] : NULL;
+    ok = view_shape(file, records[i].shape, item->shape)
+      && view_mesh(file, records[i].mesh, item->mesh)
+      && (!item->stencil || view_stencil(file, records[i].stencil, item->stencil))
+      && item->mesh->points_n == (uint32_t) item->shape->points_n
+      && item->mesh->lines_n == (uint32_t) item->shape->lines_n
+      && item->mesh->edge_n == (uint32_t) item->shape->edge_n
+      && (!item->stencil || (item->stencil->points_n == item->mesh->points_n
+                             && item->stencil->rim_n == item->mesh->edge_n));
+  }
+
+  if (!ok) {
+    printf("StoneChime: %s is damaged\n", path);
+    if (file) {
+      meshfile_close(file);
+    }
+    else {
+      meshfile_unmap(base, size);
+    }
+    return NULL;
+  }
+  return file;
+}
+
+uint32_t meshfile_count(const t_meshfile *file)
+{
+  return file->item_n;
+}
+
+const t_meshfile_item *meshfile_item(const t_meshfile *file, uint32_t i)
+{
+  return &file->items[i];
+}
+
+size_t meshfile_size(const t_meshfile *file)
+{
+  return file->size;
+}
+
+void meshfile_close(t_meshfile *file)
+{
+  meshfile_unmap(file->base, file->size);
+  free(file->items);
+  free(file->shapes);
+  free(file->meshes);
+  free(file->stencils);
+  free(file);
+}
@@ -0,0 +1,56 @@
+#ifndef Membrane_meshfile_h
+#define Membrane_meshfile_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Membrane_shape.h"
+#include "Membrane_mesh.h"
+#include "Membrane_stencil.h"
+
+// A file of compiled meshes, read by mapping it into memory. Every array
+// is stored exactly as compile_mesh() and compile_stencil() lay it out,
+// MESH_ALIGN aligned, so loading a mesh is pointing a t_mesh at the mapping
+// instead of building it, and every server mapping the same file shares
+// one copy in the page cache.
+//
+//   header     magic, version, byte order, layout, item count, size and
+//              the offset of the item table
+//   arrays     the shapes' points and lines, the meshes' index blocks,
+//              the stencils' run tables and the default strikes of both
+//   records    per item the scalars of its shape, mesh and stencil with
+//              the offsets of their arrays
+//   items      key and record offsets, stencil 0 when it does not pay off;
+//              items with the same shape pointer share their records
+//
+// the layout word covers every compile-time constant the arrays depend on;
+// a file from a build with other constants, another version or another
+// byte order is refused and the meshes are built as usual.
+
+#define MESHFILE_VERSION 2
+#define MESHFILE_NAME "StoneChime.meshes" // next to the plug-in
+
+typedef struct {
+  int shape_type; // the canonical cache key
+  float angle;
+  int frag;
+  t_shape *shape;
+  t_mesh *mesh;
+  t_stencil *stencil; // NULL unless stencil_use()
+} t_meshfile_item;
+
+typedef struct t_meshfile t_meshfile;
+
+// NRT: 0 with a message on stdout if path cannot be written
+int meshfile_write(const char *path, const t_meshfile_item *items, uint32_t n);
+
+// NRT: NULL with a message on stdout if path cannot be mapped or is not a
+// mesh file of this build; a missing file is not reported
+t_meshfile *meshfile_open(const char *path);
+uint32_t meshfile_count(const t_meshfile *file);
+// item i, pointing into the mapping: valid until meshfile_close() and
+// never to be freed or written
+const t_meshfile_item *meshfile_item(const t_meshfile *file, uint32_t i);
+size_t meshfile_size(const t_meshfile *file);
+void meshfile_close(t_meshfile *file);
+
+#endif
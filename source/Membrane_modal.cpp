@@ -0,0 +1,830 @@
+// Modal decomposition of a compiled mesh.
+// The eigenvalue solver (orthes/hqr2) follows the public domain JAMA
+// EigenvalueDecomposition, itself derived from EISPACK.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+
+#include "Membrane_modal.h"
+
+#define MODAL_MAX_ITER 30 // QR iterations per eigenvalue, on average, before giving up
+
+#define MODAL_BLOCK 16 // independent partial sums in modal_run()
+#define MODAL_ALIGN 64
+
+#define M(a, i, j) (a)[(size_t) (i) * n + (j)]
+
+////////////////////////////////////////////////////////////////////
+
+// reduce H to upper Hessenberg form, accumulating the transformation in V
+
+static void orthes(double *H, double *V, int n)
+{
+  double *ort = (double *) calloc(n, sizeof(double));
+  int low = 0;
+  int high = n - 1;
+
+  for (int m = low + 1; m <= high - 1; ++m) {
+    double scale = 0.0;
+    for (int i = m; i <= high; ++i) {
+      scale += fabs(M(H, i, m - 1));
+    }
+    if (scale == 0.0) {
+      continue;
+    }
+
+    // Householder transformation
+    double h = 0.0;
+    for (int i = high; i >= m; --i) {
+      ort[i] = M(H, i, m - 1) / scale;
+      h += ort[i] * ort[i];
+    }
+    double g = sqrt(h);
+    if (ort[m] > 0) {
+      g = -g;
+    }
+    h = h - ort[m] * g;
+    ort[m] = ort[m] - g;
+
+    for (int j = m; j < n; ++j) {
+      double f = 0.0;
+      for (int i = high; i >= m; --i) {
+        f += ort[i] * M(H, i, j);
+      }
+      f = f / h;
+      for (int i = m; i <= high; ++i) {
+        M(H, i, j) -= f * ort[i];
+      }
+    }
+    for (int i = 0; i <= high; ++i) {
+      double f = 0.0;
+      for (int j = high; j >= m; --j) {
+        f += ort[j] * M(H, i, j);
+      }
+      f = f / h;
+      for (int j = m; j <= high; ++j) {
+        M(H, i, j) -= f * ort[j];
+      }
+    }
+    ort[m] = scale * ort[m];
+    M(H, m, m - 1) = scale * g;
+  }
+
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      M(V, i, j) = (i == j ? 1.0 : 0.0);
+    }
+  }
+
+  for (int m = high - 1; m >= low + 1; --m) {
+    if (M(H, m, m - 1) != 0.0) {
+      for (int i = m + 1; i <= high; ++i) {
+        ort[i] = M(H, i, m - 1);
+      }
+      for (int j = m; j <= high; ++j) {
+        double g = 0.0;
+        for (int i = m; i <= high; ++i) {
+          g += ort[i] * M(V, i, j);
+        }
+        // double division avoids possible underflow
+        g = (g / ort[m]) / M(H, m, m - 1);
+        for (int i = m; i <= high; ++i) {
+          M(V, i, j) += g * ort[i];
+        }
+      }
+    }
+  }
+
+  free(ort);
+}
+
+// complex division (xr + i xi) / (yr + i yi)
+static void cdiv(double xr, double xi, double yr, double yi, double *cr, double *ci)
+{
+  double r, d;
+  if (fabs(yr) > fabs(yi)) {
+    r = yi / yr;
+    d = yr + r * yi;
+    *cr = (xr + r * xi) / d;
+    *ci = (xi - r * xr) / d;
+  }
+  else {
+    r = yr / yi;
+    d = yi + r * yr;
+    *cr = (r * xr + xi) / d;
+    *ci = (r * xi - xr) / d;
+  }
+}
+
+// Hessenberg to real Schur form, then eigenvectors by back substitution.
+// on return A V = V D, where D is diagonal with 2x2 blocks
+// [d e; -e d] (e > 0) for complex pairs. returns 0 if it did not converge
+
+static int hqr2(double *H, double *V, double *d, double *e, int nn)
+{
+  int n = nn;
+  int low = 0;
+  int high = nn - 1;
+  double eps = pow(2.0, -52.0);
+  double exshift = 0.0;
+  double p = 0, q = 0, r = 0, s = 0, z = 0, t, w, x, y;
+  double cr, ci;
+
+  double norm = 0.0;
+  for (int i = 0; i < nn; ++i) {
+    for (int j = std::max(i - 1, 0); j < nn; ++j) {
+      norm += fabs(M(H, i, j));
+    }
+  }
+
+  // outer loop over eigenvalue index
+  int iter = 0;
+  int budget = MODAL_MAX_ITER * std::max(nn, 10);
+  int top = nn - 1;
+
+  while (top >= low) {
+
+    // look for a single small sub-diagonal element
+    int l = top;
+    while (l > low) {
+      s = fabs(M(H, l - 1, l - 1)) + fabs(M(H, l, l));
+      if (s == 0.0) {
+        s = norm;
+      }
+      if (fabs(M(H, l, l - 1)) < eps * s) {
+        break;
+      }
+      l--;
+    }
+
+    if (l == top) {
+      // one root found
+      M(H, top, top) = M(H, top, top) + exshift;
+      d[top] = M(H, top, top);
+      e[top] = 0.0;
+      top--;
+      iter = 0;
+    }
+    else if (l == top - 1) {
+      // two roots found
+      w = M(H, top, top - 1) * M(H, top - 1, top);
+      p = (M(H, top - 1, top - 1) - M(H, top, top)) / 2.0;
+      q = p * p + w;
+      z = sqrt(fabs(q));
+      M(H, top, top) = M(H, top, top) + exshift;
+      M(H, top - 1, top - 1) = M(H, top - 1, top - 1) + exshift;
+      x = M(H, top, top);
+
+      if (q >= 0) {
+        // real pair
+        z = (p >= 0) ? p + z : p - z;
+        d[top - 1] = x + z;
+        d[top] = d[top - 1];
+        if (z != 0.0) {
+          d[top] = x - w / z;
+        }
+        e[top - 1] = 0.0;
+        e[top] = 0.0;
+        x = M(H, top, top - 1);
+        s = fabs(x) + fabs(z);
+        p = x / s;
+        q = z / s;
+        r = sqrt(p * p + q * q);
+        p = p / r;
+        q = q / r;
+
+        for (int j = top - 1; j < nn; ++j) {
+          z = M(H, top - 1, j);
+          M(H, top - 1, j) = q * z + p * M(H, top, j);
+          M(H, top, j) = q * M(H, top, j) - p * z;
+        }
+        for (int i = 0; i <= top; ++i) {
+          z = M(H, i, top - 1);
+          M(H, i, top - 1) = q * z + p * M(H, i, top);
+          M(H, i, top) = q * M(H, i, top) - p * z;
+        }
+        for (int i = low; i <= high; ++i) {
+          z = M(V, i, top - 1);
+          M(V, i, top - 1) = q * z + p * M(V, i, top);
+          M(V, i, top) = q * M(V, i, top) - p * z;
+        }
+      }
+      else {
+        // complex pair
+        d[top - 1] = x + p;
+        d[top] = x + p;
+        e[top - 1] = z;
+        e[top] = -z;
+      }
+      top = top - 2;
+      iter = 0;
+    }
+    else {
+      // no convergence yet, form shift
+      x = M(H, top, top);
+      y = 0.0;
+      w = 0.0;
+      if (l < top) {
+        y = M(H, top - 1, top - 1);
+        w = M(H, top, top - 1) * M(H, top - 1, top);
+      }
+
+      // Wilkinson's original ad hoc shift
+      if (iter == 10) {
+        exshift += x;
+        for (int i = low; i <= top; ++i) {
+          M(H, i, i) -= x;
+        }
+        s = fabs(M(H, top, top - 1)) + fabs(M(H, top - 1, top - 2));
+        x = y = 0.75 * s;
+        w = -0.4375 * s * s;
+      }
+
+      // MATLAB's ad hoc shift
+      if (iter == 30) {
+        s = (y - x) / 2.0;
+        s = s * s + w;
+        if (s > 0) {
+          s = sqrt(s);
+          if (y < x) {
+            s = -s;
+          }
+          s = x - w / ((y - x) / 2.0 + s);
+          for (int i = low; i <= top; ++i) {
+            M(H, i, i) -= s;
+          }
+          exshift += s;
+          x = y = w = 0.964;
+        }
+      }
+
+      iter++;
+      if (--budget < 0) {
+        return 0;
+      }
+
+      // look for two consecutive small sub-diagonal elements
+      int m = top - 2;
+      while (m >= l) {
+        z = M(H, m, m);
+        r = x - z;
+        s = y - z;
+        p = (r * s - w) / M(H, m + 1, m) + M(H, m, m + 1);
+        q = M(H, m + 1, m + 1) - z - r - s;
+        r = M(H, m + 2, m + 1);
+        s = fabs(p) + fabs(q) + fabs(r);
+        p = p / s;
+        q = q / s;
+        r = r / s;
+        if (m == l) {
+          break;
+        }
+        if (fabs(M(H, m, m - 1)) * (fabs(q) + fabs(r)) <
+            eps * (fabs(p) * (fabs(M(H, m - 1, m - 1)) + fabs(z) + fabs(M(H, m + 1, m + 1))))) {
+          break;
+        }
+        m--;
+      }
+
+      for (int i = m + 2; i <= top; ++i) {
+        M(H, i, i - 2) = 0.0;
+        if (i > m + 2) {
+          M(H, i, i - 3) = 0.0;
+        }
+      }
+
+      // double QR step involving rows l:top and columns m:top
+      for (int k = m; k <= top - 1; ++k) {
+        int notlast = (k != top - 1);
+        if (k != m) {
+          p = M(H, k, k - 1);
+          q = M(H, k + 1, k - 1);
+          r = notlast ? M(H, k + 2, k - 1) : 0.0;
+          x = fabs(p) + fabs(q) + fabs(r);
+          if (x == 0.0) {
+            continue;
+          }
+          p = p / x;
+          q = q / x;
+          r = r / x;
+        }
+
+        s = sqrt(p * p + q * q + r * r);
+        if (p < 0) {
+          s = -s;
+        }
+        if (s != 0) {
+          if (k != m) {
+            M(H, k, k - 1) = -s * x;
+          }
+          else if (l != m) {
+            M(H, k, k - 1) = -M(H, k, k - 1);
+          }
+          p = p + s;
+          x = p / s;
+          y = q / s;
+          z = r / s;
+          q = q / p;
+          r = r / p;
+
+          // row modification
+          for (int j = k; j < nn; ++j) {
+            p = M(H, k, j) + q * M(H, k + 1, j);
+            if (notlast) {
+              p = p + r * M(H, k + 2, j);
+              M(H, k + 2, j) = M(H, k + 2, j) - p * z;
+            }
+            M(H, k, j) = M(H, k, j) - p * x;
+            M(H, k + 1, j) = M(H, k + 1, j) - p * y;
+          }
+
+          // column modification
+          for (int i = 0; i <= std::min(top, k + 3); ++i) {
+            p = x * M(H, i, k) + y * M(H, i, k + 1);
+            if (notlast) {
+              p = p + z * M(H, i, k + 2);
+              M(H, i, k + 2) = M(H, i, k + 2) - p * r;
+            }
+            M(H, i, k) = M(H, i, k) - p;
+            M(H, i, k + 1) = M(H, i, k + 1) - p * q;
+          }
+
+          // accumulate transformations
+          for (int i = low; i <= high; ++i) {
+            p = x * M(V, i, k) + y * M(V, i, k + 1);
+            if (notlast) {
+              p = p + z * M(V, i, k + 2);
+              M(V, i, k + 2) = M(V, i, k + 2) - p * r;
+            }
+            M(V, i, k) = M(V, i, k) - p;
+            M(V, i, k + 1) = M(V, i, k + 1) - p * q;
+          }
+        }
+      }
+    }
+  }
+
+  // backsubstitute to find vectors of upper triangular form
+  if (norm == 0.0) {
+    return 1;
+  }
+
+  for (int c = nn - 1; c >= 0; --c) {
+    p = d[c];
+    q = e[c];
+
+    if (q == 0) {
+      // real vector
+      int l = c;
+      M(H, c, c) = 1.0;
+      for (int i = c - 1; i >= 0; --i) {
+        w = M(H, i, i) - p;
+        r = 0.0;
+        for (int j = l; j <= c; ++j) {
+          r = r + M(H, i, j) * M(H, j, c);
+        }
+        if (e[i] < 0.0) {
+          z = w;
+          s = r;
+        }
+        else {
+          l = i;
+          if (e[i] == 0.0) {
+            M(H, i, c) = (w != 0.0) ? -r / w : -r / (eps * norm);
+          }
+          else {
+            // solve real equations
+            x = M(H, i, i + 1);
+            y = M(H, i + 1, i);
+            q = (d[i] - p) * (d[i] - p) + e[i] * e[i];
+            t = (x * s - z * r) / q;
+            M(H, i, c) = t;
+            if (fabs(x) > fabs(z)) {
+              M(H, i + 1, c) = (-r - w * t) / x;
+            }
+            else {
+              M(H, i + 1, c) = (-s - y * t) / z;
+            }
+          }
+
+          // overflow control
+          t = fabs(M(H, i, c));
+          if ((eps * t) * t > 1) {
+            for (int j = i; j <= c; ++j) {
+              M(H, j, c) = M(H, j, c) / t;
+            }
+          }
+        }
+      }
+    }
+    else if (q < 0) {
+      // complex vector, last component imaginary so the matrix is triangular
+      int l = c - 1;
+
+      if (fabs(M(H, c, c - 1)) > fabs(M(H, c - 1, c))) {
+        M(H, c - 1, c - 1) = q / M(H, c, c - 1);
+        M(H, c - 1, c) = -(M(H, c, c) - p) / M(H, c, c - 1);
+      }
+      else {
+        cdiv(0.0, -M(H, c - 1, c), M(H, c - 1, c - 1) - p, q, &cr, &ci);
+        M(H, c - 1, c - 1) = cr;
+        M(H, c - 1, c) = ci;
+      }
+      M(H, c, c - 1) = 0.0;
+      M(H, c, c) = 1.0;
+
+      for (int i = c - 2; i >= 0; --i) {
+        double ra = 0.0, sa = 0.0, vr, vi;
+        for (int j = l; j <= c; ++j) {
+          ra = ra + M(H, i, j) * M(H, j, c - 1);
+          sa = sa + M(H, i, j) * M(H, j, c);
+        }
+        w = M(H, i, i) - p;
+
+        if (e[i] < 0.0) {
+          z = w;
+          r = ra;
+          s = sa;
+        }
+        else {
+          l = i;
+          if (e[i] == 0) {
+            cdiv(-ra, -sa, w, q, &cr, &ci);
+            M(H, i, c - 1) = cr;
+            M(H, i, c) = ci;
+          }
+          else {
+            // solve complex equations
+            x = M(H, i, i + 1);
+            y = M(H, i + 1, i);
+            vr = (d[i] - p) * (d[i] - p) + e[i] * e[i] - q * q;
+            vi = (d[i] - p) * 2.0 * q;
+            if (vr == 0.0 && vi == 0.0) {
+              vr = eps * norm * (fabs(w) + fabs(q) + fabs(x) + fabs(y) + fabs(z));
+            }
+            cdiv(x * r - z * ra + q * sa, x * s - z * sa - q * ra, vr, vi, &cr, &ci);
+            M(H, i, c - 1) = cr;
+            M(H, i, c) = ci;
+            if (fabs(x) > (fabs(z) + fabs(q))) {
+              M(H, i + 1, c - 1) = (-ra - w * M(H, i, c - 1) + q * M(H, i, c)) / x;
+              M(H, i + 1, c) = (-sa - w * M(H, i, c) - q * M(H, i, c - 1)) / x;
+            }
+            else {
+              cdiv(-r - y * M(H, i, c - 1), -s - y * M(H, i, c), z, q, &cr, &ci);
+              M(H, i + 1, c - 1) = cr;
+              M(H, i + 1, c) = ci;
+            }
+          }
+
+          // overflow control
+          t = std::max(fabs(M(H, i, c - 1)), fabs(M(H, i, c)));
+          if ((eps * t) * t > 1) {
+            for (int j = i; j <= c; ++j) {
+              M(H, j, c - 1) = M(H, j, c - 1) / t;
+              M(H, j, c) = M(H, j, c) / t;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // back transformation to get eigenvectors of the original matrix
+  double *row = (double *) malloc(nn * sizeof(double));
+  for (int i = low; i <= high; ++i) {
+    for (int j = nn - 1; j >= low; --j) {
+      z = 0.0;
+      for (int k = low; k <= std::min(j, high); ++k) {
+        z = z + M(V, i, k) * M(H, k, j);
+      }
+      row[j] = z;
+    }
+    memcpy(&M(V, i, 0), row, nn * sizeof(double));
+  }
+  free(row);
+
+  return 1;
+}
+
+// solve A x = b in place by LU with partial pivoting; A is destroyed
+static void lu_solve(double *A, double *b, int n)
+{
+  for (int k = 0; k < n; ++k) {
+    int piv = k;
+    for (int i = k + 1; i < n; ++i) {
+      if (fabs(M(A, i, k)) > fabs(M(A, piv, k))) {
+        piv = i;
+      }
+    }
+    if (piv != k) {
+      for (int j = 0; j < n; ++j) {
+        std::swap(M(A, k, j), M(A, piv, j));
+      }
+      std::swap(b[k], b[piv]);
+    }
+    if (M(A, k, k) == 0.0) {
+      continue;
+    }
+    for (int i = k + 1; i < n; ++i) {
+      double f = M(A, i, k) / M(A, k, k);
+      if (f == 0.0) {
+        continue;
+      }
+      for (int j = k; j < n; ++j) {
+        M(A, i, j) -= f * M(A, k, j);
+      }
+      b[i] -= f * b[k];
+    }
+  }
+  for (int i = n - 1; i >= 0; --i) {
+    double s = b[i];
+    for (int j = i + 1; j < n; ++j) {
+      s -= M(A, i, j) * b[j];
+    }
+    b[i] = M(A, i, i) != 0.0 ? s / M(A, i, i) : 0.0;
+  }
+}
+
+#undef M
+
+////////////////////////////////////////////////////////////////////
+
+// copy the state vector [b, c] of a running mesh in or out
+static void state_get(const t_mesh *mesh, const t_mesh_state *state, double *x)
+{
+  uint32_t rim_n = mesh->rim_d - mesh->line_d;
+  for (uint32_t i = 0; i < mesh->delay_n; ++i) {
+    x[i] = state->b[i];
+  }
+  for (uint32_t i = 0; i < rim_n; ++i) {
+    x[mesh->delay_n + i] = state->c[i];
+  }
+}
+
+t_modal *compute_modal(const t_mesh *mesh, int model, float yj, float loss)
+{
+  t_mesh_cycle_fn cycle = mesh_kernel(MESH_KERNEL_SCALAR, model);
+  int n = (int) (mesh->delay_n + (mesh->rim_d - mesh->line_d));
+  float yj_r = 1.0f / yj;
+
+  double *A = (double *) calloc((size_t) n * n, sizeof(double));
+  double *V = (double *) calloc((size_t) n * n, sizeof(double));
+  double *B = (double *) calloc(n, sizeof(double));
+  double *C = (double *) calloc(n, sizeof(double));
+  double *d = (double *) calloc(n, sizeof(double));
+  double *e = (double *) calloc(n, sizeof(double));
+  double *x = (double *) calloc(n, sizeof(double));
+  void *block = malloc(mesh_state_size(mesh));
+  t_mesh_state state;
+  float direct;
+  t_modal *modal = NULL;
+
+  // probe the scalar kernel for the state space form x' = A x + B u,
+  // y = C x + D u, column by column
+  for (int j = 0; j < n; ++j) {
+    mesh_state_init(mesh, &state, block);
+    if (j < (int) mesh->delay_n) {
+      state.b[j] = 1.0f;
+    }
+    else {
+      state.c[j - mesh->delay_n] = 1.0f;
+    }
+    C[j] = cycle(mesh, &state, 0.f, yj, yj_r, loss);
+    state_get(mesh, &state, x);
+    for (int i = 0; i < n; ++i) {
+      A[(size_t) i * n + j] = x[i];
+    }
+  }
+  mesh_state_init(mesh, &state, block);
+  direct = cycle(mesh, &state, 1.f, yj, yj_r, loss);
+  state_get(mesh, &state, B);
+  free(block);
+
+  orthes(A, V, n);
+  if (!hqr2(A, V, d, e, n)) {
+    goto done;
+  }
+
+  // excitation and pickup gains in modal coordinates: q = V^-1 B, c = C V
+  for (int j = 0; j < n; ++j) {
+    double s = 0;
+    for (int i = 0; i < n; ++i) {
+      s += C[i] * V[(size_t) i * n + j];
+    }
+    x[j] = s;
+  }
+  lu_solve(V, B, n);
+
+  modal = (t_modal *) calloc(1, sizeof(t_modal));
+  modal->yj_ref = yj;
+  modal->loss_ref = loss;
+  modal->direct = direct;
+
+  {
+    // one mode per real pole or complex pair
+    float *buf = (float *) calloc((size_t) n * 6, sizeof(float));
+    int *order = (int *) malloc(n * sizeof(int));
+    int m = 0;
+
+    float *radius = buf, *theta = buf + n, *q1 = buf + 2 * n, *q2 = buf + 3 * n;
+    float *c1 = buf + 4 * n, *c2 = buf + 5 * n;
+
+    for (int k = 0; k < n; ++k) {
+      if (e[k] == 0.0) {
+        radius[m] = (float) fabs(d[k]);
+        theta[m] = d[k] < 0 ? (float) M_PI : 0.f;
+        // a negative real pole is a rotation by pi of the same radius
+        q1[m] = (float) B[k];
+        c1[m] = (float) x[k];
+        q2[m] = c2[m] = 0.f;
+        m++;
+      }
+      else if (e[k] > 0.0) {
+        radius[m] = (float) sqrt(d[k] * d[k] + e[k] * e[k]);
+        theta[m] = (float) atan2(e[k], d[k]);
+        q1[m] = (float) B[k];
+        q2[m] = (float) B[k + 1];
+        c1[m] = (float) x[k];
+        c2[m] = (float) x[k + 1];
+        m++;
+      }
+    }
+
+    // rank by peak contribution |c| |q| / (1 - r)
+    float *weight = (float *) malloc(m * sizeof(float));
+    for (int k = 0; k < m; ++k) {
+      float gain = sqrtf(c1[k] * c1[k] + c2[k] * c2[k]) * sqrtf(q1[k] * q1[k] + q2[k] * q2[k]);
+      weight[k] = gain / std::max(1.f - radius[k], 1e-9f);
+      order[k] = k;
+    }
+    std::sort(order, order + m, [weight](int a, int b) { return weight[a] > weight[b]; });
+
+    float *out = (float *) calloc((size_t) m * 7, sizeof(float));
+    modal->modes_n = m;
+    modal->radius = out;
+    modal->theta = out + m;
+    modal->q1 = out + 2 * m;
+    modal->q2 = out + 3 * m;
+    modal->c1 = out + 4 * m;
+    modal->c2 = out + 5 * m;
+    modal->weight = out + 6 * m;
+
+    for (int k = 0; k < m; ++k) {
+      int o = order[k];
+      modal->radius[k] = radius[o];
+      modal->theta[k] = theta[o];
+      modal->q1[k] = q1[o];
+      modal->q2[k] = q2[o];
+      modal->c1[k] = c1[o];
+      modal->c2[k] = c2[o];
+      modal->weight[k] = weight[o];
+    }
+
+    free(weight);
+    free(order);
+    free(buf);
+  }
+
+done:
+  free(A);
+  free(V);
+  free(B);
+  free(C);
+  free(d);
+  free(e);
+  free(x);
+  return modal;
+}
+
+void free_modal(t_modal *modal)
+{
+  free(modal->radius);
+  free(modal);
+}
+
+////////////////////////////////////////////////////////////////////
+
+int modal_select(const t_modal *modal, int max_modes, float threshold)
+{
+  int n = modal->modes_n;
+
+  if (max_modes > 0 && max_modes < n) {
+    n = max_modes;
+  }
+  if (threshold > 0 && modal->modes_n > 0) {
+    float floor = modal->weight[0] * threshold;
+    int k = 0;
+    while (k < n && modal->weight[k] >= floor) {
+      k++;
+    }
+    n = k;
+  }
+  return n;
+}
+
+// modes are padded with silent ones to a multiple of MODAL_BLOCK so
+// modal_run() can keep MODAL_BLOCK independent partial sums
+static int modal_pad(int modes_n)
+{
+  return (modes_n + MODAL_BLOCK - 1) / MODAL_BLOCK * MODAL_BLOCK;
+}
+
+size_t modal_state_size(int modes_n)
+{
+  return (size_t) modal_pad(modes_n) * 8 * sizeof(float) + MODAL_ALIGN;
+}
+
+void modal_state_init(const t_modal *modal, t_modal_state *state, int modes_n, void *block)
+{
+  int pad = modal_pad(modes_n);
+  float *f = (float *) (((uintptr_t) block + MODAL_ALIGN - 1) & ~(uintptr_t) (MODAL_ALIGN - 1));
+
+  memset(block, 0, modal_state_size(modes_n));
+
+  state->modes_n = modes_n;
+  state->modes_pad = pad;
+  state->direct = modal->direct;
+  state->cs = f;
+  state->sn = f + pad;
+  state->q1 = f + 2 * pad;
+  state->q2 = f + 3 * pad;
+  state->c1 = f + 4 * pad;
+  state->c2 = f + 5 * pad;
+  state->z1 = f + 6 * pad;
+  state->z2 = f + 7 * pad;
+
+  memcpy(state->q1, modal->q1, modes_n * sizeof(float));
+  memcpy(state->q2, modal->q2, modes_n * sizeof(float));
+
+  modal_retune(modal, state, modal->yj_ref, modal->loss_ref);
+}
+
+void modal_retune(const t_modal *modal, t_modal_state *state, float yj, float loss)
+{
+  float scale = sqrtf(modal->yj_ref / yj);
+  float decay = sqrtf(loss / modal->loss_ref);
+  int exact = (yj == modal->yj_ref && loss == modal->loss_ref);
+
+  // the direct path goes through one junction, so it scales with loss itself
+  state->direct = modal->direct * (loss / modal->loss_ref);
+
+  for (int k = 0; k < state->modes_n; ++k) {
+    double r = modal->radius[k];
+    double theta = modal->theta[k];
+    int audible = 1;
+
+    if (!exact) {
+      r = std::min(r * decay, 0.999999);
+      // real poles stay where they are
+      if (theta > 0 && theta < M_PI) {
+        theta *= scale;
+        audible = theta < M_PI;
+      }
+    }
+
+    state->cs[k] = (float) (r * cos(theta));
+    state->sn[k] = (float) (r * sin(theta));
+    state->c1[k] = audible ? modal->c1[k] : 0.f;
+    state->c2[k] = audible ? modal->c2[k] : 0.f;
+  }
+}
+
+// one sample of the resonator bank, returns the sum of the outputs
+static inline float modal_step(int pad, float u, const float *__restrict cs,
+                               const float *__restrict sn, const float *__restrict q1,
+                               const float *__restrict q2, const float *__restrict c1,
+                               const float *__restrict c2, float *__restrict z1,
+                               float *__restrict z2)
+{
+  float acc[MODAL_BLOCK];
+  float y = 0.f;
+
+  for (int j = 0; j < MODAL_BLOCK; ++j) {
+    acc[j] = 0.f;
+  }
+  for (int m = 0; m < pad; m += MODAL_BLOCK) {
+    for (int j = 0; j < MODAL_BLOCK; ++j) {
+      float a = z1[m + j], b = z2[m + j];
+      acc[j] += c1[m + j] * a + c2[m + j] * b;
+      z1[m + j] = cs[m + j] * a + sn[m + j] * b + q1[m + j] * u;
+      z2[m + j] = cs[m + j] * b - sn[m + j] * a + q2[m + j] * u;
+    }
+  }
+  for (int j = 0; j < MODAL_BLOCK; ++j) {
+    y += acc[j];
+  }
+  return y;
+}
+
+void modal_run(t_modal_state *state, const float *in, float *out, int n)
+{
+  for (int k = 0; k < n; ++k) {
+    float u = in[k];
+    out[k] = state->direct * u
+      + modal_step(state->modes_pad, u, state->cs, state->sn, state->q1, state->q2,
+                   state->c1, state->c2, state->z1, state->z2);
+  }
+}
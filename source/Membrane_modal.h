@@ -0,0 +1,68 @@
+
+#ifndef Membrane_modal_h
+#define Membrane_modal_h
+
+#include <stddef.h>
+#include "Membrane_mesh.h"
+
+// Modal form of a compiled mesh. For fixed tension and loss the mesh is a
+// linear time-invariant system from the excitation to the junction-0
+// output, so it can be diagonalised once into real 2x2 rotation blocks and
+// played as a bank of second-order resonators:
+//
+//   z1' = r cos(theta) z1 + r sin(theta) z2 + q1 u
+//   z2' = r cos(theta) z2 - r sin(theta) z1 + q2 u
+//   y   = sum(c1 z1 + c2 z2) + direct u
+//
+// real poles have theta 0 or pi and q2 = c2 = 0. modes are sorted by
+// weight, an estimate of their peak contribution to the output.
+typedef struct {
+  int modes_n;
+  float yj_ref;   // admittance and loss the modes were computed for
+  float loss_ref;
+  float direct;   // same-sample feedthrough of the excitation
+  float *radius;
+  float *theta;
+  float *q1;
+  float *q2;
+  float *c1;
+  float *c2;
+  float *weight;
+} t_modal;
+
+// NRT: decompose the mesh model (MESH_MODEL_*) at admittance yj and loss.
+// O(N^3) in the number of delays, so this belongs on the NRT thread or in a
+// cache. NULL if the eigenvalue iteration does not converge
+t_modal *compute_modal(const t_mesh *mesh, int model, float yj, float loss);
+void free_modal(t_modal *modal);
+
+// the first modes of modal, by weight, retuned to the running parameters
+typedef struct {
+  int modes_n;
+  int modes_pad;
+  float direct;
+  float *cs;   // r cos(theta)
+  float *sn;   // r sin(theta)
+  float *q1;
+  float *q2;
+  float *c1;
+  float *c2;
+  float *z1;
+  float *z2;
+} t_modal_state;
+
+// how many modes to run: at most max_modes (0 for all) and only those
+// whose weight is at least threshold times the strongest one
+int modal_select(const t_modal *modal, int max_modes, float threshold);
+
+size_t modal_state_size(int modes_n);
+void modal_state_init(const t_modal *modal, t_modal_state *state, int modes_n, void *block);
+
+// cheap retuning for a new admittance/loss. the low modes of the mesh scale
+// with 1/sqrt(yj) in frequency (i.e. linearly with tension), and the pole
+// radii with sqrt(loss); modes pushed past Nyquist are muted
+void modal_retune(const t_modal *modal, t_modal_state *state, float yj, float loss);
+
+void modal_run(t_modal_state *state, const float *in, float *out, int n);
+
+#endif
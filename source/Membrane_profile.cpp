@@ -0,0 +1,238 @@
+
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "Membrane_profile.h"
+
+static t_profile units[PROFILE_UNITS];
+static t_profile_shape shapes[PROFILE_SHAPES];
+static std::atomic<uint32_t> nextUnit;
+static std::atomic<uint64_t> unprofiled; // claims that found the table full
+
+static void profile_max(std::atomic<uint64_t> &max, uint64_t value)
+{
+  uint64_t old = max.load(std::memory_order_relaxed);
+  while (value > old && !max.compare_exchange_weak(old, value, std::memory_order_relaxed)) {
+  }
+}
+
+t_profile *profile_claim(int shape_type, float angle, int fragNums, int node)
+{
+  uint32_t first = nextUnit.fetch_add(1, std::memory_order_relaxed);
+
+  for (uint32_t i = 0; i < PROFILE_UNITS; ++i) {
+    t_profile *profile = &units[(first + i) % PROFILE_UNITS];
+    int expected = 0;
+
+    if (profile->used.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+      profile->shape_type = shape_type;
+      profile->angle = angle;
+      profile->fragNums = fragNums;
+      profile->node = node;
+      profile->ctor.store(0, std::memory_order_relaxed);
+      profile->ready.store(0, std::memory_order_relaxed);
+      profile->start.store(profile_ticks(), std::memory_order_relaxed);
+      profile->points_n.store(0, std::memory_order_relaxed);
+      profile->delay_n.store(0, std::memory_order_relaxed);
+      profile->engine.store(NULL, std::memory_order_relaxed);
+      profile->blocks.store(0, std::memory_order_relaxed);
+      profile->sleep_blocks.store(0, std::memory_order_relaxed);
+      profile->ticks.store(0, std::memory_order_relaxed);
+      profile->max_ticks.store(0, std::memory_order_relaxed);
+      profile->sleeping.store(0, std::memory_order_relaxed);
+      profile->used.store(2, std::memory_order_release);
+      return profile;
+    }
+  }
+  unprofiled.fetch_add(1, std::memory_order_relaxed);
+  return NULL;
+}
+
+void profile_constructed(t_profile *profile, uint64_t start)
+{
+  if (profile) {
+    profile->ctor.store(profile_ticks() - start, std::memory_order_relaxed);
+  }
+}
+
+void profile_attach(t_profile *profile, uint32_t points_n, uint32_t delay_n, const char *engine)
+{
+  if (profile) {
+    profile->points_n.store(points_n, std::memory_order_relaxed);
+    profile->delay_n.store(delay_n, std::memory_order_relaxed);
+    profile->engine.store(engine, std::memory_order_relaxed);
+    profile->ready.store(profile_ticks() - profile->start.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+  }
+}
+
+// the totals of a shape, keyed on first use. NULL when the table is full
+static t_profile_shape *profile_shape(int shape_type, float angle, int fragNums)
+{
+  for (int i = 0; i < PROFILE_SHAPES; ++i) {
+    t_profile_shape *shape = &shapes[i];
+    int used = shape->used.load(std::memory_order_acquire);
+
+    if (used == 0 && shape->used.compare_exchange_strong(used, 1, std::memory_order_acquire)) {
+      shape->shape_type = shape_type;
+      shape->angle = angle;
+      shape->fragNums = fragNums;
+      shape->used.store(2, std::memory_order_release);
+      return shape;
+    }
+    // a slot keyed concurrently is passed over; the dump merges equal keys
+    if (used == 2 && shape->shape_type == shape_type && shape->angle == angle
+        && shape->fragNums == fragNums) {
+      return shape;
+    }
+  }
+  return NULL;
+}
+
+void profile_release(t_profile *profile)
+{
+  if (!profile) {
+    return;
+  }
+
+  t_profile_shape *shape = profile_shape(profile->shape_type, profile->angle, profile->fragNums);
+  if (shape) {
+    shape->instances.fetch_add(1, std::memory_order_relaxed);
+    shape->ctor.fetch_add(profile->ctor.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    shape->blocks.fetch_add(profile->blocks.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+    shape->sleep_blocks.fetch_add(profile->sleep_blocks.load(std::memory_order_relaxed),
+                                  std::memory_order_relaxed);
+    shape->ticks.fetch_add(profile->ticks.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    profile_max(shape->max_ticks, profile->max_ticks.load(std::memory_order_relaxed));
+  }
+  profile->used.store(0, std::memory_order_release);
+}
+
+////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  uint64_t instances, live, sleeping, ctor, blocks, sleep_blocks, ticks, max_ticks;
+} t_profile_total;
+
+static std::string profile_label(t_profile_name_fn name, int shape_type, float angle,
+                                 int fragNums)
+{
+  char label[64];
+
+  if (!name || !name(shape_type, angle, fragNums, label, sizeof(label))) {
+    snprintf(label, sizeof(label), "shape %d/%g/%d", shape_type, angle, fragNums);
+  }
+  return label;
+}
+
+static double profile_avg(uint64_t sum, uint64_t n)
+{
+  return n ? (double) sum / n : 0.0;
+}
+
+void profile_dump(FILE *out, t_profile_name_fn name)
+{
+  typedef std::tuple<int, float, int> t_key;
+  typedef std::map<t_key, t_profile_total> t_totals;
+  t_totals totals;
+  int live = 0;
+
+  fprintf(out, "membrane profile, ticks are %s\n",
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+          "TSC cycles"
+#else
+          "ns"
+#endif
+          );
+  fprintf(out, "%6s %-20s %-7s %6s %6s %10s %10s %10s %10s %10s %10s %s\n", "node", "unit",
+          "engine", "points", "delays", "ctor", "ready", "blocks", "slept", "avg/block",
+          "max/block", "asleep");
+
+  for (int i = 0; i < PROFILE_UNITS; ++i) {
+    t_profile *profile = &units[i];
+
+    if (profile->used.load(std::memory_order_acquire) != 2) {
+      continue;
+    }
+    const char *engine = profile->engine.load(std::memory_order_relaxed);
+    uint64_t blocks = profile->blocks.load(std::memory_order_relaxed);
+    uint64_t ticks = profile->ticks.load(std::memory_order_relaxed);
+    int sleeping = profile->sleeping.load(std::memory_order_relaxed);
+    t_key key(profile->shape_type, profile->angle, profile->fragNums);
+    t_profile_total &total = totals[key];
+
+    fprintf(out, "%6d %-20s %-7s %6u %6u %10llu %10llu %10llu %10llu %10.0f %10llu %s\n",
+            profile->node, profile_label(name, profile->shape_type, profile->angle,
+                                          profile->fragNums).c_str(),
+            engine ? engine : "-", profile->points_n.load(std::memory_order_relaxed),
+            profile->delay_n.load(std::memory_order_relaxed),
+            (unsigned long long) profile->ctor.load(std::memory_order_relaxed),
+            (unsigned long long) profile->ready.load(std::memory_order_relaxed),
+            (unsigned long long) blocks,
+            (unsigned long long) profile->sleep_blocks.load(std::memory_order_relaxed),
+            profile_avg(ticks, blocks),
+            (unsigned long long) profile->max_ticks.load(std::memory_order_relaxed),
+            sleeping ? "yes" : "no");
+
+    total.instances++;
+    total.live++;
+    total.sleeping += sleeping != 0;
+    total.ctor += profile->ctor.load(std::memory_order_relaxed);
+    total.blocks += blocks;
+    total.sleep_blocks += profile->sleep_blocks.load(std::memory_order_relaxed);
+    total.ticks += ticks;
+    total.max_ticks = std::max(total.max_ticks,
+                               (uint64_t) profile->max_ticks.load(std::memory_order_relaxed));
+    live++;
+  }
+
+  for (int i = 0; i < PROFILE_SHAPES; ++i) {
+    t_profile_shape *shape = &shapes[i];
+
+    if (shape->used.load(std::memory_order_acquire) != 2) {
+      continue;
+    }
+    t_key key(shape->shape_type, shape->angle, shape->fragNums);
+    t_profile_total &total = totals[key];
+
+    total.instances += shape->instances.load(std::memory_order_relaxed);
+    total.ctor += shape->ctor.load(std::memory_order_relaxed);
+    total.blocks += shape->blocks.load(std::memory_order_relaxed);
+    total.sleep_blocks += shape->sleep_blocks.load(std::memory_order_relaxed);
+    total.ticks += shape->ticks.load(std::memory_order_relaxed);
+    total.max_ticks = std::max(total.max_ticks,
+                               (uint64_t) shape->max_ticks.load(std::memory_order_relaxed));
+  }
+
+  // per shape, the most expensive first
+  std::vector<t_totals::const_iterator> order;
+  for (t_totals::const_iterator it = totals.begin(); it != totals.end(); ++it) {
+    order.push_back(it);
+  }
+  std::sort(order.begin(), order.end(),
+            [](t_totals::const_iterator a, t_totals::const_iterator b) {
+              return a->second.ticks > b->second.ticks;
+            });
+
+  fprintf(out, "%d live, %llu not counted\n", live,
+          (unsigned long long) unprofiled.load(std::memory_order_relaxed));
+  fprintf(out, "%-20s %9s %6s %8s %10s %12s %10s %10s %14s\n", "unit", "instances", "live",
+          "sleeping", "avg ctor", "blocks", "avg/block", "max/block", "ticks");
+  for (size_t i = 0; i < order.size(); ++i) {
+    const t_key &key = order[i]->first;
+    const t_profile_total &total = order[i]->second;
+
+    fprintf(out, "%-20s %9llu %6llu %8llu %10.0f %12llu %10.0f %10llu %14llu\n",
+            profile_label(name, std::get<0>(key), std::get<1>(key), std::get<2>(key)).c_str(),
+            (unsigned long long) total.instances, (unsigned long long) total.live,
+            (unsigned long long) total.sleeping, profile_avg(total.ctor, total.instances),
+            (unsigned long long) total.blocks, profile_avg(total.ticks, total.blocks),
+            (unsigned long long) total.max_ticks, (unsigned long long) total.ticks);
+  }
+  fflush(out);
+}
@@ -0,0 +1,119 @@
+
+#ifndef Membrane_profile_h
+#define Membrane_profile_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Runtime counters of the running membranes, for finding out which ones
+// use the DSP budget. every instance claims a slot in a fixed table; the
+// audio thread only ever stores into its own slot, the dump reads all of
+// them from another thread. no locks: claiming and folding into the shape
+// totals are atomic operations, everything else relaxed loads and stores.
+// the numbers are statistics, a dump may see a block half counted.
+//
+// ticks are TSC cycles on x86, nanoseconds elsewhere.
+
+#define PROFILE_UNITS 1024  // live instances counted at once, the rest are not
+#define PROFILE_SHAPES 256  // shapes with totals of their finished instances
+
+static inline uint64_t profile_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// one live instance. written by the audio thread that runs it
+typedef struct {
+  std::atomic<int> used;             // 0 free, 1 being claimed, 2 counting
+  int shape_type;
+  float angle;
+  int fragNums;
+  int node;                          // the synth's node ID, -1 if unknown
+  std::atomic<uint64_t> ctor;        // ticks spent in the Ctor
+  std::atomic<uint64_t> ready;       // ticks from the Ctor to a running mesh, 0 until then
+  std::atomic<uint64_t> start;       // profile_ticks() at the Ctor
+  std::atomic<uint32_t> points_n;
+  std::atomic<uint32_t> delay_n;
+  std::atomic<const char *> engine;  // "mesh", "tiled" or "stencil"
+  std::atomic<uint64_t> blocks;      // computed blocks
+  std::atomic<uint64_t> sleep_blocks;
+  std::atomic<uint64_t> ticks;       // spent in computed blocks
+  std::atomic<uint64_t> max_ticks;   // the slowest computed block
+  std::atomic<int> sleeping;
+} t_profile;
+
+// the totals of the finished instances of one shape
+typedef struct {
+  std::atomic<int> used;  // 0 free, 1 being claimed, 2 keyed
+  int shape_type;
+  float angle;
+  int fragNums;
+  std::atomic<uint64_t> instances;
+  std::atomic<uint64_t> ctor;
+  std::atomic<uint64_t> blocks;
+  std::atomic<uint64_t> sleep_blocks;
+  std::atomic<uint64_t> ticks;
+  std::atomic<uint64_t> max_ticks;
+} t_profile_shape;
+
+// audio thread safe. NULL when the table is full; every function below
+// accepts NULL and does nothing
+t_profile *profile_claim(int shape_type, float angle, int fragNums, int node);
+// the Ctor is done, start was its profile_ticks()
+void profile_constructed(t_profile *profile, uint64_t start);
+// the mesh is running
+void profile_attach(t_profile *profile, uint32_t points_n, uint32_t delay_n, const char *engine);
+// folds the instance into its shape's totals and frees the slot
+void profile_release(t_profile *profile);
+
+static inline void profile_block(t_profile *profile, uint64_t ticks)
+{
+  if (profile) {
+    profile->blocks.store(profile->blocks.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+    profile->ticks.store(profile->ticks.load(std::memory_order_relaxed) + ticks,
+                         std::memory_order_relaxed);
+    if (ticks > profile->max_ticks.load(std::memory_order_relaxed)) {
+      profile->max_ticks.store(ticks, std::memory_order_relaxed);
+    }
+  }
+}
+
+static inline void profile_sleep_block(t_profile *profile)
+{
+  if (profile) {
+    profile->sleep_blocks.store(profile->sleep_blocks.load(std::memory_order_relaxed) + 1,
+                                std::memory_order_relaxed);
+  }
+}
+
+static inline void profile_sleeping(t_profile *profile, int sleeping)
+{
+  if (profile) {
+    profile->sleeping.store(sleeping, std::memory_order_relaxed);
+  }
+}
+
+// labels a shape in the dump, 0 if it has no name
+typedef int (*t_profile_name_fn)(int shape_type, float angle, int fragNums, char *name,
+                                 size_t size);
+
+// any thread: the live instances, then per shape the live and finished
+// ones together. name may be NULL
+void profile_dump(FILE *out, t_profile_name_fn name);
+
+#endif
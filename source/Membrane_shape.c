@@ -3,89 +3,154 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
-#include <time.h>
+#include <limits.h>
 
 #include "Membrane_shape.h"
 
 #define MEMCHUNK 512
-#define MAX_LINES (1024 * 16)
-#define MAX_TMP MAX_LINES
 #define QUIET
 
+// dense occupancy grid over the bounding box of the input points, so that
+// "is this lattice point in the shape" and "have we made a point here yet"
+// are both O(1) instead of a scan over every point
+typedef struct {
+  int x_min, y_min;
+  int w, h;
+  unsigned char *inside;
+  int *seen; // id + 1 of the point made in each cell, 0 for none
+} t_grid;
+
+static int grid_init(t_grid *grid, t_point p[], int pSize) {
+  int x_max = 0, y_max = 0;
+  long long w, h;
+
+  grid->x_min = grid->y_min = 0;
+  for (int i = 0; i < pSize; i++) {
+    if (i == 0 || p[i].x < grid->x_min) grid->x_min = p[i].x;
+    if (i == 0 || p[i].y < grid->y_min) grid->y_min = p[i].y;
+    if (i == 0 || p[i].x > x_max) x_max = p[i].x;
+    if (i == 0 || p[i].y > y_max) y_max = p[i].y;
+  }
+  w = pSize > 0 ? (long long) x_max - grid->x_min + 1 : 0;
+  h = pSize > 0 ? (long long) y_max - grid->y_min + 1 : 0;
+  if (w * h > SHAPE_GRID_MAX) {
+    return SHAPE_ERR_GRID;
+  }
+  grid->w = (int) w;
+  grid->h = (int) h;
+
+  grid->inside = (unsigned char *) calloc((size_t) grid->w * grid->h + 1, 1);
+  grid->seen = (int *) calloc((size_t) grid->w * grid->h + 1, sizeof(int));
+  if (grid->inside == NULL || grid->seen == NULL) {
+    free(grid->inside);
+    free(grid->seen);
+    return SHAPE_ERR_MEMORY;
+  }
 
-
-static int shp0(int x, int y, t_point p[], int pSize);
-
-typedef int (*inShapePtr2)(int, int, t_point p[], int pSize);
-
-
-inShapePtr2 inShapes2 = shp0;
-
-
-int tempMod0 = 0;
-int tempMod1 = 0;
-
-static int shp0(int x, int y, t_point p[], int pSize) {
-  int result = 0;
-  int check = 0;
-
-
-  for(int i = 0; i<pSize; i++){
-      if(x== p[i].x && y== p[i].y){
-          check++;
-          break;
-      }
+  for (int i = 0; i < pSize; i++) {
+    grid->inside[(size_t) (p[i].y - grid->y_min) * grid->w + (p[i].x - grid->x_min)] = 1;
   }
+  return SHAPE_OK;
+}
 
-  if(check==1){
-      result = 1;
+// cell of (x, y), or -1 outside the bounding box
+static long grid_cell(const t_grid *grid, int x, int y) {
+  x -= grid->x_min;
+  y -= grid->y_min;
+  if (x < 0 || y < 0 || x >= grid->w || y >= grid->h) {
+    return -1;
   }
+  return (long) y * grid->w + x;
+}
 
-  return(result);
+static void grid_free(t_grid *grid) {
+  free(grid->inside);
+  free(grid->seen);
 }
 
 //
 
 
-static void add(void **list, void *item, int position, int max_n) {
-  if (position < (max_n - 1)) {
-    list[position] = item;
+// make room for item n of a growable array of max_n items, doubling from
+// MEMCHUNK
+static int grow(void **list, int *max_n, int n, size_t size) {
+  int max;
+  void *grown;
+
+  if (n < *max_n) {
+    return SHAPE_OK;
   }
-  else {
-    printf("add reached maximum items (%d)\n", max_n);
-    exit(1);
+  if (*max_n > INT_MAX / 2) {
+    return SHAPE_ERR_SIZE;
   }
+  max = *max_n ? *max_n * 2 : MEMCHUNK;
+  grown = realloc(*list, (size_t) max * size);
+  if (grown == NULL) {
+    return SHAPE_ERR_MEMORY;
+  }
+  *list = grown;
+  *max_n = max;
+  return SHAPE_OK;
 }
 
+// a new point at (x, y), returns its id or an error code
+static int add_point(t_shape *shape, int x, int y) {
+  int error = grow((void **) &shape->points, &shape->points_max, shape->points_n, sizeof(t_point));
+  t_point *point;
 
-extern t_shape *getShape2(int shape_type, t_point p[], int pSize) {
+  if (error != SHAPE_OK) {
+    return error;
+  }
+  point = &shape->points[shape->points_n];
+  point->id = shape->points_n;
+  point->x = x;
+  point->y = y;
+  point->is_edge = 0;
+  return shape->points_n++;
+}
 
+static int add_line(t_shape *shape, int a, int b) {
+  int error = grow((void **) &shape->lines, &shape->lines_max, shape->lines_n, sizeof(t_line));
 
-  inShapePtr2 inShape = inShapes2;
-  t_point *look;
-  int possible[6][2];
-  t_line **lines = calloc(MAX_LINES, sizeof(t_line *));
-  int lines_n = 0;
+  if (error != SHAPE_OK) {
+    return error;
+  }
+  shape->lines[shape->lines_n].a = a;
+  shape->lines[shape->lines_n].b = b;
+  shape->lines_n++;
+  return SHAPE_OK;
+}
 
-  t_shape *result = (t_shape *) calloc(1, sizeof(t_shape));
-  t_point **search = (t_point **) calloc(MAX_TMP, sizeof(t_point *));
-  int search_n = 0;
 
-  t_point **points = (t_point **) calloc(MAX_TMP, sizeof(t_point *));
-  int points_n = 0;
+// flood fill the hex lattice from (0,0) over the points p[]. every point of
+// the shape is found once, in depth-first order from a stack of points still
+// to look around
+extern int getShape2(int shape_type, t_point p[], int pSize, t_shape **result) {
 
-  int i, j, x, y;
-  t_line *line_p;
-  t_point *point_p;
-  int seen;
-  int edge_n = 0;
+  int look;
+  int possible[6][2];
+  int *search = NULL;
+  int search_n = 0;
+  int search_max = 0;
 
+  int i, x, y, id;
+  long cell;
+  int error = SHAPE_OK;
+  t_grid grid;
+  t_shape *shape;
 
-  look = (t_point *)calloc(1, sizeof(t_point));
+  *result = NULL;
 
-  look->x = 0;
-  look->y = 0;
-  look->id = 0;
+  shape = (t_shape *) calloc(1, sizeof(t_shape));
+  if (shape == NULL) {
+    return SHAPE_ERR_MEMORY;
+  }
+  error = grid_init(&grid, p, pSize);
+  if (error != SHAPE_OK) {
+    free(shape);
+    return error;
+  }
+  shape->shape_type = shape_type;
 
   possible[0][0] =  1; possible[0][1] =  1;
   possible[1][0] =  2; possible[1][1] =  0;
@@ -94,117 +159,100 @@ extern t_shape *getShape2(int shape_type, t_point p[], int pSize) {
   possible[4][0] = -2; possible[4][1] =  0;
   possible[5][0] = -1; possible[5][1] =  1;
 
-  add((void *) points, (void *) look, points_n++, MAX_TMP);
+  look = add_point(shape, 0, 0);
+  if (look < 0) {
+    error = look;
+  }
+  cell = grid_cell(&grid, 0, 0);
+  if (cell >= 0) {
+    grid.seen[cell] = 1;
+  }
 
-  while(look != NULL) {
+  while(error == SHAPE_OK && look >= 0) {
 
-    for (i = 0; i < 6; ++i) {
+    for (i = 0; i < 6 && error == SHAPE_OK; ++i) {
 
-      x = look->x + possible[i][0];
-      y = look->y + possible[i][1];
+      x = shape->points[look].x + possible[i][0];
+      y = shape->points[look].y + possible[i][1];
+      cell = grid_cell(&grid, x, y);
 
-      if (! (*inShape)(x, y, p, pSize)) {
+      if (cell < 0 || !grid.inside[cell]) {
 
-    if (!look->is_edge) {
-      look->is_edge = 1;
-      edge_n++;
-    }
+        if (!shape->points[look].is_edge) {
+          shape->points[look].is_edge = 1;
+          shape->edge_n++;
+        }
 
       } else {
 
-        seen = 0;
+        // seen holds id + 1, zero for no point yet
+        id = grid.seen[cell] - 1;
 
-        for (j = 0; j < points_n; ++j) {
-          
-          point_p = points[j];
+        if (id < 0) {
 
-          if (point_p->x == x && point_p->y == y) {
+          id = add_point(shape, x, y);
+          error = grow((void **) &search, &search_max, search_n, sizeof(int));
 
-            seen = 1;
+          if (id < 0 || error != SHAPE_OK) {
+            error = id < 0 ? id : error;
             break;
           }
-        }
-
-
-    
-        if (!seen) {
-    
-      point_p = (t_point *)calloc(1, sizeof(t_point));
-  
-      point_p->x = x;
-
-      point_p->y = y;
-
-      point_p->id = points_n;
-
-
-      add((void **) search,  (void *) point_p, search_n++,  MAX_TMP);
-
-      add((void **) points, (void *) point_p, points_n++, MAX_TMP);
+          grid.seen[cell] = id + 1;
+          search[search_n++] = id;
         }
 
         if (i < 3) {
-     
-      line_p = calloc(1, sizeof(t_line));
-
-      line_p->a = look;
-   
-      line_p->b = point_p;
-
-
-      add((void **) lines, (void *) line_p, lines_n++, MAX_LINES);
+          error = add_line(shape, look, id);
         }
       }
 
     }
 
-
-    if (search_n == 0) {
-
-      look = NULL;
-      break;
-    }
-    else {
-  
-      look = search[--search_n];
-    }
-
+    look = search_n > 0 ? search[--search_n] : -1;
   }
 
   free(search);
+  grid_free(&grid);
 
-
-  result->points   = points;
-  result->points_n = points_n;
-  result->lines    = lines;
-  result->lines_n  = lines_n;
-  result->edge_n = edge_n;
+  if (error != SHAPE_OK) {
+    free_shape(shape);
+    return error;
+  }
 
 
 #ifndef QUIET
   printf("Made shape with %d lines, %d points and %d edge points.\n",
-     lines_n,
-     points_n,
-     edge_n
+     shape->lines_n,
+     shape->points_n,
+     shape->edge_n
      );
 #endif
 
 
-  return(result);
+  *result = shape;
+  return SHAPE_OK;
 }
 
 
 
 
 extern void free_shape(t_shape *shape) {
-  int i;
-  for (i = 0; i < shape->lines_n; ++i) {
-    free(shape->lines[i]);
-  }
-  for (i = 0; i < shape->points_n; ++i) {
-    free(shape->points[i]);
-  }
   free(shape->lines);
   free(shape->points);
   free(shape);
 }
+
+extern const char *shape_error(int error) {
+  switch (error) {
+  case SHAPE_OK:
+    return "ok";
+  case SHAPE_ERR_MEMORY:
+    return "out of memory";
+  case SHAPE_ERR_SIZE:
+    return "too many points or lines";
+  case SHAPE_ERR_GRID:
+    return "bounding box too large";
+  default:
+    return "unknown error";
+  }
+}
@@ -1,3 +1,6 @@
+#ifndef Membrane_shape_h
+#define Membrane_shape_h
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -5,6 +8,16 @@ extern "C" {
 
 #define SHAPE_N 3
 
+// getShape2() results
+enum {
+  SHAPE_OK = 0,
+  SHAPE_ERR_MEMORY = -1, // out of memory
+  SHAPE_ERR_SIZE = -2,   // more points or lines than an int can count
+  SHAPE_ERR_GRID = -3    // a bounding box of more than SHAPE_GRID_MAX cells
+};
+
+#define SHAPE_GRID_MAX (1 << 24) // lattice cells, 5 bytes each while building
+
 typedef struct {
   int id;
   int x;
@@ -12,23 +25,33 @@ typedef struct {
   int is_edge;
 } t_point;
 
+// the ids of the two junctions a line joins
 typedef struct {
-  t_point *a;
-  t_point *b;
+  int a;
+  int b;
 } t_line;
 
+// points and lines live in contiguous arrays owned by the shape, grown as
+// the flood fill finds them; free_shape() releases everything
 typedef struct {
   int shape_type;
-  t_line **lines;
+  t_line *lines;
   int lines_n;
-  t_point **points;
+  int lines_max;
+  t_point *points;
   int points_n;
+  int points_max;
   int edge_n;
 } t_shape;
 
-extern t_shape *getShape2(int shape_type, t_point p[], int pSize);
+// flood fill the lattice from (0,0) over p[]. SHAPE_OK and the shape in
+// *result, or an error code and *result NULL
+extern int getShape2(int shape_type, t_point p[], int pSize, t_shape **result);
 extern void free_shape(t_shape *shape);
+extern const char *shape_error(int error);
 
 #ifdef __cplusplus
 }
 #endif
+
+#endif
@@ -0,0 +1,454 @@
+
+// Vectorised mesh_cycle() body shared by the per-ISA translation units.
+// Each of Membrane_simd_*.cpp is compiled with its own instruction set flags,
+// defines a traits struct V and instantiates mesh_cycle_simd<V, MODEL> for
+// every model. MODEL is a compile-time constant, so the model tests below
+// vanish from the instantiated loops.
+//
+// W junctions are processed per step using the padded slot-major port
+// table (ell_in/ell_out). Unused slots read the always-zero delay zero_d and
+// write the scratch delay dump_d. The operation order per junction is the
+// same as mesh_cycle() and no FMA contraction is used, so results only differ
+// from the scalar kernel by the sign of zero; see MESH_SIMD_TOLERANCE.
+//
+// The structured stencil kernels (stencil_cycle_simd) are instantiated the
+// same way, the scalar one with V_scalar.
+//
+// No junction loop takes the input; every kernel adds the strike
+// (t_mesh_strike) after its junctions and before its rim pass.
+
+#ifndef Membrane_simd_h
+#define Membrane_simd_h
+
+#include "Membrane_mesh.h"
+#include "Membrane_stencil.h"
+
+// drive into every delay junction i wrote this sample, as if it had been
+// part of its pressure
+template <int MODEL>
+static inline void mesh_strike_junction(const t_mesh *mesh, uint32_t i, float *a, float drive)
+{
+  uint32_t p1 = (MODEL & MESH_RIM_GUIDES) ? mesh->port_off[i + 1] : mesh->line_end[i];
+
+  for (uint32_t p = mesh->port_off[i]; p < p1; ++p) {
+    a[mesh->out[p]] += drive;
+  }
+  if (MODEL & MESH_SELF_LOOP) {
+    a[mesh->rim_d + i] += drive;
+  }
+}
+
+// the whole strike, drive being loss * input; returns what junction 0
+// took, for the output
+template <int MODEL>
+static inline float mesh_strike_add(const t_mesh *mesh, const t_mesh_strike *strike, float *a,
+                                    float drive)
+{
+  for (uint32_t s = 0; s < strike->n; ++s) {
+    mesh_strike_junction<MODEL>(mesh, strike->junction[s], a, drive * strike->weight[s]);
+  }
+  return drive * strike->output;
+}
+
+template <class V, int MODEL>
+static inline float mesh_cycle_simd(const t_mesh *mesh, t_mesh_state *state,
+                                    float input, float yj, float yj_r, float loss)
+{
+  typedef typename V::reg reg;
+
+  const uint32_t pad = mesh->points_pad;
+  const t_mesh_ell *ell = &mesh->ell[(MODEL & MESH_RIM_GUIDES) ? 1 : 0];
+  const uint32_t *ell_in = ell->in;
+  const uint32_t *ell_out = ell->out;
+  float *a = state->a;
+  float *b = state->b;
+  float *self_a = a + mesh->rim_d;
+  const float *self_b = b + mesh->rim_d;
+
+  const reg v_yj = V::set1(yj);
+  const reg v_yj_r = V::set1(yj_r);
+  const reg v_two = V::set1(2.0f);
+  const reg v_one = V::set1(1.0f);
+  const reg v_loss = V::set1(loss);
+  float result = 0;
+
+  for (uint32_t j = 0; j < pad; j += V::W) {
+    reg total = V::zero();
+    reg in_b[MESH_MAX_PORTS];
+
+    for (int s = 0; s < MESH_MAX_PORTS; ++s) {
+      in_b[s] = V::gather(b, ell_in + s * pad + j);
+      total = V::add(total, in_b[s]);
+    }
+
+    reg sb = V::zero();
+    if (MODEL & MESH_SELF_LOOP) {
+      sb = V::load(self_b + j);
+      reg yc = V::sub(v_yj, V::load(ell->ports + j));
+      total = V::mul(V::mul(v_two, V::add(total, V::mul(yc, sb))), v_yj_r);
+    }
+    else {
+      // a junction without ports sums nothing, keep it silent rather than 0/0
+      total = V::mul(total, V::div(v_two, V::max(V::load(ell->ports + j), v_one)));
+    }
+
+    total = V::mul(total, v_loss);
+
+    for (int s = 0; s < MESH_MAX_PORTS; ++s) {
+      V::scatter(a, ell_out + s * pad + j, V::sub(total, in_b[s]));
+    }
+    if (MODEL & MESH_SELF_LOOP) {
+      V::store(self_a + j, V::sub(total, sb));
+    }
+
+    if (j == 0) {
+      result = V::first(total);
+    }
+  }
+  result += mesh_strike_add<MODEL>(mesh, state->strike, a, loss * input);
+
+  // circulate the unit delays: filter the rim guides in place and swap
+  float *rim = a + mesh->line_d;
+  float *c = state->c;
+  uint32_t rim_n = (MODEL & MESH_RIM_GUIDES) ? mesh->rim_d - mesh->line_d : 0;
+  uint32_t r = 0;
+  const reg v_zero = V::zero();
+  const reg v_half = V::set1(0.5f);
+
+  for (; r + V::W <= rim_n; r += V::W) {
+    reg inverted = V::sub(v_zero, V::load(rim + r));
+    if (MODEL & MESH_RIM_FILTER) {
+      V::store(rim + r, V::mul(V::add(inverted, V::load(c + r)), v_half));
+      V::store(c + r, inverted);
+    }
+    else {
+      V::store(rim + r, inverted);
+    }
+  }
+  for (; r < rim_n; ++r) {
+    float inverted = 0.0f - rim[r];
+    if (MODEL & MESH_RIM_FILTER) {
+      rim[r] = (inverted + c[r]) * 0.5f;
+      c[r] = inverted;
+    }
+    else {
+      rim[r] = inverted;
+    }
+  }
+
+  state->a = b;
+  state->b = a;
+
+  return(result);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// all voices of a t_mesh_lanes in one pass over the topology. the lanes of
+// a delay are contiguous, so every port is a plain vector load or store
+
+template <class V, int MODEL>
+static inline void mesh_cycle_lanes_simd(const t_mesh *mesh, t_mesh_lanes *state,
+                                         const float *input, const float *yj,
+                                         const float *yj_r, const float *loss, float *result)
+{
+  typedef typename V::reg reg;
+
+  const uint32_t *port_off = mesh->port_off;
+  const uint32_t *port_end = (MODEL & MESH_RIM_GUIDES) ? mesh->port_off + 1 : mesh->line_end;
+  const uint32_t *in = mesh->in;
+  const uint32_t *out = mesh->out;
+  const uint32_t stride = (uint32_t) state->stride;
+  float *a = state->a;
+  float *b = state->b;
+
+  const reg v_two = V::set1(2.0f);
+
+  for (uint32_t i = 0; i < mesh->points_n; ++i) {
+    uint32_t p0 = port_off[i];
+    uint32_t p1 = port_end[i];
+    const reg v_ports = V::set1((float) (p1 - p0));
+    const reg v_scale = V::set1(2.0f / (float) (p1 > p0 ? p1 - p0 : 1));
+
+    for (uint32_t l = 0; l < stride; l += V::W) {
+      reg total = V::zero();
+
+      for (uint32_t p = p0; p < p1; ++p) {
+        total = V::add(total, V::load(b + in[p] * stride + l));
+      }
+
+      reg sb = V::zero();
+      if (MODEL & MESH_SELF_LOOP) {
+        sb = V::load(b + (mesh->rim_d + i) * stride + l);
+        reg yc = V::sub(V::load(yj + l), v_ports);
+        total = V::mul(V::mul(v_two, V::add(total, V::mul(yc, sb))), V::load(yj_r + l));
+      }
+      else {
+        total = V::mul(total, v_scale);
+      }
+
+      total = V::mul(total, V::load(loss + l));
+
+      for (uint32_t p = p0; p < p1; ++p) {
+        V::store(a + out[p] * stride + l, V::sub(total, V::load(b + in[p] * stride + l)));
+      }
+      if (MODEL & MESH_SELF_LOOP) {
+        V::store(a + (mesh->rim_d + i) * stride + l, V::sub(total, sb));
+      }
+
+      if (i == 0) {
+        V::store(result + l, total);
+      }
+    }
+  }
+
+  // the strike, as mesh_strike_add() for every lane
+  const t_mesh_strike *strike = state->strike;
+
+  for (uint32_t l = 0; l < stride; l += V::W) {
+    const reg drive = V::mul(V::load(loss + l), V::load(input + l));
+
+    for (uint32_t s = 0; s < strike->n; ++s) {
+      uint32_t i = strike->junction[s];
+      uint32_t p1 = port_end[i];
+      const reg v_drive = V::mul(drive, V::set1(strike->weight[s]));
+
+      for (uint32_t p = port_off[i]; p < p1; ++p) {
+        float *d = a + out[p] * stride + l;
+        V::store(d, V::add(V::load(d), v_drive));
+      }
+      if (MODEL & MESH_SELF_LOOP) {
+        float *d = a + (mesh->rim_d + i) * stride + l;
+        V::store(d, V::add(V::load(d), v_drive));
+      }
+    }
+    V::store(result + l, V::add(V::load(result + l), V::mul(drive, V::set1(strike->output))));
+  }
+
+  // rim guides of every lane form one contiguous range
+  float *rim = a + mesh->line_d * stride;
+  float *c = state->c;
+  uint32_t rim_n = (MODEL & MESH_RIM_GUIDES) ? (mesh->rim_d - mesh->line_d) * stride : 0;
+  const reg v_zero = V::zero();
+  const reg v_half = V::set1(0.5f);
+
+  for (uint32_t r = 0; r < rim_n; r += V::W) {
+    reg inverted = V::sub(v_zero, V::load(rim + r));
+    if (MODEL & MESH_RIM_FILTER) {
+      V::store(rim + r, V::mul(V::add(inverted, V::load(c + r)), v_half));
+      V::store(c + r, inverted);
+    }
+    else {
+      V::store(rim + r, inverted);
+    }
+  }
+
+  state->a = b;
+  state->b = a;
+}
+
+// a table of one kernel instantiated for every model, indexed by model id
+#define MESH_MODEL_TABLE(f) { f<0>, f<1>, f<2>, f<3>, f<4>, f<5>, f<6>, f<7> }
+
+// one float per "vector", for the scalar lanes and stencil kernels
+struct V_scalar {
+  typedef float reg;
+  enum { W = 1 };
+
+  static inline reg zero() { return 0.f; }
+  static inline reg set1(float x) { return x; }
+  static inline reg load(const float *p) { return *p; }
+  static inline void store(float *p, reg v) { *p = v; }
+  static inline reg add(reg x, reg y) { return x + y; }
+  static inline reg sub(reg x, reg y) { return x - y; }
+  static inline reg mul(reg x, reg y) { return x * y; }
+  static inline reg div(reg x, reg y) { return x / y; }
+  static inline reg max(reg x, reg y) { return x > y ? x : y; }
+};
+
+////////////////////////////////////////////////////////////////////
+
+// the structured stencil (Membrane_stencil.h). interior junctions have six
+// line ports in fixed directions, so a run of them along a lattice row is
+// plain vector loads and stores at constant offsets
+
+template <class V, int MODEL>
+static inline uint32_t stencil_run(const t_stencil *stencil, float *a, const float *b,
+                                   uint32_t c, uint32_t end,
+                                   float yj, float yj_r, float loss)
+{
+  typedef typename V::reg reg;
+
+  const uint32_t plane = stencil->plane;
+  const int32_t *offset = stencil->offset;
+  float *self_a = a + STENCIL_DIRS * plane;
+  const float *self_b = b + STENCIL_DIRS * plane;
+
+  const reg v_yc = V::set1(yj - STENCIL_DIRS);
+  const reg v_yj_r = V::set1(yj_r);
+  const reg v_two = V::set1(2.0f);
+  const reg v_scale = V::set1(2.0f / STENCIL_DIRS);
+  const reg v_loss = V::set1(loss);
+
+  for (; c + V::W <= end; c += V::W) {
+    reg total = V::zero();
+    reg in_b[STENCIL_DIRS];
+
+    // the wave the neighbour in direction k sent back towards us
+    for (int k = 0; k < STENCIL_DIRS; ++k) {
+      const float *back = b + ((k + 3) % STENCIL_DIRS) * plane + c;
+      in_b[k] = V::load(back + offset[k]);
+      total = V::add(total, in_b[k]);
+    }
+
+    reg sb = V::zero();
+    if (MODEL & MESH_SELF_LOOP) {
+      sb = V::load(self_b + c);
+      total = V::mul(V::mul(v_two, V::add(total, V::mul(v_yc, sb))), v_yj_r);
+    }
+    else {
+      total = V::mul(total, v_scale);
+    }
+
+    total = V::mul(total, v_loss);
+
+    for (int k = 0; k < STENCIL_DIRS; ++k) {
+      V::store(a + k * plane + c, V::sub(total, in_b[k]));
+    }
+    if (MODEL & MESH_SELF_LOOP) {
+      V::store(self_a + c, V::sub(total, sb));
+    }
+  }
+  return c;
+}
+
+// an irregular junction, as mesh_junction() over the flat stencil state
+template <int MODEL>
+static inline float stencil_edge(const t_stencil *stencil, uint32_t j, float *a, const float *b,
+                                 float yj, float yj_r, float loss)
+{
+  const uint32_t *in = stencil->in;
+  const uint32_t *out = stencil->out;
+  uint32_t p0 = stencil->port_off[j];
+  uint32_t p1 = (MODEL & MESH_RIM_GUIDES) ? stencil->port_off[j + 1] : stencil->line_end[j];
+  uint32_t self = STENCIL_DIRS * stencil->plane + stencil->edge_cell[j];
+  uint32_t p;
+  float total = 0;
+
+  for (p = p0; p < p1; ++p) {
+    total += b[in[p]];
+  }
+
+  if (MODEL & MESH_SELF_LOOP) {
+    float yc = yj - (int) (p1 - p0);
+    total = 2.0f * (total + (yc * b[self])) * yj_r;
+  }
+  else {
+    total *= (2.0f / ((float) (p1 > p0 ? p1 - p0 : 1)));
+  }
+
+  total *= loss;
+
+  for (p = p0; p < p1; ++p) {
+    a[out[p]] = total - b[in[p]];
+  }
+  if (MODEL & MESH_SELF_LOOP) {
+    a[self] = total - b[self];
+  }
+
+  return total;
+}
+
+// the strike on the stencil, as mesh_strike_add()
+template <int MODEL>
+static inline float stencil_strike_add(const t_stencil *stencil, const t_stencil_strike *strike,
+                                       float *a, float drive)
+{
+  const uint32_t plane = stencil->plane;
+
+  for (uint32_t s = 0; s < strike->n; ++s) {
+    uint32_t c = strike->cell[s];
+    uint32_t j = strike->edge[s];
+    float share = drive * strike->weight[s];
+
+    if (j == stencil->edge_n) {
+      for (int k = 0; k < STENCIL_DIRS; ++k) {
+        a[k * plane + c] += share;
+      }
+    }
+    else {
+      uint32_t p1 = (MODEL & MESH_RIM_GUIDES) ? stencil->port_off[j + 1] : stencil->line_end[j];
+
+      for (uint32_t p = stencil->port_off[j]; p < p1; ++p) {
+        a[stencil->out[p]] += share;
+      }
+    }
+    if (MODEL & MESH_SELF_LOOP) {
+      a[STENCIL_DIRS * plane + c] += share;
+    }
+  }
+  return drive * strike->output;
+}
+
+template <class V, int MODEL>
+static inline float stencil_cycle_simd(const t_stencil *stencil, t_stencil_state *state,
+                                       float input, float yj, float yj_r, float loss)
+{
+  typedef typename V::reg reg;
+
+  float *a = state->a;
+  float *b = state->b;
+  float result = 0;
+
+  for (uint32_t r = 0; r < stencil->run_n; ++r) {
+    uint32_t end = stencil->run_end[r];
+    uint32_t c = stencil_run<V, MODEL>(stencil, a, b, stencil->run_start[r], end,
+                                       yj, yj_r, loss);
+    stencil_run<V_scalar, MODEL>(stencil, a, b, c, end, yj, yj_r, loss);
+  }
+
+  for (uint32_t j = 0; j < stencil->edge_n; ++j) {
+    float total = stencil_edge<MODEL>(stencil, j, a, b, yj, yj_r, loss);
+
+    if (j == 0) {
+      result = total;
+    }
+  }
+  result += stencil_strike_add<MODEL>(stencil, state->strike, a, loss * input);
+
+  // the rim guides are contiguous, as in mesh_cycle_simd()
+  float *rim = a + stencil->rim_off;
+  float *c = state->c;
+  uint32_t rim_n = (MODEL & MESH_RIM_GUIDES) ? stencil->rim_n : 0;
+  uint32_t r = 0;
+  const reg v_zero = V::zero();
+  const reg v_half = V::set1(0.5f);
+
+  for (; r + V::W <= rim_n; r += V::W) {
+    reg inverted = V::sub(v_zero, V::load(rim + r));
+    if (MODEL & MESH_RIM_FILTER) {
+      V::store(rim + r, V::mul(V::add(inverted, V::load(c + r)), v_half));
+      V::store(c + r, inverted);
+    }
+    else {
+      V::store(rim + r, inverted);
+    }
+  }
+  for (; r < rim_n; ++r) {
+    float inverted = 0.0f - rim[r];
+    if (MODEL & MESH_RIM_FILTER) {
+      rim[r] = (inverted + c[r]) * 0.5f;
+      c[r] = inverted;
+    }
+    else {
+      rim[r] = inverted;
+    }
+  }
+
+  state->a = b;
+  state->b = a;
+
+  return(result);
+}
+
+#endif
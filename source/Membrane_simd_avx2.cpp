@@ -0,0 +1,61 @@
+// AVX2 mesh kernel, compiled with -mavx2 (see CMakeLists.txt)
+
+#include "Membrane_simd.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+struct V_avx2 {
+  typedef __m256 reg;
+  enum { W = 8 };
+
+  static inline reg zero() { return _mm256_setzero_ps(); }
+  static inline reg set1(float x) { return _mm256_set1_ps(x); }
+  static inline reg load(const float *p) { return _mm256_loadu_ps(p); }
+  static inline void store(float *p, reg v) { _mm256_storeu_ps(p, v); }
+  static inline reg add(reg x, reg y) { return _mm256_add_ps(x, y); }
+  static inline reg sub(reg x, reg y) { return _mm256_sub_ps(x, y); }
+  static inline reg mul(reg x, reg y) { return _mm256_mul_ps(x, y); }
+  static inline reg div(reg x, reg y) { return _mm256_div_ps(x, y); }
+  static inline reg max(reg x, reg y) { return _mm256_max_ps(x, y); }
+  static inline float first(reg v) { return _mm256_cvtss_f32(v); }
+
+  static inline reg gather(const float *base, const uint32_t *idx) {
+    return _mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i *) idx), 4);
+  }
+  // AVX2 has no scatter
+  static inline void scatter(float *base, const uint32_t *idx, reg v) {
+    float t[8];
+    _mm256_storeu_ps(t, v);
+    for (int k = 0; k < 8; ++k) {
+      base[idx[k]] = t[k];
+    }
+  }
+};
+
+template <int MODEL>
+static float mesh_cycle_avx2_model(const t_mesh *mesh, t_mesh_state *state,
+                                   float input, float yj, float yj_r, float loss)
+{
+  return mesh_cycle_simd<V_avx2, MODEL>(mesh, state, input, yj, yj_r, loss);
+}
+
+template <int MODEL>
+static void mesh_cycle_lanes_avx2_model(const t_mesh *mesh, t_mesh_lanes *state, const float *input,
+                                        const float *yj, const float *yj_r, const float *loss, float *result)
+{
+  mesh_cycle_lanes_simd<V_avx2, MODEL>(mesh, state, input, yj, yj_r, loss, result);
+}
+
+template <int MODEL>
+static float stencil_cycle_avx2_model(const t_stencil *stencil, t_stencil_state *state,
+                                      float input, float yj, float yj_r, float loss)
+{
+  return stencil_cycle_simd<V_avx2, MODEL>(stencil, state, input, yj, yj_r, loss);
+}
+
+extern const t_mesh_cycle_fn mesh_cycle_avx2[MESH_MODEL_N] = MESH_MODEL_TABLE(mesh_cycle_avx2_model);
+extern const t_mesh_lanes_fn mesh_cycle_lanes_avx2[MESH_MODEL_N] = MESH_MODEL_TABLE(mesh_cycle_lanes_avx2_model);
+extern const t_stencil_cycle_fn stencil_cycle_avx2[MESH_MODEL_N] = MESH_MODEL_TABLE(stencil_cycle_avx2_model);
+
+#endif
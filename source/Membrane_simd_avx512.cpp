@@ -0,0 +1,57 @@
+// AVX-512 mesh kernel, compiled with -mavx512f (see CMakeLists.txt)
+
+#include "Membrane_simd.h"
+
+#ifdef __AVX512F__
+#include <immintrin.h>
+
+struct V_avx512 {
+  typedef __m512 reg;
+  enum { W = 16 };
+
+  static inline reg zero() { return _mm512_setzero_ps(); }
+  static inline reg set1(float x) { return _mm512_set1_ps(x); }
+  static inline reg load(const float *p) { return _mm512_loadu_ps(p); }
+  static inline void store(float *p, reg v) { _mm512_storeu_ps(p, v); }
+  static inline reg add(reg x, reg y) { return _mm512_add_ps(x, y); }
+  static inline reg sub(reg x, reg y) { return _mm512_sub_ps(x, y); }
+  static inline reg mul(reg x, reg y) { return _mm512_mul_ps(x, y); }
+  static inline reg div(reg x, reg y) { return _mm512_div_ps(x, y); }
+  static inline reg max(reg x, reg y) { return _mm512_max_ps(x, y); }
+  static inline float first(reg v) { return _mm_cvtss_f32(_mm512_castps512_ps128(v)); }
+
+  static inline reg gather(const float *base, const uint32_t *idx) {
+    return _mm512_i32gather_ps(_mm512_loadu_si512(idx), base, 4);
+  }
+  // only the dump slot is written twice, so conflicting lanes do not matter
+  static inline void scatter(float *base, const uint32_t *idx, reg v) {
+    _mm512_i32scatter_ps(base, _mm512_loadu_si512(idx), v, 4);
+  }
+};
+
+template <int MODEL>
+static float mesh_cycle_avx512_model(const t_mesh *mesh, t_mesh_state *state,
+                                     float input, float yj, float yj_r, float loss)
+{
+  return mesh_cycle_simd<V_avx512, MODEL>(mesh, state, input, yj, yj_r, loss);
+}
+
+template <int MODEL>
+static void mesh_cycle_lanes_avx512_model(const t_mesh *mesh, t_mesh_lanes *state, const float *input,
+                                          const float *yj, const float *yj_r, const float *loss, float *result)
+{
+  mesh_cycle_lanes_simd<V_avx512, MODEL>(mesh, state, input, yj, yj_r, loss, result);
+}
+
+template <int MODEL>
+static float stencil_cycle_avx512_model(const t_stencil *stencil, t_stencil_state *state,
+                                        float input, float yj, float yj_r, float loss)
+{
+  return stencil_cycle_simd<V_avx512, MODEL>(stencil, state, input, yj, yj_r, loss);
+}
+
+extern const t_mesh_cycle_fn mesh_cycle_avx512[MESH_MODEL_N] = MESH_MODEL_TABLE(mesh_cycle_avx512_model);
+extern const t_mesh_lanes_fn mesh_cycle_lanes_avx512[MESH_MODEL_N] = MESH_MODEL_TABLE(mesh_cycle_lanes_avx512_model);
+extern const t_stencil_cycle_fn stencil_cycle_avx512[MESH_MODEL_N] = MESH_MODEL_TABLE(stencil_cycle_avx512_model);
+
+#endif
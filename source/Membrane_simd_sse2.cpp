@@ -0,0 +1,59 @@
+// SSE2 mesh kernel, compiled with -msse2 (see CMakeLists.txt)
+
+#include "Membrane_simd.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+struct V_sse2 {
+  typedef __m128 reg;
+  enum { W = 4 };
+
+  static inline reg zero() { return _mm_setzero_ps(); }
+  static inline reg set1(float x) { return _mm_set1_ps(x); }
+  static inline reg load(const float *p) { return _mm_loadu_ps(p); }
+  static inline void store(float *p, reg v) { _mm_storeu_ps(p, v); }
+  static inline reg add(reg x, reg y) { return _mm_add_ps(x, y); }
+  static inline reg sub(reg x, reg y) { return _mm_sub_ps(x, y); }
+  static inline reg mul(reg x, reg y) { return _mm_mul_ps(x, y); }
+  static inline reg div(reg x, reg y) { return _mm_div_ps(x, y); }
+  static inline reg max(reg x, reg y) { return _mm_max_ps(x, y); }
+  static inline float first(reg v) { return _mm_cvtss_f32(v); }
+
+  // no gather/scatter before AVX2, so go through scalar loads and stores
+  static inline reg gather(const float *base, const uint32_t *idx) {
+    return _mm_setr_ps(base[idx[0]], base[idx[1]], base[idx[2]], base[idx[3]]);
+  }
+  static inline void scatter(float *base, const uint32_t *idx, reg v) {
+    float t[4];
+    _mm_storeu_ps(t, v);
+    base[idx[0]] = t[0]; base[idx[1]] = t[1]; base[idx[2]] = t[2]; base[idx[3]] = t[3];
+  }
+};
+
+template <int MODEL>
+static float mesh_cycle_sse2_model(const t_mesh *mesh, t_mesh_state *state,
+                                   float input, float yj, float yj_r, float loss)
+{
+  return mesh_cycle_simd<V_sse2, MODEL>(mesh, state, input, yj, yj_r, loss);
+}
+
+template <int MODEL>
+static void mesh_cycle_lanes_sse2_model(const t_mesh *mesh, t_mesh_lanes *state, const float *input,
+                                        const float *yj, const float *yj_r, const float *loss, float *result)
+{
+  mesh_cycle_lanes_simd<V_sse2, MODEL>(mesh, state, input, yj, yj_r, loss, result);
+}
+
+template <int MODEL>
+static float stencil_cycle_sse2_model(const t_stencil *stencil, t_stencil_state *state,
+                                      float input, float yj, float yj_r, float loss)
+{
+  return stencil_cycle_simd<V_sse2, MODEL>(stencil, state, input, yj, yj_r, loss);
+}
+
+extern const t_mesh_cycle_fn mesh_cycle_sse2[MESH_MODEL_N] = MESH_MODEL_TABLE(mesh_cycle_sse2_model);
+extern const t_mesh_lanes_fn mesh_cycle_lanes_sse2[MESH_MODEL_N] = MESH_MODEL_TABLE(mesh_cycle_lanes_sse2_model);
+extern const t_stencil_cycle_fn stencil_cycle_sse2[MESH_MODEL_N] = MESH_MODEL_TABLE(stencil_cycle_sse2_model);
+
+#endif
@@ -0,0 +1,445 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Membrane_stencil.h"
+#include "Membrane_simd.h"
+
+#define ALIGN_FLOATS(n) (((n) + (MESH_ALIGN / sizeof(float)) - 1) & ~(MESH_ALIGN / sizeof(float) - 1))
+
+////////////////////////////////////////////////////////////////////
+
+// the lattice directions of getShape2(), in the same order
+static const int possible[STENCIL_DIRS][2] = {
+  { 1, 1}, { 2, 0}, { 1, -1}, {-1, -1}, {-2, 0}, {-1, 1}
+};
+
+static int stencil_dir(int dx, int dy)
+{
+  for (int k = 0; k < STENCIL_DIRS; ++k) {
+    if (possible[k][0] == dx && possible[k][1] == dy) {
+      return k;
+    }
+  }
+  return -1;
+}
+
+t_stencil *compile_stencil(const t_shape *shape)
+{
+  uint32_t points_n = (uint32_t) shape->points_n;
+  const t_point *points = shape->points;
+  uint32_t i, c;
+
+  if (points_n == 0) {
+    return NULL;
+  }
+
+  // bounding box in axial coordinates. every point is an even number of
+  // steps from (0,0), so x - y is always even
+  int q_min = 0, q_max = 0, y_min = 0, y_max = 0;
+  for (i = 0; i < points_n; ++i) {
+    int q = (points[i].x - points[i].y) / 2;
+    int y = points[i].y;
+    q_min = (i == 0 || q < q_min) ? q : q_min;
+    q_max = (i == 0 || q > q_max) ? q : q_max;
+    y_min = (i == 0 || y < y_min) ? y : y_min;
+    y_max = (i == 0 || y > y_max) ? y : y_max;
+  }
+
+  t_stencil *stencil = (t_stencil *) calloc(1, sizeof(t_stencil));
+  if (stencil == NULL) {
+    return NULL;
+  }
+
+  uint32_t stride = (uint32_t) (q_max - q_min + 1);
+  uint32_t rows = (uint32_t) (y_max - y_min + 1);
+  uint32_t cells = rows * stride;
+
+  stencil->points_n = points_n;
+  stencil->rows = rows;
+  stencil->stride = stride;
+  stencil->plane = ALIGN_FLOATS(cells);
+  stencil->rim_off = (STENCIL_DIRS + 1) * stencil->plane;
+  stencil->rim_n = (uint32_t) shape->edge_n;
+  stencil->state_n = ALIGN_FLOATS(stencil->rim_off + stencil->rim_n);
+
+  for (int k = 0; k < STENCIL_DIRS; ++k) {
+    stencil->offset[k] = possible[k][1] * (int32_t) stride + (possible[k][0] - possible[k][1]) / 2;
+  }
+
+  // cell of every point, and the point of every cell (id + 1, zero for none)
+  uint32_t *cell_of = (uint32_t *) calloc(points_n + cells, sizeof(uint32_t));
+  if (cell_of == NULL) {
+    free(stencil);
+    return NULL;
+  }
+  uint32_t *point_at = cell_of + points_n;
+
+  for (i = 0; i < points_n; ++i) {
+    int q = (points[i].x - points[i].y) / 2;
+    cell_of[i] = (uint32_t) (points[i].y - y_min) * stride + (uint32_t) (q - q_min);
+    point_at[cell_of[i]] = i + 1;
+  }
+
+  // interior runs and irregular junctions, counted, then filled. junction 0
+  // is always irregular so its pressure comes out of the edge loop
+#define STENCIL_INTERIOR(c) (point_at[c] > 1 && !points[point_at[c] - 1].is_edge)
+
+  uint32_t run_n = 0, interior_n = 0;
+  for (c = 0; c < cells; ++c) {
+    if (STENCIL_INTERIOR(c)) {
+      interior_n++;
+      if (c % stride == 0 || !STENCIL_INTERIOR(c - 1)) {
+        run_n++;
+      }
+    }
+  }
+
+  // irregular junctions in cell order after junction 0, for locality
+  uint32_t edge_n = points_n - interior_n;
+  uint32_t *edge_of = (uint32_t *) calloc(points_n, sizeof(uint32_t));
+  uint32_t *count = (uint32_t *) calloc(edge_n + 1, sizeof(uint32_t));
+  uint32_t e = 0;
+
+  if (edge_of == NULL || count == NULL) {
+    free(edge_of);
+    free(count);
+    free(cell_of);
+    free(stencil);
+    return NULL;
+  }
+
+#define STENCIL_IRREGULAR(id) ((id) == 0 || points[id].is_edge)
+  for (c = 0; c < cells; ++c) {
+    if (point_at[c] != 0 && STENCIL_IRREGULAR(point_at[c] - 1)) {
+      uint32_t id = point_at[c] - 1;
+      edge_of[id] = id == 0 ? 0 : ++e;
+    }
+  }
+
+  // ports per irregular junction: its lines, then its rim guide
+  const t_line *lines = shape->lines;
+  for (i = 0; i < (uint32_t) shape->lines_n; ++i) {
+    if (STENCIL_IRREGULAR(lines[i].a)) count[edge_of[lines[i].a] + 1]++;
+    if (STENCIL_IRREGULAR(lines[i].b)) count[edge_of[lines[i].b] + 1]++;
+  }
+  for (i = 0; i < points_n; ++i) {
+    if (points[i].is_edge) count[edge_of[i] + 1]++;
+  }
+  for (i = 0; i < edge_n; ++i) {
+    count[i + 1] += count[i];
+  }
+  uint32_t port_n = count[edge_n];
+
+  // runs, junction tables and ports live in one allocation
+  size_t words = (size_t) run_n * 2 + edge_n * 3 + 1 + (size_t) port_n * 2;
+  stencil->run_start = (uint32_t *) calloc(words, sizeof(uint32_t));
+
+  if (stencil->run_start == NULL) {
+    free(edge_of);
+    free(count);
+    free(cell_of);
+    free_stencil(stencil);
+    return NULL;
+  }
+
+  stencil->run_n = run_n;
+  stencil->run_end = stencil->run_start + run_n;
+  stencil->interior_n = interior_n;
+  stencil->edge_n = edge_n;
+  stencil->edge_cell = stencil->run_end + run_n;
+  stencil->line_end = stencil->edge_cell + edge_n;
+  stencil->port_off = stencil->line_end + edge_n;
+  stencil->in = stencil->port_off + edge_n + 1;
+  stencil->out = stencil->in + port_n;
+  memcpy(stencil->port_off, count, (edge_n + 1) * sizeof(uint32_t));
+
+  run_n = 0;
+  for (c = 0; c < cells; ++c) {
+    if (STENCIL_INTERIOR(c)) {
+      if (c % stride == 0 || !STENCIL_INTERIOR(c - 1)) {
+        stencil->run_start[run_n++] = c;
+      }
+      stencil->run_end[run_n - 1] = c + 1;
+    }
+  }
+#undef STENCIL_INTERIOR
+
+  for (i = 0; i < points_n; ++i) {
+    if (STENCIL_IRREGULAR(i)) {
+      stencil->edge_cell[edge_of[i]] = cell_of[i];
+    }
+  }
+
+  // irregular junctions keep the mesh's port order: line ports in line
+  // order, then the rim guide
+  const uint32_t plane = stencil->plane;
+  for (i = 0; i < (uint32_t) shape->lines_n; ++i) {
+    uint32_t pa = (uint32_t) lines[i].a, pb = (uint32_t) lines[i].b;
+    int k = stencil_dir(points[pb].x - points[pa].x, points[pb].y - points[pa].y);
+    int back = (k + 3) % STENCIL_DIRS;
+
+    // a sends along k from its cell, b sends back along k + 3 from its own
+    uint32_t from_a = (uint32_t) k * plane + cell_of[pa];
+    uint32_t from_b = (uint32_t) back * plane + cell_of[pb];
+
+    if (STENCIL_IRREGULAR(pa)) {
+      uint32_t p = count[edge_of[pa]]++;
+      stencil->out[p] = from_a;
+      stencil->in[p] = from_b;
+    }
+    if (STENCIL_IRREGULAR(pb)) {
+      uint32_t p = count[edge_of[pb]]++;
+      stencil->out[p] = from_b;
+      stencil->in[p] = from_a;
+    }
+  }
+#undef STENCIL_IRREGULAR
+
+  uint32_t r = stencil->rim_off;
+  for (i = 0; i < edge_n; ++i) {
+    uint32_t id = point_at[stencil->edge_cell[i]] - 1;
+    stencil->line_end[i] = count[i];
+    if (points[id].is_edge) {
+      uint32_t p = count[i]++;
+      stencil->in[p] = r;
+      stencil->out[p] = r;
+      r++;
+    }
+  }
+
+  free(edge_of);
+  free(count);
+  free(cell_of);
+
+  float x, y;
+  mesh_strike_default(shape, &x, &y);
+  stencil_strike(stencil, shape, x, y, &stencil->strike);
+
+  return stencil;
+}
+
+void free_stencil(t_stencil *stencil)
+{
+  free(stencil->run_start);
+  free(stencil);
+}
+
+int stencil_use(const t_stencil *stencil)
+{
+  return stencil->points_n >= STENCIL_MIN_POINTS
+    && stencil->interior_n >= STENCIL_MIN_INTERIOR * stencil->points_n;
+}
+
+////////////////////////////////////////////////////////////////////
+
+size_t stencil_state_size(const t_stencil *stencil)
+{
+  size_t floats = (size_t) stencil->state_n * 2 + ALIGN_FLOATS(stencil->rim_n);
+
+  return floats * sizeof(float) + MESH_ALIGN;
+}
+
+void stencil_state_init(const t_stencil *stencil, t_stencil_state *state, void *block)
+{
+  uintptr_t base = ((uintptr_t) block + MESH_ALIGN - 1) & ~((uintptr_t) MESH_ALIGN - 1);
+
+  memset(block, 0, stencil_state_size(stencil));
+
+  state->a = (float *) base;
+  state->b = state->a + stencil->state_n;
+  state->c = state->b + stencil->state_n;
+  state->strike = &stencil->strike;
+}
+
+// the same junction pressures as mesh_state_energy(). without self loops an
+// interior junction's first line port is the one in direction 0
+float stencil_state_energy(const t_stencil *stencil, int model, const t_stencil_state *state)
+{
+  const uint32_t plane = stencil->plane;
+  const float *self_a = state->a + STENCIL_DIRS * plane;
+  const float *self_b = state->b + STENCIL_DIRS * plane;
+  float energy = 0;
+  float total;
+
+  for (uint32_t r = 0; r < stencil->run_n; ++r) {
+    for (uint32_t c = stencil->run_start[r]; c < stencil->run_end[r]; ++c) {
+      if (model & MESH_SELF_LOOP) {
+        total = self_b[c] + self_a[c];
+      }
+      else {
+        total = state->b[c] + state->a[3 * plane + c + stencil->offset[0]];
+      }
+      energy += total * total;
+    }
+  }
+
+  for (uint32_t j = 0; j < stencil->edge_n; ++j) {
+    uint32_t p = stencil->port_off[j];
+
+    if (model & MESH_SELF_LOOP) {
+      uint32_t c = stencil->edge_cell[j];
+      total = self_b[c] + self_a[c];
+    }
+    else {
+      if (p == stencil->line_end[j]) {
+        continue;
+      }
+      total = state->b[stencil->out[p]] + state->a[stencil->in[p]];
+    }
+    energy += total * total;
+  }
+  return energy;
+}
+
+// the cells of a shape's points, from the bounding box as compile_stencil()
+// lays them out. O(points): the stencil keeps no table of points
+typedef struct {
+  const t_point *points;
+  uint32_t stride;
+  int q_min;
+  int y_min;
+} t_stencil_cells;
+
+static void stencil_cells(const t_stencil *stencil, const t_shape *shape, t_stencil_cells *cells)
+{
+  const t_point *points = shape->points;
+
+  cells->points = points;
+  cells->stride = stencil->stride;
+  cells->q_min = 0;
+  cells->y_min = 0;
+  for (int i = 0; i < shape->points_n; ++i) {
+    int q = (points[i].x - points[i].y) / 2;
+    cells->q_min = (i == 0 || q < cells->q_min) ? q : cells->q_min;
+    cells->y_min = (i == 0 || points[i].y < cells->y_min) ? points[i].y : cells->y_min;
+  }
+}
+
+static uint32_t stencil_cell(const t_stencil_cells *cells, uint32_t point)
+{
+  const t_point *p = &cells->points[point];
+  int q = (p->x - p->y) / 2;
+
+  return (uint32_t) (p->y - cells->y_min) * cells->stride + (uint32_t) (q - cells->q_min);
+}
+
+// the irregular junction at cell c, edge_n if it is an interior one
+static uint32_t stencil_edge_at(const t_stencil *stencil, uint32_t c)
+{
+  uint32_t j = 0;
+
+  while (j < stencil->edge_n && stencil->edge_cell[j] != c) {
+    ++j;
+  }
+  return j;
+}
+
+int stencil_pickup(const t_stencil *stencil, const t_shape *shape, int model, uint32_t point,
+                   t_mesh_pickup *pickup)
+{
+  t_stencil_cells cells;
+  stencil_cells(stencil, shape, &cells);
+
+  const uint32_t plane = stencil->plane;
+  uint32_t c = stencil_cell(&cells, point);
+  uint32_t j = stencil_edge_at(stencil, c);
+
+  if (model & MESH_SELF_LOOP) {
+    pickup->out = STENCIL_DIRS * plane + c;
+    pickup->in = STENCIL_DIRS * plane + c;
+    return 1;
+  }
+
+  if (j < stencil->edge_n) {
+    uint32_t p = stencil->port_off[j];
+
+    if (p == stencil->line_end[j]) {
+      return 0;
+    }
+    pickup->out = stencil->out[p];
+    pickup->in = stencil->in[p];
+    return 1;
+  }
+  // interior: direction 0 out of c, and what its neighbour there sent back
+  pickup->out = c;
+  pickup->in = 3 * plane + c + stencil->offset[0];
+  return 1;
+}
+
+void stencil_strike(const t_stencil *stencil, const t_shape *shape, float x, float y,
+                    t_stencil_strike *strike)
+{
+  uint32_t points[MESH_STRIKE_MAX];
+  t_stencil_cells cells;
+  stencil_cells(stencil, shape, &cells);
+
+  strike->n = mesh_strike_points(shape, x, y, points, strike->weight);
+  strike->output = 0;
+  for (uint32_t s = 0; s < strike->n; ++s) {
+    strike->cell[s] = stencil_cell(&cells, points[s]);
+    strike->edge[s] = stencil_edge_at(stencil, strike->cell[s]);
+    if (points[s] == 0) {
+      strike->output = strike->weight[s];
+    }
+  }
+}
+
+void stencil_state_clear(const t_stencil *stencil, t_stencil_state *state)
+{
+  memset(state->a, 0, stencil->state_n * sizeof(float));
+  memset(state->b, 0, stencil->state_n * sizeof(float));
+  memset(state->c, 0, ALIGN_FLOATS(stencil->rim_n) * sizeof(float));
+}
+
+////////////////////////////////////////////////////////////////////
+
+template <int MODEL>
+static float stencil_cycle_model(const t_stencil *stencil, t_stencil_state *state,
+                                 float input, float yj, float yj_r, float loss)
+{
+  return stencil_cycle_simd<V_scalar, MODEL>(stencil, state, input, yj, yj_r, loss);
+}
+
+#ifdef MEMBRANE_SIMD
+extern const t_stencil_cycle_fn stencil_cycle_sse2[MESH_MODEL_N];
+extern const t_stencil_cycle_fn stencil_cycle_avx2[MESH_MODEL_N];
+extern const t_stencil_cycle_fn stencil_cycle_avx512[MESH_MODEL_N];
+#endif
+
+static const t_stencil_cycle_fn stencil_cycle_scalar[MESH_MODEL_N] = MESH_MODEL_TABLE(stencil_cycle_model);
+static t_stencil_cycle_fn stencil_cycle_best[MESH_MODEL_N] = MESH_MODEL_TABLE(stencil_cycle_model);
+
+t_stencil_cycle_fn stencil_kernel(int model)
+{
+  return stencil_cycle_best[(model >= 0 && model < MESH_MODEL_N) ? model : MESH_MODEL_DEFAULT];
+}
+
+t_stencil_cycle_fn stencil_kernel_isa(int kernel, int model)
+{
+  if (model < 0 || model >= MESH_MODEL_N) {
+    return NULL;
+  }
+  switch (kernel) {
+  case MESH_KERNEL_SCALAR:
+    return stencil_cycle_scalar[model];
+#ifdef MEMBRANE_SIMD
+  case MESH_KERNEL_SSE2:
+    return __builtin_cpu_supports("sse2") ? stencil_cycle_sse2[model] : NULL;
+  case MESH_KERNEL_AVX2:
+    return __builtin_cpu_supports("avx2") ? stencil_cycle_avx2[model] : NULL;
+  case MESH_KERNEL_AVX512:
+    return __builtin_cpu_supports("avx512f") ? stencil_cycle_avx512[model] : NULL;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+void stencil_select_kernel(int kernel)
+{
+  for (int model = 0; model < MESH_MODEL_N; ++model) {
+    t_stencil_cycle_fn f = stencil_kernel_isa(kernel, model);
+    stencil_cycle_best[model] = f ? f : stencil_cycle_scalar[model];
+  }
+}
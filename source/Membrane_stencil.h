@@ -0,0 +1,104 @@
+
+#ifndef Membrane_stencil_h
+#define Membrane_stencil_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Membrane_shape.h"
+#include "Membrane_mesh.h"
+
+// Structured form of a shape. Every shape lies on the hex lattice, so in
+// axial coordinates q = (x - y) / 2, r = y the six neighbours of a cell are
+// at constant offsets, and the waves a junction sends in direction k live
+// in plane k of a 2D array. An interior junction (all six neighbours
+// present) reads the wave its neighbour in direction k sent back,
+// plane (k + 3) % 6 at cell + offset[k], and needs no index tables at all.
+//
+// rim junctions and junction 0 (the pickup) keep explicit ports, in the
+// same order as the compiled mesh, and run like mesh_cycle(). interior sums
+// are taken in direction order instead, so the output agrees with
+// mesh_cycle() to within rounding, see STENCIL_TOLERANCE.
+
+#define STENCIL_DIRS 6
+#define STENCIL_TOLERANCE 1e-4f // peak-relative, against mesh_cycle()
+#define STENCIL_MIN_POINTS 2048 // below this the compiled mesh is as fast
+#define STENCIL_MIN_INTERIOR 0.75f // fraction of junctions on the stencil
+
+// a t_mesh_strike on the stencil: the cell of every struck junction, and
+// which irregular junction it is, edge_n for an interior one
+typedef struct {
+  uint32_t n;
+  uint32_t cell[MESH_STRIKE_MAX];
+  uint32_t edge[MESH_STRIKE_MAX];
+  float weight[MESH_STRIKE_MAX];
+  float output;
+} t_stencil_strike;
+
+// delay state per buffer: planes 0..5 for the six directions, plane 6 for
+// the self loops, then one delay per rim guide
+typedef struct {
+  uint32_t points_n;
+  uint32_t rows;
+  uint32_t stride;    // cells per row
+  uint32_t plane;     // floats per plane, rows * stride rounded up
+  uint32_t rim_off;   // first rim guide delay
+  uint32_t rim_n;
+  uint32_t state_n;   // floats per buffer
+  int32_t offset[STENCIL_DIRS];
+
+  // interior junctions as runs of consecutive cells in a row
+  uint32_t run_n;
+  uint32_t *run_start;
+  uint32_t *run_end;
+  uint32_t interior_n;
+
+  // the irregular junctions, junction 0 first, as in t_mesh but indexing
+  // the flat state
+  uint32_t edge_n;
+  uint32_t *edge_cell;
+  uint32_t *port_off;
+  uint32_t *line_end;
+  uint32_t *in;
+  uint32_t *out;
+
+  t_stencil_strike strike; // at the mesh's default point
+} t_stencil;
+
+typedef struct {
+  float *a;
+  float *b;
+  float *c; // rim filter memory
+  const t_stencil_strike *strike; // the stencil's own after stencil_state_init()
+} t_stencil_state;
+
+// NRT: NULL if out of memory
+t_stencil *compile_stencil(const t_shape *shape);
+void free_stencil(t_stencil *stencil);
+// whether the stencil pays off over the compiled mesh for this shape
+int stencil_use(const t_stencil *stencil);
+
+size_t stencil_state_size(const t_stencil *stencil);
+void stencil_state_init(const t_stencil *stencil, t_stencil_state *state, void *block);
+// like mesh_state_energy()
+float stencil_state_energy(const t_stencil *stencil, int model, const t_stencil_state *state);
+void stencil_state_clear(const t_stencil *stencil, t_stencil_state *state);
+// like mesh_pickup(), for shape point id of the shape the stencil was
+// compiled from. O(points): the stencil keeps no table of points
+int stencil_pickup(const t_stencil *stencil, const t_shape *shape, int model, uint32_t point,
+                   t_mesh_pickup *pickup);
+// like mesh_strike()
+void stencil_strike(const t_stencil *stencil, const t_shape *shape, float x, float y,
+                    t_stencil_strike *strike);
+
+typedef float (*t_stencil_cycle_fn)(const t_stencil *stencil, t_stencil_state *state,
+                                    float input, float yj, float yj_r, float loss);
+
+// the widest stencil kernel for a model, as picked by mesh_select_kernel().
+// unknown model ids fall back to MESH_MODEL_DEFAULT
+t_stencil_cycle_fn stencil_kernel(int model);
+// a specific one, NULL if not compiled in or not supported by the CPU
+t_stencil_cycle_fn stencil_kernel_isa(int kernel, int model);
+// called by mesh_select_kernel() with the MESH_KERNEL_* id it chose
+void stencil_select_kernel(int kernel);
+
+#endif
@@ -1,21 +1,21 @@
 
-//procedurally made 2D models of angled stone chimes, which resembles Korea's Pyeongyeong, China's Bianqing 
+//procedurally made 2D models of angled stone chimes, which resembles Korea's Pyeongyeong, China's Bianqing
 //and more angled version of Pyeongyeong.
 //by Philip Liu, 2016
 
 #include "StoneChime.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #include <cmath>
 #include <algorithm>
+#include <mutex>
+#include <unordered_map>
 
 using namespace std;
 
-t_shape* calcMesh(int meshNum, float angle, int fragNums){
-
-vector<t_shape> shapes;
-vector<t_point> pArr;
-t_point tmp;
-
-const int coords[] = {0,0,
+static const int coords[] = {0,0,
     -2,0,
     2,0,
     1,1,
@@ -24,12 +24,118 @@ const int coords[] = {0,0,
     1,-1,
 };
 
+//Manually made fragment mesh models of the first stone chime instrument
+static const int drawCoords[] = {0,-6,0,-4,0,-2,0,0,0,2,0,4,0,6,
+                   2,-6,4,-6,6,-8,4,-8,2,-8,2,-4, 2,-6,4,-4,2,2,4,0,4,2,4,4,4,6,4,-2,
+                   4,-10, 6, -10,8,-10};
+
+#define MAX_FRAG_NUMS 47
+
+// chime angles are keyed in steps of 1/CHIME_ANGLE_STEPS. buildMesh() adds
+// no rows from CHIME_ANGLE_MAX = 12 * (3 + pgHeight / 4) on, and never
+// stops adding them for angles <= 0
+#define CHIME_ANGLE_STEPS 16
+#define CHIME_ANGLE_MAX 48
+
+// custom meshes by id: the lattice points, and a generation bumped on every
+// definition and read lock-free on the audio thread to key the cache. 0 is
+// undefined
+static mutex customLock;
+static vector<t_point> customPoints[CUSTOM_MESHES];
+static atomic<int> customGeneration[CUSTOM_MESHES];
+
+
+// canonical cache key: parameters which build identical point sets map to the same key
+static t_mesh_key canonicalKey(int meshNum, float angle, int fragNums){
+    t_mesh_key key;
+
+    key.shape_type = meshNum;
+    key.angle = 0;
+    key.frag = 0;
+
+    switch(meshNum){
+    case 0:
+    case 1:
+        // circle and hexagon are both built from the first chime point only
+        key.shape_type = 0;
+        break;
+    case 2:
+        if(!(angle > 0)){
+            key.shape_type = -1;
+            break;
+        }
+        angle = min(angle, (float) CHIME_ANGLE_MAX);
+        key.angle = max(roundf(angle * CHIME_ANGLE_STEPS), 1.f) / CHIME_ANGLE_STEPS;
+        break;
+    case 3:
+        fragNums = max(0, min(fragNums, MAX_FRAG_NUMS));
+        // drawCoords is walked in (x,y) pairs, so odd counts round up
+        key.frag = (fragNums + 1) / 2;
+        break;
+    case MESH_CUSTOM:
+        key.frag = fragNums;
+        key.angle = fragNums >= 0 && fragNums < CUSTOM_MESHES
+            ? customGeneration[fragNums].load(memory_order_acquire) : 0;
+        if(key.angle == 0){
+            key.shape_type = -1;
+        }
+        break;
+    default:
+        key.shape_type = -1;
+    }
+    return key;
+}
+
+
+// NULL, with a message, if the shape cannot be built
+static t_shape* makeShape(t_point p[], int pSize){
+    t_shape *shape;
+    int error = getShape2(0, p, pSize, &shape);
+
+    if(error != SHAPE_OK){
+        printf("StoneChime: cannot build mesh (%s)\n", shape_error(error));
+    }
+    return shape;
+}
+
+static t_shape* buildMesh(t_mesh_key key){
+
+vector<t_point> pArr;
+t_point tmp;
+
 int pgHeight = 6;
-    
+float angle = key.angle;
+
+if(key.shape_type == MESH_CUSTOM){
+    {
+        lock_guard<mutex> guard(customLock);
+        // redefined since the key was made: that mesh is gone
+        if(customGeneration[key.frag].load(memory_order_relaxed) != (int) key.angle){
+            return NULL;
+        }
+        pArr = customPoints[key.frag];
+    }
+    return makeShape(pArr.data(), pArr.size());
+}
+
+if(key.shape_type == 3){
+
+    for(size_t i=0; i<sizeof(coords)/sizeof(*coords)-1; i=i+2){
+
+        for(int j=0; j<key.frag; j++){
+
+            tmp.x = coords[i]+drawCoords[j*2];
+            tmp.y = coords[i+1]+drawCoords[j*2+1];
+            pArr.push_back(tmp);
+        }
+    }
+
+    return makeShape(pArr.data(), pArr.size());
+}
 
 for(int k = -2; k<(pgHeight/2); k=k+2){
         for(int j = -pgHeight; j< pgHeight; j=j+2){
-            for(int i=0; i<sizeof(coords)/sizeof(*coords)-1; i=i+2){
+            for(size_t i=0; i<sizeof(coords)/sizeof(*coords)-1; i=i+2){
                 tmp.x = coords[i]+k;
                 tmp.y = coords[i+1]-j;
                 pArr.push_back(tmp);
@@ -37,10 +143,13 @@ for(int k = -2; k<(pgHeight/2); k=k+2){
         }
 }
 
+if(key.shape_type == 0){
+    return makeShape(pArr.data(), 1);
+}
 
 for(int k = -2; k<(pgHeight/2); k=k+2){
         for(float c = 0; c<(3-(angle/12)+(pgHeight/4)); c=c+(2/angle)){
-            for(int i=0; i<sizeof(coords)/sizeof(*coords)-1; i=i+2){
+            for(size_t i=0; i<sizeof(coords)/sizeof(*coords)-1; i=i+2){
                 tmp.x = coords[i]+2+k+(c*(angle/2));
                 tmp.y = coords[i+1]-pgHeight-c;
                 pArr.push_back(tmp);
@@ -52,44 +161,862 @@ for(int k = -2; k<(pgHeight/2); k=k+2){
         }
 }
 
+return makeShape(pArr.data(), pArr.size());
+
+}
 
 
-t_point* p = &pArr[0];
-shapes.push_back(*getShape2(0, p, 1));
-shapes.push_back(*getShape2(1, p, 1));
-shapes.push_back(*getShape2(0, p, pArr.size()));
+t_shape* calcMesh(int meshNum, float angle, int fragNums){
+    t_mesh_key key = canonicalKey(meshNum, angle, fragNums);
 
+    if(key.shape_type < 0){
+        return NULL;
+    }
+    return buildMesh(key);
+}
 
 
-pArr.clear();
+int unitParams(const char *name, int *meshNum, int *angle, int *fragNums){
+    int n;
+    char end;
 
-    
-    //Manually make fragment mesh models of the first stone chime instrument
-    
-int drawCoords[] = {0,-6,0,-4,0,-2,0,0,0,2,0,4,0,6,
-                   2,-6,4,-6,6,-8,4,-8,2,-8,2,-4, 2,-6,4,-4,2,2,4,0,4,2,4,4,4,6,4,-2,
-                   4,-10, 6, -10,8,-10};
+    *angle = 0;
+    *fragNums = 0;
+
+    if(strcmp(name, "VarMembraneCircle") == 0){
+        *meshNum = 0;
+        return 1;
+    }
+    if(strcmp(name, "VarMembraneHexagon") == 0){
+        *meshNum = 1;
+        return 1;
+    }
+    if(sscanf(name, "StoneChime%d%c", &n, &end) == 1 && n >= 0 && n < 4){
+        *meshNum = 2;
+        *angle = 2 + n * 4;
+        return 1;
+    }
+    if(sscanf(name, "SCFrag%d%c", &n, &end) == 1 && n >= 0 && n < MAX_FRAG_NUMS){
+        *meshNum = 3;
+        *fragNums = n;
+        return 1;
+    }
+    return 0;
+}
+
+int unitAt(int i, char *name, size_t size){
+    if(i < 0 || i >= 2 + 4 + MAX_FRAG_NUMS){
+        return 0;
+    }
+    if(i < 2){
+        snprintf(name, size, i == 0 ? "VarMembraneCircle" : "VarMembraneHexagon");
+    }
+    else if(i < 6){
+        snprintf(name, size, "StoneChime%d", i - 2);
+    }
+    else {
+        snprintf(name, size, "SCFrag%d", i - 6);
+    }
+    return 1;
+}
+
+int defineCustomMesh(int id, const t_point p[], int n){
+    if(id < 0 || id >= CUSTOM_MESHES || n <= 0){
+        printf("StoneChime: no custom mesh %d\n", id);
+        return 0;
+    }
+
+    // the lattice around the output at (0,0), as getShape2() walks it
+    vector<t_point> points(p, p + n);
+    for(int i = 0; i < n; ++i){
+        long long x = (long long) p[i].x - p[0].x;
+        long long y = (long long) p[i].y - p[0].y;
+        if(x < -CUSTOM_EXTENT || x > CUSTOM_EXTENT || y < -CUSTOM_EXTENT || y > CUSTOM_EXTENT){
+            printf("StoneChime: custom mesh %d: (%d, %d) is more than %d from the output\n",
+                   id, p[i].x, p[i].y, CUSTOM_EXTENT);
+            return 0;
+        }
+        points[i].x = (int) x;
+        points[i].y = (int) y;
+        if((points[i].x + points[i].y) % 2 != 0){
+            printf("StoneChime: custom mesh %d: (%d, %d) is off the lattice\n", id, p[i].x, p[i].y);
+            return 0;
+        }
+    }
+
+    t_shape *shape = makeShape(points.data(), n);
+    if(!shape){
+        return 0;
+    }
+    int points_n = shape->points_n;
+    free_shape(shape);
+
+    lock_guard<mutex> guard(customLock);
+    customPoints[id].swap(points);
+    customGeneration[id].store(customGeneration[id].load(memory_order_relaxed) + 1,
+                               memory_order_release);
+    return points_n;
+}
+
+int loadCustomPoints(int id, const char *path){
+    FILE *file = fopen(path, "r");
+    if(!file){
+        printf("StoneChime: cannot read %s\n", path);
+        return 0;
+    }
+
+    vector<t_point> points;
+    char line[256];
+    int line_n = 0;
+    int ok = 1;
+
+    while(ok && fgets(line, sizeof(line), file)){
+        char *comment = strchr(line, '#');
+        t_point point = {0, 0, 0, 0};
+        char rest;
+
+        line_n++;
+        if(comment){
+            *comment = 0;
+        }
+        int n = sscanf(line, "%d %d %c", &point.x, &point.y, &rest);
+        if(n == 2){
+            points.push_back(point);
+        }
+        else if(n != EOF){
+            printf("StoneChime: %s:%d: expected \"x y\"\n", path, line_n);
+            ok = 0;
+        }
+    }
+    fclose(file);
+
+    return ok ? defineCustomMesh(id, points.data(), points.size()) : 0;
+}
+
+int loadCustomMask(int id, const char *path){
+    FILE *file = fopen(path, "r");
+    if(!file){
+        printf("StoneChime: cannot read %s\n", path);
+        return 0;
+    }
+
+    vector<t_point> points;
+    size_t output = 0;
+    int found = 0;
+    int row = 0;
+    int c;
+    int column = 0;
+
+    while((c = fgetc(file)) != EOF){
+        if(c == '\n'){
+            row++;
+            column = 0;
+            continue;
+        }
+        if(c != ' ' && c != '.' && c != '\r' && c != '\t'){
+            t_point point = {0, 2 * column + (row & 1), row, 0};
+            if(c == 'o' && !found){
+                output = points.size();
+                found = 1;
+            }
+            points.push_back(point);
+        }
+        column++;
+    }
+    fclose(file);
+
+    if(points.empty()){
+        printf("StoneChime: %s has no cells inside the mesh\n", path);
+        return 0;
+    }
+    swap(points[0], points[output]);
+    return defineCustomMesh(id, points.data(), points.size());
+}
+
+int unitName(int meshNum, float angle, int fragNums, char *name, size_t size){
+    if(meshNum == 0 && angle == 0 && fragNums == 0){
+        snprintf(name, size, "VarMembraneCircle");
+        return 1;
+    }
+    if(meshNum == 1 && angle == 0 && fragNums == 0){
+        snprintf(name, size, "VarMembraneHexagon");
+        return 1;
+    }
+    if(meshNum == 2 && fragNums == 0 && angle >= 2 && angle <= 14 && fmodf(angle - 2, 4) == 0){
+        snprintf(name, size, "StoneChime%d", (int) (angle - 2) / 4);
+        return 1;
+    }
+    if(meshNum == 3 && angle == 0 && fragNums >= 0 && fragNums < MAX_FRAG_NUMS){
+        snprintf(name, size, "SCFrag%d", fragNums);
+        return 1;
+    }
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// process-wide topology cache, shared by every VarMembrane instance.
+// entries are reference counted; idle entries stay cached until
+// trimMeshCache() needs their room. building happens outside the lock so
+// the audio thread's tryAcquireMesh() rarely finds it taken.
+
+static mutex cacheLock;
+static vector<t_mesh_entry *> cache;
+
+// the lookup keys are all made of 32-bit fields, hashed and compared as
+// words. the audio thread finds an entry in one probe and never allocates
+template <typename T>
+struct t_key_hash {
+    size_t operator()(const T &key) const {
+        static_assert(sizeof(T) % sizeof(uint32_t) == 0, "key with padding");
+        uint32_t words[sizeof(T) / sizeof(uint32_t)];
+        uint64_t h = 14695981039346656037ull;
+
+        memcpy(words, &key, sizeof(words));
+        for(size_t i = 0; i < sizeof(T) / sizeof(uint32_t); ++i){
+            h = (h ^ words[i]) * 1099511628211ull;
+        }
+        return (size_t) h;
+    }
+};
+
+template <typename T>
+struct t_key_equal {
+    bool operator()(const T &a, const T &b) const {
+        return memcmp(&a, &b, sizeof(T)) == 0;
+    }
+};
+
+template <typename K, typename V>
+using t_key_map = unordered_map<K, V, t_key_hash<K>, t_key_equal<K> >;
+
+// cache by entry key, kept in step with it
+static t_key_map<t_mesh_key, t_mesh_entry *> cacheIndex;
+
+// stamps entries as they are released, for trimMeshCache()
+static atomic<uint64_t> cacheClock;
+
+// the last release decides when an entry went idle. the stamp goes first:
+// once refs is 0 the NRT thread may free the entry
+template <typename T>
+static int releaseEntry(T *entry){
+    entry->used.store(++cacheClock, memory_order_relaxed);
+    return --entry->refs == 0;
+}
+
+// heap bytes of what the compile functions allocate
+static size_t meshBytes(const t_shape *shape, const t_mesh *mesh, const t_stencil *stencil){
+    size_t bytes = sizeof(t_shape) + shape->points_max * sizeof(t_point)
+        + shape->lines_max * sizeof(t_line);
+
+    bytes += sizeof(t_mesh) + ((size_t) mesh->points_n * 3 + 1 + (size_t) mesh->port_n * 2
+                               + ((size_t) mesh->points_pad * MESH_MAX_PORTS * 2 + mesh->points_pad) * 2
+                               + ((size_t) mesh->tile_n + 1) * 2 + (size_t) mesh->points_n * 2)
+        * sizeof(uint32_t);
+    if(stencil){
+        bytes += sizeof(t_stencil) + ((size_t) stencil->run_n * 2 + (size_t) stencil->edge_n * 3 + 1
+                                      + (size_t) stencil->port_off[stencil->edge_n] * 2)
+            * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+static size_t modalBytes(const t_modal *modal){
+    return sizeof(t_modal) + (size_t) modal->modes_n * 7 * sizeof(float);
+}
+
+static size_t convBytes(const t_conv *conv){
+    size_t floats = conv->fft_max;
+
+    for(uint32_t l = 0; l < conv->levels_n; ++l){
+        floats += (size_t) conv->level[l].parts * (conv->level[l].size + 1) * 2;
+    }
+    return sizeof(t_conv) + floats * sizeof(float);
+}
+
+// keys whose points turned out identical to an earlier key's, to the key
+// they share an entry under. many chime angles build the same lattice, so
+// a sweep over them builds each topology once. kept across purges: it
+// stays true, and the entry is rebuilt under the key it leads to. entries
+// are only ever made under keys that are no alias, and addAlias() points
+// every alias straight at such a key, so one lookup resolves any key
+static t_key_map<t_mesh_key, t_mesh_key> aliases;
+
+static bool sameKey(const t_mesh_key &a, const t_mesh_key &b){
+    return a.shape_type == b.shape_type && a.angle == b.angle && a.frag == b.frag;
+}
+
+static t_mesh_key topologyKey(const t_mesh_key &key){
+    auto alias = aliases.find(key);
+
+    return alias == aliases.end() ? key : alias->second;
+}
+
+// NRT only. target may itself have been led to before a purge: those
+// aliases now lead on to it
+static void addAlias(const t_mesh_key &key, const t_mesh_key &target){
+    for(auto &alias : aliases){
+        if(sameKey(alias.second, key)){
+            alias.second = target;
+        }
+    }
+    aliases[key] = target;
+}
+
+static t_mesh_entry* findEntry(const t_mesh_key &key){
+    auto entry = cacheIndex.find(topologyKey(key));
+
+    return entry == cacheIndex.end() ? NULL : entry->second;
+}
+
+static void addEntry(t_mesh_entry *entry){
+    cache.push_back(entry);
+    cacheIndex[entry->key] = entry;
+}
+
+static bool samePoints(const t_shape *a, const t_shape *b){
+    if(a->points_n != b->points_n){
+        return false;
+    }
+    for(int i = 0; i < a->points_n; ++i){
+        if(a->points[i].x != b->points[i].x || a->points[i].y != b->points[i].y){
+            return false;
+        }
+    }
+    return true;
+}
+
+// a cached entry built from the same points in the same order, making key
+// an alias of it
+static t_mesh_entry* findTopology(const t_mesh_key &key, const t_shape *shape){
+    for(size_t i = 0; i < cache.size(); ++i){
+        if(samePoints(cache[i]->shape, shape)){
+            addAlias(key, cache[i]->key);
+            return cache[i];
+        }
+    }
+    return NULL;
+}
+
+t_mesh_entry* acquireMesh(int meshNum, float angle, int fragNums){
+    t_mesh_key key = canonicalKey(meshNum, angle, fragNums);
+    t_mesh_entry *entry;
+
+    if(key.shape_type < 0){
+        return NULL;
+    }
 
-if(fragNums > 47){
-    fragNums = 47;
+    {
+        lock_guard<mutex> guard(cacheLock);
+        key = topologyKey(key);
+        entry = findEntry(key);
+        if(entry){
+            entry->refs++;
+            return entry;
+        }
+    }
+
+    t_shape *shape = buildMesh(key);
+    if(!shape){
+        return NULL;
+    }
+    t_mesh *mesh = compile_mesh(shape, MESH_ORDER_DEFAULT);
+    if(!mesh){
+        printf("StoneChime: cannot build mesh (%s)\n", shape_error(SHAPE_ERR_MEMORY));
+        free_shape(shape);
+        return NULL;
+    }
+    // the stencil is only ever a faster way to run the mesh
+    t_stencil *stencil = compile_stencil(shape);
+    if(stencil && !stencil_use(stencil)){
+        free_stencil(stencil);
+        stencil = NULL;
+    }
+
+    lock_guard<mutex> guard(cacheLock);
+
+    // somebody else may have finished the same mesh in the meantime
+    entry = findEntry(key);
+    if(!entry){
+        entry = findTopology(key, shape);
+    }
+    if(entry){
+        if(stencil){
+            free_stencil(stencil);
+        }
+        free_mesh(mesh);
+        free_shape(shape);
+        entry->refs++;
+        return entry;
+    }
+
+    entry = new t_mesh_entry;
+    entry->key = key;
+    entry->refs = 1;
+    entry->shape = shape;
+    entry->mesh = mesh;
+    entry->stencil = stencil;
+    entry->bytes = meshBytes(shape, mesh, stencil);
+    entry->used = 0;
+    addEntry(entry);
+
+    return entry;
+}
+
+t_mesh_entry* tryAcquireMesh(int meshNum, float angle, int fragNums){
+    t_mesh_key key = canonicalKey(meshNum, angle, fragNums);
+    t_mesh_entry *entry;
+
+    if(key.shape_type < 0){
+        return NULL;
+    }
+
+    unique_lock<mutex> guard(cacheLock, try_to_lock);
+    if(!guard.owns_lock()){
+        return NULL;
+    }
+
+    entry = findEntry(key);
+    if(entry){
+        entry->refs++;
+    }
+    return entry;
+}
+
+int releaseMesh(t_mesh_entry *entry){
+    return releaseEntry(entry);
+}
+
+
+////////////////////////////////////////////////////////////////////
+
+// decomposed meshes, cached next to the meshes under the same lock. one
+// per topology and model: a unit at another tension or loss retunes them
+
+static vector<t_modal_entry *> modalCache;
+
+typedef struct {
+  t_mesh_key key;
+  int model;
+} t_modal_key;
+
+static t_key_map<t_modal_key, t_modal_entry *> modalIndex;
+
+static t_modal_key modalKey(const t_mesh_key &topology, int model){
+    t_modal_key key;
+
+    key.key = topology;
+    key.model = model;
+    return key;
+}
+
+static t_modal_entry* findModal(const t_mesh_key &key, int model){
+    auto entry = modalIndex.find(modalKey(topologyKey(key), model));
+
+    return entry == modalIndex.end() ? NULL : entry->second;
+}
+
+t_modal_entry* acquireModal(int meshNum, float angle, int fragNums, int model){
+    t_mesh_key key = canonicalKey(meshNum, angle, fragNums);
+    t_modal_entry *entry;
+
+    if(key.shape_type < 0){
+        return NULL;
+    }
+
+    {
+        lock_guard<mutex> guard(cacheLock);
+        entry = findModal(key, model);
+        if(entry){
+            entry->refs++;
+            return entry;
+        }
+    }
+
+    t_mesh_entry *mesh = acquireMesh(meshNum, angle, fragNums);
+    if(!mesh){
+        return NULL;
+    }
+    t_modal *modal = compute_modal(mesh->mesh, model, mesh_admittance(MODAL_TENSION),
+                                   mesh_loss(MODAL_LOSS));
+
+    if(!modal){
+        releaseMesh(mesh);
+        return NULL;
+    }
+
+    lock_guard<mutex> guard(cacheLock);
+
+    entry = findModal(key, model);
+    if(entry){
+        free_modal(modal);
+        releaseMesh(mesh);
+        entry->refs++;
+        return entry;
+    }
+
+    entry = new t_modal_entry;
+    entry->mesh = mesh;
+    entry->model = model;
+    entry->refs = 1;
+    entry->modal = modal;
+    entry->bytes = modalBytes(modal);
+    entry->used = 0;
+    modalCache.push_back(entry);
+    modalIndex[modalKey(mesh->key, model)] = entry;
+
+    return entry;
+}
+
+t_modal_entry* tryAcquireModal(int meshNum, float angle, int fragNums, int model){
+    t_mesh_key key = canonicalKey(meshNum, angle, fragNums);
+    t_modal_entry *entry;
+
+    if(key.shape_type < 0){
+        return NULL;
+    }
+
+    unique_lock<mutex> guard(cacheLock, try_to_lock);
+    if(!guard.owns_lock()){
+        return NULL;
+    }
+
+    entry = findModal(key, model);
+    if(entry){
+        entry->refs++;
+    }
+    return entry;
 }
 
-for(int i=0; i<sizeof(coords)/sizeof(*coords)-1; i=i+2){
+int releaseModal(t_modal_entry *entry){
+    return releaseEntry(entry);
+}
+
+
+////////////////////////////////////////////////////////////////////
 
-    for(int j=0; j<fragNums; j=j+2){
+// rendered impulse responses, under the same lock. they do not need their
+// mesh once rendered, so they keep no reference on it
 
-        tmp.x = coords[i]+drawCoords[j];
-        tmp.y = coords[i+1]+drawCoords[j+1];
-        pArr.push_back(tmp);
+static vector<t_conv_entry *> convCache;
+
+// the response a unit asking for yj, loss and length gets, see t_conv_entry
+static float convStep(float x){
+    return exp2f(roundf(log2f(x) * CONV_STEPS) / CONV_STEPS);
+}
+
+static void convParams(float *yj, float *loss, uint32_t *length){
+    *yj = convStep(*yj);
+    if(*loss < 1.f){
+        *loss = 1.f - convStep(1.f - *loss);
     }
+    *length = (*length + CONV_LENGTH_STEP - 1) / CONV_LENGTH_STEP * CONV_LENGTH_STEP;
 }
 
-p = &pArr[0];
+typedef struct {
+  t_mesh_key key;
+  int model;
+  float yj;
+  float loss;
+  uint32_t length;
+} t_conv_key;
 
-shapes.push_back(*getShape2(0, p, pArr.size()));
+static t_key_map<t_conv_key, t_conv_entry *> convIndex;
 
+static t_conv_key convKey(const t_mesh_key &topology, int model, float yj, float loss, uint32_t length){
+    t_conv_key key;
+
+    key.key = topology;
+    key.model = model;
+    key.yj = yj;
+    key.loss = loss;
+    key.length = length;
+    return key;
+}
 
-    
-    return &shapes[meshNum];
+static t_conv_entry* findConv(const t_mesh_key &key, int model, float yj, float loss, uint32_t length){
+    auto entry = convIndex.find(convKey(topologyKey(key), model, yj, loss, length));
 
+    return entry == convIndex.end() ? NULL : entry->second;
+}
+
+t_conv_entry* acquireConv(int meshNum, float angle, int fragNums, int model, float yj, float loss,
+                          uint32_t length){
+    t_mesh_key key = canonicalKey(meshNum, angle, fragNums);
+    t_conv_entry *entry;
+
+    if(key.shape_type < 0 || length == 0){
+        return NULL;
+    }
+    convParams(&yj, &loss, &length);
+
+    {
+        lock_guard<mutex> guard(cacheLock);
+        entry = findConv(key, model, yj, loss, length);
+        if(entry){
+            entry->refs++;
+            return entry;
+        }
+    }
+
+    t_mesh_entry *mesh = acquireMesh(meshNum, angle, fragNums);
+    if(!mesh){
+        return NULL;
+    }
+
+    float *ir = (float *) malloc(length * sizeof(float));
+    if(!ir){
+        releaseMesh(mesh);
+        return NULL;
+    }
+    uint32_t used = conv_render(mesh->mesh, model, yj, loss, ir, length);
+    t_mesh_key topology = mesh->key;
+    releaseMesh(mesh);
+
+    t_conv *conv = used > 0 ? compile_conv(ir, used) : NULL;
+    free(ir);
+    if(!conv){
+        return NULL;
+    }
+
+    lock_guard<mutex> guard(cacheLock);
+
+    entry = findConv(key, model, yj, loss, length);
+    if(entry){
+        free_conv(conv);
+        entry->refs++;
+        return entry;
+    }
+
+    entry = new t_conv_entry;
+    entry->key = topology;
+    entry->model = model;
+    entry->yj = yj;
+    entry->loss = loss;
+    entry->length = length;
+    entry->refs = 1;
+    entry->conv = conv;
+    entry->bytes = convBytes(conv);
+    entry->used = 0;
+    convCache.push_back(entry);
+    convIndex[convKey(topology, model, yj, loss, length)] = entry;
+
+    return entry;
+}
+
+t_conv_entry* tryAcquireConv(int meshNum, float angle, int fragNums, int model, float yj, float loss,
+                             uint32_t length){
+    t_mesh_key key = canonicalKey(meshNum, angle, fragNums);
+    t_conv_entry *entry;
+
+    if(key.shape_type < 0){
+        return NULL;
+    }
+    convParams(&yj, &loss, &length);
+
+    unique_lock<mutex> guard(cacheLock, try_to_lock);
+    if(!guard.owns_lock()){
+        return NULL;
+    }
+
+    entry = findConv(key, model, yj, loss, length);
+    if(entry){
+        entry->refs++;
+    }
+    return entry;
+}
+
+int releaseConv(t_conv_entry *entry){
+    return releaseEntry(entry);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// precompiled meshes, mapped from a file and never freed
+
+static vector<t_meshfile *> meshFiles;
+
+int loadMeshFile(const char *path){
+    t_meshfile *file = meshfile_open(path);
+    int loaded = 0;
+
+    if(!file){
+        return 0;
+    }
+
+    lock_guard<mutex> guard(cacheLock);
+    meshFiles.push_back(file);
+
+    for(uint32_t i = 0; i < meshfile_count(file); ++i){
+        const t_meshfile_item *item = meshfile_item(file, i);
+        t_mesh_key key;
+
+        key.shape_type = item->shape_type;
+        key.angle = item->angle;
+        key.frag = item->frag;
+        if(findEntry(key) || findTopology(key, item->shape)){
+            continue;
+        }
+
+        // the file's reference keeps the entry out of purgeMeshCache()
+        t_mesh_entry *entry = new t_mesh_entry;
+        entry->key = key;
+        entry->refs = 1;
+        entry->shape = item->shape;
+        entry->mesh = item->mesh;
+        entry->stencil = item->stencil;
+        entry->bytes = 0;
+        entry->used = 0;
+        addEntry(entry);
+        loaded++;
+    }
+    return loaded;
+}
+
+int writeMeshFile(const char *path){
+    vector<t_mesh_entry *> entries;
+    vector<t_mesh_key> keys;
+    vector<t_meshfile_item> items;
+    char name[32];
+
+    for(int u = 0; unitAt(u, name, sizeof(name)); ++u){
+        int meshNum, angle, fragNums;
+
+        unitParams(name, &meshNum, &angle, &fragNums);
+
+        // units sharing a canonical key share one item
+        t_mesh_key key = canonicalKey(meshNum, angle, fragNums);
+        bool written = false;
+        for(size_t i = 0; i < keys.size(); ++i){
+            if(sameKey(keys[i], key)){
+                written = true;
+            }
+        }
+        if(written){
+            continue;
+        }
+
+        // keys sharing an entry each get an item, the file stores it once
+        t_mesh_entry *entry = acquireMesh(meshNum, angle, fragNums);
+        if(!entry){
+            continue;
+        }
+        entries.push_back(entry);
+
+        t_meshfile_item item;
+        item.shape_type = key.shape_type;
+        item.angle = key.angle;
+        item.frag = key.frag;
+        item.shape = entry->shape;
+        item.mesh = entry->mesh;
+        item.stencil = entry->stencil;
+        items.push_back(item);
+        keys.push_back(key);
+    }
+
+    int ok = meshfile_write(path, items.data(), items.size());
+
+    for(size_t i = 0; i < entries.size(); ++i){
+        releaseMesh(entries[i]);
+    }
+    return ok ? (int) items.size() : 0;
+}
+
+// the idle bytes of the three caches, and where the least recently
+// released idle entry is: cache c, index i
+static size_t idleBytes(int *c, size_t *i){
+    size_t bytes = 0;
+    uint64_t oldest = UINT64_MAX;
+
+    for(size_t k = 0; k < convCache.size(); ++k){
+        if(convCache[k]->refs <= 0){
+            bytes += convCache[k]->bytes;
+            if(convCache[k]->used < oldest){
+                oldest = convCache[k]->used;
+                *c = 0;
+                *i = k;
+            }
+        }
+    }
+    for(size_t k = 0; k < modalCache.size(); ++k){
+        if(modalCache[k]->refs <= 0){
+            bytes += modalCache[k]->bytes;
+            if(modalCache[k]->used < oldest){
+                oldest = modalCache[k]->used;
+                *c = 1;
+                *i = k;
+            }
+        }
+    }
+    for(size_t k = 0; k < cache.size(); ++k){
+        if(cache[k]->refs <= 0){
+            bytes += cache[k]->bytes;
+            if(cache[k]->used < oldest){
+                oldest = cache[k]->used;
+                *c = 2;
+                *i = k;
+            }
+        }
+    }
+    return bytes;
+}
+
+int trimMeshCache(size_t budget){
+    lock_guard<mutex> guard(cacheLock);
+    int freed = 0;
+    int c;
+    size_t i;
+
+    while(idleBytes(&c, &i) > budget){
+        if(c == 0){
+            convIndex.erase(convKey(convCache[i]->key, convCache[i]->model, convCache[i]->yj,
+                                    convCache[i]->loss, convCache[i]->length));
+            free_conv(convCache[i]->conv);
+            delete convCache[i];
+            convCache.erase(convCache.begin() + i);
+        }
+        else if(c == 1){
+            modalIndex.erase(modalKey(modalCache[i]->mesh->key, modalCache[i]->model));
+            // the mesh it held may go idle in turn
+            releaseEntry(modalCache[i]->mesh);
+            free_modal(modalCache[i]->modal);
+            delete modalCache[i];
+            modalCache.erase(modalCache.begin() + i);
+        }
+        else {
+            cacheIndex.erase(cache[i]->key);
+            if(cache[i]->stencil){
+                free_stencil(cache[i]->stencil);
+            }
+            free_mesh(cache[i]->mesh);
+            free_shape(cache[i]->shape);
+            delete cache[i];
+            cache.erase(cache.begin() + i);
+        }
+        freed++;
+    }
+    return freed;
+}
+
+int purgeMeshCache(){
+    return trimMeshCache(0);
+}
+
+size_t meshCacheBytes(size_t *idle){
+    lock_guard<mutex> guard(cacheLock);
+    size_t bytes = 0;
+    int c;
+    size_t i;
+
+    for(size_t k = 0; k < convCache.size(); ++k){
+        bytes += convCache[k]->bytes;
+    }
+    for(size_t k = 0; k < modalCache.size(); ++k){
+        bytes += modalCache[k]->bytes;
+    }
+    for(size_t k = 0; k < cache.size(); ++k){
+        bytes += cache[k]->bytes;
+    }
+    *idle = idleBytes(&c, &i);
+    return bytes;
 }
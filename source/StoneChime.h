@@ -1,14 +1,154 @@
 
+
 #ifndef StoneChime_h
 #define StoneChime_h
 
 
 #include <iostream>
 #include <vector>
+#include <atomic>
 #include "Membrane_shape.h"
+#include "Membrane_mesh.h"
+#include "Membrane_modal.h"
+#include "Membrane_stencil.h"
+#include "Membrane_kmesh.h"
+#include "Membrane_conv.h"
+#include "Membrane_profile.h"
+#include "Membrane_meshfile.h"
+
 
+// parameters after canonicalization, see canonicalKey()
+typedef struct {
+  int shape_type;
+  float angle;
+  int frag;
+} t_mesh_key;
 
+// builds a fresh shape, owned by the caller (free with free_shape); NULL if
+// it cannot be built
 t_shape* calcMesh(int meshNum, float angle, int fragNums);
 
+// user defined meshes: meshNum MESH_CUSTOM with the id as fragNums, for
+// ids below CUSTOM_MESHES. an id that was never defined builds nothing
+#define MESH_CUSTOM 4
+#define CUSTOM_MESHES 1024
+
+// NRT: makes id the lattice points p[] (see getShape2()), p[0] being the
+// output junction and every other point within CUSTOM_EXTENT of it in x and
+// y. redefining an id leaves running units on the old mesh and builds the
+// new one for anything acquired afterwards. returns the number of points
+// connected to p[0], 0 if the mesh cannot be built
+#define CUSTOM_EXTENT 1024 // lattice units, well past any playable mesh
+int defineCustomMesh(int id, const t_point p[], int n);
+// NRT: defineCustomMesh() from a file, 0 with a message on stdout if it
+// cannot be read. point lists have one "x y" pair per line, on the hex
+// lattice (x + y even), # starting a comment; the first point is the
+// output. masks are text, one lattice row per line, odd rows offset half
+// a cell to the right: ' ' and '.' are outside the mesh, anything else
+// inside, 'o' the output (else the first cell inside)
+int loadCustomPoints(int id, const char *path);
+int loadCustomMask(int id, const char *path);
+
+// the VarMembrane_init() arguments of a registered UGen by name
+// (VarMembraneCircle, VarMembraneHexagon, StoneChime0-3, SCFrag0-46);
+// 0 if there is no such unit
+int unitParams(const char *name, int *meshNum, int *angle, int *fragNums);
+// and back: the name of the UGen built from these arguments into name, 0 if
+// none is. a t_profile_name_fn
+int unitName(int meshNum, float angle, int fragNums, char *name, size_t size);
+// the name of the i-th of them, in PluginLoad() order; 0 past the last
+int unitAt(int i, char *name, size_t size);
+
+// a shared, immutable shape and its compiled mesh in the process-wide cache
+typedef struct {
+  t_mesh_key key;
+  std::atomic<int> refs;
+  t_shape *shape;
+  t_mesh *mesh;
+  t_stencil *stencil; // the same mesh as a structured stencil, NULL unless stencil_use()
+  size_t bytes; // held on the heap, 0 for meshes mapped from a file
+  std::atomic<uint64_t> used; // when it was last released, see trimMeshCache()
+} t_mesh_entry;
+
+// may build the mesh, so never call this on the audio thread. NULL if the
+// shape cannot be built or memory runs out
+t_mesh_entry* acquireMesh(int meshNum, float angle, int fragNums);
+// audio thread safe: only returns already built meshes and never blocks
+t_mesh_entry* tryAcquireMesh(int meshNum, float angle, int fragNums);
+// audio thread safe. 1 when that was the last reference: the entry is
+// then idle, and freed by the next trimMeshCache() that needs the room
+int releaseMesh(t_mesh_entry *entry);
+
+// idle meshes, modes and responses the plug-in keeps for the next unit
+// that asks for them; past this it trims the least recently used
+#define MESH_CACHE_IDLE_BYTES (64 << 20)
+
+// NRT: frees idle entries, least recently released first, until the idle
+// ones hold at most budget bytes. returns how many were freed
+int trimMeshCache(size_t budget);
+// NRT: trimMeshCache(0)
+int purgeMeshCache();
+// bytes held by every cached entry, and by the idle ones into *idle
+size_t meshCacheBytes(size_t *idle);
+
+// NRT, at load time: maps a mesh file (Membrane_meshfile.h) and puts its
+// meshes in the cache for the life of the process, so they are never
+// built or purged. returns how many, 0 if the file is missing or unusable
+int loadMeshFile(const char *path);
+// NRT: builds the meshes of every registered UGen and writes them to path;
+// how many, 0 if it cannot be written
+int writeMeshFile(const char *path);
+
+// the modes of a cached mesh model, decomposed once at MODAL_TENSION and
+// MODAL_LOSS; modal_retune() moves them to whatever a unit plays at
+#define MODAL_TENSION 0.05f // the default tension and loss of the UGens
+#define MODAL_LOSS 0.99999f
+
+typedef struct {
+  t_mesh_entry *mesh; // holds a reference
+  int model;
+  std::atomic<int> refs;
+  t_modal *modal;
+  size_t bytes;
+  std::atomic<uint64_t> used;
+} t_modal_entry;
+
+// may decompose the mesh (seconds for the big meshes), never on the audio
+// thread. NULL if the decomposition fails
+t_modal_entry* acquireModal(int meshNum, float angle, int fragNums, int model);
+// audio thread safe: only returns already decomposed meshes and never blocks
+t_modal_entry* tryAcquireModal(int meshNum, float angle, int fragNums, int model);
+// audio thread safe, like releaseMesh()
+int releaseModal(t_modal_entry *entry);
+
+// the impulse response of a cached mesh model at one admittance and loss,
+// at most length samples, ready for convolution. units that ask for nearly
+// the same response share one: yj and 1 - loss are rounded to
+// CONV_STEPS per octave and length up to a multiple of CONV_LENGTH_STEP
+#define CONV_STEPS 96           // 1/8 semitone of yj
+#define CONV_LENGTH_STEP 4096   // samples
+#define CONV_MAX_SECONDS 8.f    // longest response a unit may ask for
+typedef struct {
+  t_mesh_key key;
+  int model;
+  float yj;
+  float loss;
+  uint32_t length;
+  std::atomic<int> refs;
+  t_conv *conv;
+  size_t bytes;
+  std::atomic<uint64_t> used;
+} t_conv_entry;
+
+// may render the response (a second of audio costs as much as a second of
+// the mesh), never on the audio thread. NULL if out of memory
+t_conv_entry* acquireConv(int meshNum, float angle, int fragNums, int model, float yj, float loss,
+                          uint32_t length);
+// audio thread safe: only returns already rendered responses and never blocks
+t_conv_entry* tryAcquireConv(int meshNum, float angle, int fragNums, int model, float yj, float loss,
+                             uint32_t length);
+// audio thread safe, like releaseMesh()
+int releaseConv(t_conv_entry *entry);
+
 
 #endif
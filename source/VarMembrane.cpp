@@ -5,43 +5,14 @@
 #include <string.h>
 #include "SC_PlugIn.h"
 #include "assert.h"
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
 
 #include "StoneChime.h"
 
-// twiddle-ables
+// twiddle-ables (the mesh model ones live in Membrane_mesh.h)
 #define SHAPE_SZ 16 // diameter
-//#define FEEDFORWARD
-#define SELF_LOOP        // for control over tension
-#define RIMGUIDES // extra self-loops around edge, which invert signal //엣지 룹
-#define RIMFILTER
-#define AUDIO_INPUT
-#define TRIGGER_DURATION 1024 /* number of samples worth of white noise to inject */
-
-// some constants from Brook Eaton's roto-drum
-// http://www-ccrma.stanford.edu/~be/drum/drum.htm
-
-#define DELTA 6.0f // distance between junctions
-#define GAMMA 8.0f // wave speed
-
-// A unit delay
-typedef struct {
-  float a;
-  float b;
-  float c;
-  int invert; // whether signal should be inverted
-} t_delay;
-
-// a scatter junction with up to 6 input and output delays, plus a
-// self loop
-typedef struct {
-  int ins, outs;
-
-  t_delay *in[6];
-  t_delay *out[6];
-#ifdef SELF_LOOP
-  t_delay *self_loop;
-#endif
-} t_junction;
 
 
 // supercollider stuff starts here...
@@ -49,264 +20,1399 @@ typedef struct {
 // InterfaceTable contains pointers to functions in the host (server).
 static InterfaceTable *ft;
 
+struct VarMembraneCmd;
+struct VarMembranePlaceCmd;
+
+// exactly one of entry, modal and conv is set, depending on what was
+// requested; none if it could not be built
+typedef void (*VarMembraneAttachFunc)(Unit *unit, t_mesh_entry *entry, t_modal_entry *modal,
+                                      t_conv_entry *conv);
+
+// what a VarMembraneCmd builds
+enum {
+  WANT_MESH,
+  WANT_MODAL, // decompose model
+  WANT_CONV   // render model at yj and loss for length samples
+};
+
+// in-flight asynchronous mesh build, see VarMembrane_request()
+struct VarMembraneCmd {
+  Unit *unit; // cleared by the Dtor if the unit goes away first
+  VarMembraneCmd **pending; // the unit's own pointer to this command
+  VarMembraneAttachFunc attach;
+  t_mesh_entry *entry;
+  t_modal_entry *modal;
+  t_conv_entry *conv;
+  int shape_type;
+  float angle;
+  int fragNums;
+  int want;
+  int model;
+  float yj;
+  float loss;
+  uint32_t length;
+};
+
+// the excitation that arrives while the mesh is built: the first
+// MESH_TRIGGER_DURATION samples of audio from the first sound on, played
+// into the mesh once it is attached instead of being lost
+struct VarMembraneLatch {
+  int seen;   // any excitation, trigger or sound
+  float *buf; // RTAlloc'd at the first sound, a block longer for the replay
+  int n;      // samples latched
+  int pos;    // samples replayed
+};
+
 // declare struct to hold unit generator state
 struct VarMembrane : public Unit
 {
   float yj; // junction admittence 교차로 입장, calculated from tension parameter 
-#ifndef AUDIO_INPUT
+  float yj_r;
+  float tension_in; // the inputs yj and loss were last derived from
+  float loss_in;
   int triggered; // flag
   int excite;    // number of samples left in a triggered excitation
-#endif
-  t_shape *shape;
-  t_junction *junctions;
-  t_delay *delays;
+  UnitCalcFunc run; // the rate-specialised calc function, see VarMembrane_init()
+  t_mesh_entry *entry;
+  VarMembraneCmd *pending; // non-null while the mesh is built on the NRT thread
+  const t_mesh *mesh;
+  t_mesh_state state;
+  const t_stencil *stencil; // runs instead of mesh when the entry has one
+  t_stencil_state stencil_state;
+  t_stencil_cycle_fn stencil_cycle;
+  void *state_block; // single RTAlloc holding all delay state
   float loss;
-  int delay_n;   // number of delays in mesh including self loops etc
+  int done_action; // fired whenever an excited mesh decays into silence
+  int model; // MESH_MODEL_* id, fixed at init
+  const t_mesh_kernels *kernels; // the selected kernels for model
+  t_profile *profile; // runtime counters, NULL when the profile table is full
+  int pickup_n; // outputs after the first, see VarMembrane_pickup()
+  t_mesh_pickup *pickups; // at the start of state_block
+  int strike_in; // the strike point's x input, 0 to strike where the mesh does
+  int pickup_in; // the first pickup's x input
+  float strike_x; // the point strike or stencil_strike was last placed at
+  float strike_y;
+  VarMembranePlaceCmd *placing; // non-null while the NRT thread places them
+  int placed; // the first placement is back
+  t_mesh_strike strike;
+  t_stencil_strike stencil_strike;
+  VarMembraneLatch latch;
+};
+
+// the inputs every unit above has: excitation, tension, loss, doneAction
+// and model. VarMembraneCustom adds the id, VarMembraneShape the shape
+// type, angle and fragNums; an optional strike pair and the pickup pairs
+// follow a unit's own inputs
+#define MESH_INPUTS 5
+#define CUSTOM_INPUTS (MESH_INPUTS + 1)
+#define SHAPE_INPUTS (MESH_INPUTS + 3)
+
+// a lane's excitation: an audio signal, latched while the mesh is built,
+// or anything slower, read once a block
+struct VarMembraneLane {
+  int audio;
+  VarMembraneLatch latch;
+};
+
+// several voices of one mesh, interleaved so one pass updates them all.
+// inputs: shape type, angle, fragNums, model, then excitation, tension and
+// loss per lane; one output per lane
+struct VarMembraneLanes : public Unit
+{
+  int lanes;
+  VarMembraneLane *lane; // RTAlloc'd, one per lane
+  t_mesh_lanes_fn cycle;
+  t_mesh_entry *entry;
+  VarMembraneCmd *pending;
+  const t_mesh *mesh;
+  t_mesh_lanes state;
+  void *state_block; // lane state followed by the per-lane arrays below
+  float *input;
+  float *yj;
+  float *yj_r;
+  float *loss;
+  float *result;
+};
+
+#define LANES_FIRST_INPUT 4
+#define LANES_INPUTS 3 // excitation, tension, loss
+
+// the mesh as a bank of resonators, see Membrane_modal.h.
+// inputs: excitation, tension, loss, then shape type, angle, fragNums, the
+// maximum number of modes (0 for all), the amplitude threshold relative
+// to the strongest mode and the model. the modes are computed once per
+// mesh and model, see MODAL_TENSION, and retuned to the tension and loss
+struct VarMembraneModal : public Unit
+{
+  float tension;
+  float loss;
+  int max_modes;
+  float threshold;
+  t_modal_entry *entry;
+  VarMembraneCmd *pending;
+  t_modal_state state;
+  void *state_block;
+  VarMembraneLatch latch;
+};
+
+// the mesh as its impulse response, see Membrane_conv.h. inputs as
+// VarMembraneModal up to fragNums, then the length of the response in
+// seconds and the model. tension and loss are read at init only: every
+// unit with the same settings shares one rendered response
+struct VarMembraneConv : public Unit
+{
+  t_conv_entry *entry;
+  VarMembraneCmd *pending;
+  t_conv_state state;
+  void *state_block;
+  uint32_t silent; // samples of silent input since the last excitation
+  int done_action; // when the response has run out
+  VarMembraneLatch latch;
 };
 
 // declare unit generator functions
 extern "C"
 {
-  void VarMembrane_next_a(VarMembrane *unit, int inNumSamples);
+  void VarMembrane_next_ai(VarMembrane *unit, int inNumSamples);
+  void VarMembrane_next_ak(VarMembrane *unit, int inNumSamples);
+  void VarMembrane_next_aa(VarMembrane *unit, int inNumSamples);
+  void VarMembrane_next_ki(VarMembrane *unit, int inNumSamples);
+  void VarMembrane_next_kk(VarMembrane *unit, int inNumSamples);
+  void VarMembrane_next_ka(VarMembrane *unit, int inNumSamples);
+  void VarMembrane_next_warmup(VarMembrane *unit, int inNumSamples);
+  void VarMembrane_next_sleep(VarMembrane *unit, int inNumSamples);
+  void VarMembrane_next_replay(VarMembrane *unit, int inNumSamples);
+  void VarMembrane_next_failed(VarMembrane *unit, int inNumSamples);
   void VarMembraneCircle_Ctor(VarMembrane* unit);
   void VarMembraneHexagon_Ctor(VarMembrane* unit);
+  void VarMembraneCustom_Ctor(VarMembrane* unit);
+  void VarMembraneShape_Ctor(VarMembrane* unit);
   void VarMembranePyeonGyeong_Ctor(VarMembrane* unit);
   void VarMembrane_Dtor(VarMembrane* unit);
+  void VarMembraneLanes_next_a(VarMembraneLanes *unit, int inNumSamples);
+  void VarMembraneLanes_next_warmup(VarMembraneLanes *unit, int inNumSamples);
+  void VarMembraneLanes_next_replay(VarMembraneLanes *unit, int inNumSamples);
+  void VarMembraneLanes_Ctor(VarMembraneLanes* unit);
+  void VarMembraneLanes_Dtor(VarMembraneLanes* unit);
+  void VarMembraneModal_next_a(VarMembraneModal *unit, int inNumSamples);
+  void VarMembraneModal_next_warmup(VarMembraneModal *unit, int inNumSamples);
+  void VarMembraneModal_next_replay(VarMembraneModal *unit, int inNumSamples);
+  void VarMembraneModal_Ctor(VarMembraneModal* unit);
+  void VarMembraneModal_Dtor(VarMembraneModal* unit);
+  void VarMembraneConv_next_a(VarMembraneConv *unit, int inNumSamples);
+  void VarMembraneConv_next_warmup(VarMembraneConv *unit, int inNumSamples);
+  void VarMembraneConv_next_sleep(VarMembraneConv *unit, int inNumSamples);
+  void VarMembraneConv_next_replay(VarMembraneConv *unit, int inNumSamples);
+  void VarMembraneConv_next_failed(VarMembraneConv *unit, int inNumSamples);
+  void VarMembraneConv_Ctor(VarMembraneConv* unit);
+  void VarMembraneConv_Dtor(VarMembraneConv* unit);
 };
 
 ////////////////////////////////////////////////////////////////////
 
-// execute one sample cycle over the mesh
+static inline int VarMembrane_silent(const float *in, int n)
+{
+  for (int k = 0; k < n; ++k) {
+    if (in[k] != 0.f) {
+      return 0;
+    }
+  }
+  return 1;
+}
 
-float cycle(VarMembrane *unit, float input, float yj_r) {
-  //유닛에 딜레이를 읽어와 포인터를 만들어준다
-  t_delay *delays = unit->delays;
-  //역시 단순한 포인터
-  t_junction *junctions = unit->junctions;
+// outputs silence: for units whose mesh could not be had
+static void VarMembrane_next_clear(Unit *unit, int inNumSamples)
+{
+  ClearUnitOutputs(unit, inNumSamples);
+}
 
-  int i;
+////////////////////////////////////////////////////////////////////
 
-  int middle = (int) (unit->shape->points_n / 2);
-  float result;
+static void VarMembrane_latch_init(VarMembraneLatch *latch)
+{
+  latch->seen = 0;
+  latch->buf = NULL;
+  latch->n = 0;
+  latch->pos = 0;
+}
 
-  for (i = 0; i < unit->shape->points_n; ++i) {
+// during warm-up: keeps the audio excitation at input, from the first
+// sound on
+static void VarMembrane_latch(Unit *unit, VarMembraneLatch *latch, int input, int inNumSamples)
+{
+  const float *in = IN(input);
 
-    t_junction *junction = &junctions[i];
-    int j;
-    float total = 0;
+  if (!latch->seen) {
+    if (VarMembrane_silent(in, inNumSamples)) {
+      return;
+    }
+    latch->seen = 1;
+    latch->buf = (float *) RTAlloc(unit->mWorld, (MESH_TRIGGER_DURATION + BUFLENGTH) * sizeof(float));
+  }
+  if (latch->buf) {
+    int n = MESH_TRIGGER_DURATION - latch->n;
+    if (n > inNumSamples) {
+      n = inNumSamples;
+    }
+    memcpy(latch->buf + latch->n, in, n * sizeof(float));
+    latch->n += n;
+  }
+}
 
-    float yc = unit->yj - junction->ins;
+static void VarMembrane_latch_free(Unit *unit, VarMembraneLatch *latch)
+{
+  if (latch->buf) {
+    RTFree(unit->mWorld, latch->buf);
+    latch->buf = NULL;
+  }
+}
 
-    for (j = 0; j < junction->ins; ++j) {
-      total += junction->in[j]->b;
-    }
+// after attach: one block of run with the latched excitation added to the
+// input, until it is used up or run goes to sleep. self is the calling
+// calc function
+static void VarMembrane_replay(Unit *unit, VarMembraneLatch *latch, UnitCalcFunc self,
+                               UnitCalcFunc run, int inNumSamples)
+{
+  float *live = IN(0);
+  float *mixed = latch->buf + latch->pos;
 
-#ifdef SELF_LOOP
-    total = 2.0f * (total + (yc * junction->self_loop->b)) * yj_r;
-#else
-    total *= (2.0f / ((float) junction->ins));
-#endif
+  for (int k = 0; k < inNumSamples; ++k) {
+    mixed[k] = (latch->pos + k < latch->n ? mixed[k] : 0.f) + live[k];
+  }
 
-    if (i < middle) {
-      total += (input / middle);
-    }
+  unit->mCalcFunc = run;
+  unit->mInBuf[0] = mixed;
+  (run)(unit, inNumSamples);
+  unit->mInBuf[0] = live;
 
-    total *= unit->loss;
+  latch->pos += inNumSamples;
+  if (latch->pos < latch->n && unit->mCalcFunc == run) {
+    unit->mCalcFunc = self;
+  }
+  else {
+    VarMembrane_latch_free(unit, latch);
+  }
+}
 
-    for (j = 0; j < junction->outs; ++j) {
-      junction->out[j]->a = total - junction->in[j]->b;
-    }
-#ifdef SELF_LOOP
-    junction->self_loop->a = total - junction->self_loop->b;
-#endif
+////////////////////////////////////////////////////////////////////
 
-    if (i == 0) {
-      result = total;
+// idle cache entries past MESH_CACHE_IDLE_BYTES are freed on the NRT
+// thread, one trim in flight at a time. the flag is only touched on the
+// audio thread
+
+static int trimPending;
+
+static bool VarMembrane_trim_stage2(World *world, void *inData)
+{
+  trimMeshCache(MESH_CACHE_IDLE_BYTES);
+  return true;
+}
+
+static bool VarMembrane_trim_stage3(World *world, void *inData)
+{
+  trimPending = 0;
+  return false;
+}
+
+// after a release that left its entry idle
+static void VarMembrane_trim(World *world)
+{
+  if (trimPending) {
+    return;
+  }
+  trimPending = 1;
+  DoAsynchronousCommand(world, NULL, "membraneTrim", NULL,
+                        (AsyncStageFn) VarMembrane_trim_stage2,
+                        (AsyncStageFn) VarMembrane_trim_stage3,
+                        NULL, NULL, 0, NULL);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// start running an attached mesh. a mesh at rest sleeps until the first
+// excitation, unless that came during warm-up
+static void VarMembrane_start(VarMembrane *unit)
+{
+  if (unit->latch.seen) {
+    unit->mCalcFunc = unit->latch.buf ? (UnitCalcFunc) &VarMembrane_next_replay : unit->run;
+    return;
+  }
+  profile_sleeping(unit->profile, 1);
+  SETCALC(VarMembrane_next_sleep);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// pickups and the strike are placed on the NRT thread: finding the
+// junctions near a point is O(points). a unit keeps warming up until its
+// first placement is back; a moved strike plays at the old point until the
+// new one is
+
+// a pickup's inputs
+struct VarMembranePickupAt {
+  int given; // 0 for a missing pair
+  float x;
+  float y;
+};
+
+struct VarMembranePlaceCmd {
+  VarMembrane *unit; // cleared by the Dtor if the unit goes away first
+  t_mesh_entry *entry; // with a reference of its own until stage 3
+  int model;
+  int strike; // place the strike at x, y
+  float x;
+  float y;
+  t_mesh_strike mesh_strike;
+  t_stencil_strike stencil_strike;
+  int pickup_n; // every pickup the first time, none after
+  t_mesh_pickup *pickups; // after the command
+  VarMembranePickupAt *at; // after the pickups
+};
+
+// every output after the first listens at one more point of the mesh,
+// given by the inputs from pickup_in on as x, y pairs in lattice units from
+// the output junction (x steps 2 along a row, rows 1 apart). the nearest
+// junction is taken; a missing pair listens at the output junction
+static void VarMembrane_pickup(const t_mesh_entry *entry, int model, const VarMembranePickupAt *at,
+                               t_mesh_pickup *pickup)
+{
+  uint32_t point = at->given ? mesh_point_near(entry->shape, at->x, at->y) : 0;
+  int ok = entry->stencil ? stencil_pickup(entry->stencil, entry->shape, model, point, pickup)
+    : mesh_pickup(entry->mesh, model, point, pickup);
+
+  if (!ok) {
+    // a one point mesh, never a stencil: listen to the always zero delay
+    pickup->out = entry->mesh->zero_d;
+    pickup->in = entry->mesh->zero_d;
+  }
+}
+
+static bool VarMembrane_place_stage2(World *world, void *inData)
+{
+  VarMembranePlaceCmd *cmd = (VarMembranePlaceCmd *) inData;
+  const t_mesh_entry *entry = cmd->entry;
+
+  for (int p = 0; p < cmd->pickup_n; ++p) {
+    VarMembrane_pickup(entry, cmd->model, &cmd->at[p], &cmd->pickups[p]);
+  }
+  if (cmd->strike && entry->stencil) {
+    stencil_strike(entry->stencil, entry->shape, cmd->x, cmd->y, &cmd->stencil_strike);
+  }
+  else if (cmd->strike) {
+    mesh_strike(entry->mesh, entry->shape, cmd->x, cmd->y, &cmd->mesh_strike);
+  }
+  return true;
+}
+
+static bool VarMembrane_place_stage3(World *world, void *inData)
+{
+  VarMembranePlaceCmd *cmd = (VarMembranePlaceCmd *) inData;
+  VarMembrane *unit = cmd->unit;
+
+  if (unit) {
+    unit->placing = NULL;
+    memcpy(unit->pickups, cmd->pickups, cmd->pickup_n * sizeof(t_mesh_pickup));
+    if (cmd->strike && unit->stencil) {
+      unit->stencil_strike = cmd->stencil_strike;
+      unit->stencil_state.strike = &unit->stencil_strike;
+    }
+    else if (cmd->strike) {
+      unit->strike = cmd->mesh_strike;
+      unit->state.strike = &unit->strike;
+    }
+    if (!unit->placed) {
+      unit->placed = 1;
+      VarMembrane_start(unit);
     }
   }
+  if (releaseMesh(cmd->entry)) {
+    VarMembrane_trim(world);
+  }
+  return false;
+}
 
-  // circulate the unit delays
-  for (i = 0; i < unit->delay_n; ++i) {
-    t_delay *delay = &delays[i];
-    if (delay->invert) {
-#ifdef RIMFILTER
-      delay->b = ((0.0f - delay->a) + delay->c) * 0.5f;
-      delay->c = (0.0f - delay->a);
-#else
-      delay->b = 0.f - delay->a;
-#endif
+static void VarMembrane_place_cleanup(World *world, void *inData)
+{
+  RTFree(world, inData);
+}
+
+// a placement with room for the pickups if they were not placed yet; NULL
+// when out of real-time memory
+static VarMembranePlaceCmd* VarMembrane_place_alloc(VarMembrane *unit)
+{
+  int pickup_n = unit->placed ? 0 : unit->pickup_n;
+  VarMembranePlaceCmd *cmd = (VarMembranePlaceCmd *) RTAlloc(
+    unit->mWorld, sizeof(VarMembranePlaceCmd)
+    + pickup_n * (sizeof(t_mesh_pickup) + sizeof(VarMembranePickupAt)));
+
+  if (cmd) {
+    cmd->pickup_n = pickup_n;
+    cmd->pickups = (t_mesh_pickup *) (cmd + 1);
+    cmd->at = (VarMembranePickupAt *) (cmd->pickups + pickup_n);
+  }
+  return cmd;
+}
+
+// place the pickups and the strike where their inputs are now
+static void VarMembrane_place(VarMembrane *unit, VarMembranePlaceCmd *cmd)
+{
+  cmd->unit = unit;
+  cmd->entry = unit->entry;
+  cmd->entry->refs++;
+  cmd->model = unit->model;
+  cmd->strike = unit->strike_in != 0;
+  if (cmd->strike) {
+    unit->strike_x = IN0(unit->strike_in);
+    unit->strike_y = IN0(unit->strike_in + 1);
+    cmd->x = unit->strike_x;
+    cmd->y = unit->strike_y;
+  }
+  for (int p = 0; p < cmd->pickup_n; ++p) {
+    int x = unit->pickup_in + 2 * p;
+
+    cmd->at[p].given = x + 1 < (int) unit->mNumInputs;
+    cmd->at[p].x = cmd->at[p].given ? IN0(x) : 0.f;
+    cmd->at[p].y = cmd->at[p].given ? IN0(x + 1) : 0.f;
+  }
+  unit->placing = cmd;
+
+  DoAsynchronousCommand(unit->mWorld, NULL, "VarMembranePlace", (void *) cmd,
+                        (AsyncStageFn) VarMembrane_place_stage2,
+                        (AsyncStageFn) VarMembrane_place_stage3,
+                        NULL,
+                        VarMembrane_place_cleanup,
+                        0, NULL);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// allocate the per-instance delay state for a built mesh and start running
+// it. audio thread only; no allocation apart from RTAlloc.
+
+static void VarMembrane_attach(Unit* inUnit, t_mesh_entry *entry, t_modal_entry *, t_conv_entry *)
+{
+  VarMembrane *unit = (VarMembrane *) inUnit;
+
+  if (!entry) {
+    VarMembrane_latch_free(unit, &unit->latch);
+    SETCALC(VarMembrane_next_failed);
+    return;
+  }
+
+  size_t pickup_size = (size_t) unit->pickup_n * sizeof(t_mesh_pickup);
+  size_t state_size = entry->stencil ? stencil_state_size(entry->stencil)
+    : mesh_state_size(entry->mesh);
+  VarMembranePlaceCmd *place = NULL;
+
+  unit->state_block = RTAlloc(unit->mWorld, pickup_size + state_size);
+  if (unit->state_block && (unit->strike_in || unit->pickup_n)) {
+    place = VarMembrane_place_alloc(unit);
+    if (!place) {
+      RTFree(unit->mWorld, unit->state_block);
+      unit->state_block = NULL;
     }
-    else {
-      delay->b = delay->a;
+  }
+  if (!unit->state_block) {
+    // out of real-time memory, stay silent
+    if (releaseMesh(entry)) {
+      VarMembrane_trim(unit->mWorld);
     }
+    VarMembrane_attach(unit, NULL, NULL, NULL);
+    return;
+  }
+
+  unit->entry = entry;
+  unit->mesh = entry->mesh;
+  unit->stencil = entry->stencil;
+  unit->pickups = (t_mesh_pickup *) unit->state_block;
+  void *state_block = (char *) unit->state_block + pickup_size;
+  if (unit->stencil) {
+    stencil_state_init(unit->stencil, &unit->stencil_state, state_block);
+  }
+  else {
+    mesh_state_init(unit->mesh, &unit->state, state_block);
+  }
+
+  if(unit->mWorld->mVerbosity > 0){
+    printf("%d delays initialised.\n", unit->mesh->delay_n);
+  }
+
+  profile_attach(unit->profile, unit->mesh->points_n, unit->mesh->delay_n,
+                 unit->stencil ? "stencil"
+                 : mesh_use_tiled(unit->mesh) && !unit->pickup_n ? "tiled" : "mesh");
+
+  if (place) {
+    VarMembrane_place(unit, place);
+    return;
+  }
+  VarMembrane_start(unit);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// asynchronous mesh build: stage 2 runs on the NRT thread, stage 3 hands the
+// result back to the unit on the audio thread
+
+static bool VarMembrane_build_stage2(World *world, void *inData)
+{
+  VarMembraneCmd *cmd = (VarMembraneCmd *) inData;
+  if (cmd->want == WANT_MODAL) {
+    cmd->modal = acquireModal(cmd->shape_type, cmd->angle, cmd->fragNums, cmd->model);
+  }
+  else if (cmd->want == WANT_CONV) {
+    cmd->conv = acquireConv(cmd->shape_type, cmd->angle, cmd->fragNums, cmd->model,
+                            cmd->yj, cmd->loss, cmd->length);
+  }
+  else {
+    cmd->entry = acquireMesh(cmd->shape_type, cmd->angle, cmd->fragNums);
+  }
+  return true;
+}
+
+static bool VarMembrane_build_stage3(World *world, void *inData)
+{
+  VarMembraneCmd *cmd = (VarMembraneCmd *) inData;
+  Unit *unit = cmd->unit;
+
+  if (unit) {
+    *cmd->pending = NULL;
+    (cmd->attach)(unit, cmd->entry, cmd->modal, cmd->conv);
+  }
+  else {
+    // the synth was freed before its mesh was ready
+    if ((cmd->entry && releaseMesh(cmd->entry)) || (cmd->modal && releaseModal(cmd->modal))
+        || (cmd->conv && releaseConv(cmd->conv))) {
+      VarMembrane_trim(world);
+    }
+  }
+  return false;
+}
+
+static void VarMembrane_build_cleanup(World *world, void *inData)
+{
+  RTFree(world, inData);
+}
+
+// build on the NRT thread while the unit outputs silence
+static void VarMembrane_post(Unit *unit, VarMembraneCmd **pending, VarMembraneAttachFunc attach,
+                             int shape_type, float angle, int fragNums,
+                             int want, int model, float yj, float loss, uint32_t length)
+{
+  VarMembraneCmd *cmd = (VarMembraneCmd *) RTAlloc(unit->mWorld, sizeof(VarMembraneCmd));
+  if (cmd) {
+    cmd->unit = unit;
+    cmd->pending = pending;
+    cmd->attach = attach;
+    cmd->entry = NULL;
+    cmd->modal = NULL;
+    cmd->conv = NULL;
+    cmd->shape_type = shape_type;
+    cmd->angle = angle;
+    cmd->fragNums = fragNums;
+    cmd->want = want;
+    cmd->model = model;
+    cmd->yj = yj;
+    cmd->loss = loss;
+    cmd->length = length;
+    *pending = cmd;
+
+    DoAsynchronousCommand(unit->mWorld, NULL, "VarMembraneMesh", (void *) cmd,
+                          (AsyncStageFn) VarMembrane_build_stage2,
+                          (AsyncStageFn) VarMembrane_build_stage3,
+                          NULL,
+                          VarMembrane_build_cleanup,
+                          0, NULL);
+  }
+  else {
+    attach(unit, NULL, NULL, NULL);
   }
-  return(result);
+}
+
+// get a mesh to attach(): cached meshes are attached right away, anything
+// else is built on the NRT thread
+static void VarMembrane_request(Unit *unit, VarMembraneCmd **pending, VarMembraneAttachFunc attach,
+                                int shape_type, float angle, int fragNums)
+{
+  t_mesh_entry *entry = tryAcquireMesh(shape_type, angle, fragNums);
+
+  *pending = NULL;
+
+  if (entry) {
+    attach(unit, entry, NULL, NULL);
+    return;
+  }
+  VarMembrane_post(unit, pending, attach, shape_type, angle, fragNums, WANT_MESH, 0, 0.f, 0.f, 0);
+}
+
+// the same for the modes of a mesh model
+static void VarMembrane_requestModal(Unit *unit, VarMembraneCmd **pending, VarMembraneAttachFunc attach,
+                                     int shape_type, float angle, int fragNums, int model)
+{
+  t_modal_entry *modal = tryAcquireModal(shape_type, angle, fragNums, model);
+
+  *pending = NULL;
+
+  if (modal) {
+    attach(unit, NULL, modal, NULL);
+    return;
+  }
+  VarMembrane_post(unit, pending, attach, shape_type, angle, fragNums, WANT_MODAL, model, 0.f, 0.f, 0);
+}
+
+// and for its impulse response, length samples at most
+static void VarMembrane_requestConv(Unit *unit, VarMembraneCmd **pending, VarMembraneAttachFunc attach,
+                                    int shape_type, float angle, int fragNums, int model,
+                                    float yj, float loss, uint32_t length)
+{
+  t_conv_entry *conv = tryAcquireConv(shape_type, angle, fragNums, model, yj, loss, length);
+
+  *pending = NULL;
+
+  if (conv) {
+    attach(unit, NULL, NULL, conv);
+    return;
+  }
+  VarMembrane_post(unit, pending, attach, shape_type, angle, fragNums, WANT_CONV, model, yj, loss,
+                   length);
 }
 
 ////////////////////////////////////////////////////////////////////
 
-void VarMembrane_init(VarMembrane* unit, int shape_type, int angle, int fragNums)
+// calc functions are specialised on the input rates: the first letter is the
+// excitation (a: audio signal, k: trigger for a noise burst), the second the
+// rate of tension and loss (i: fixed, k: per block, a: per sample)
+enum {
+  PARAMS_FIXED,
+  PARAMS_BLOCK,
+  PARAMS_SAMPLE
+};
+
+// the model input, MESH_MODEL_DEFAULT when absent and, with a message,
+// when out of range
+static int VarMembrane_model(Unit *unit, int input)
 {
+  float in = (int) unit->mNumInputs > input ? IN0(input) : (float) MESH_MODEL_DEFAULT;
+  int model = mesh_model_of(in);
 
-  t_shape *shape;
-  int d = 0;
-  int i = 0;
-  int j = 0;
+  if (model < 0) {
+    Print("VarMembrane: model %g is not 0-%d, playing %d\n", in, MESH_MODEL_N - 1,
+          MESH_MODEL_DEFAULT);
+    return MESH_MODEL_DEFAULT;
+  }
+  return model;
+}
 
-  SETCALC(VarMembrane_next_a);
+static void VarMembrane_params(VarMembrane *unit, float tension, float loss)
+{
+  unit->tension_in = tension;
+  unit->loss_in = loss;
+  unit->yj = mesh_admittance(tension);
+  unit->yj_r = 1.0f / unit->yj;
+  unit->loss = mesh_loss(loss);
+}
 
+// inputs is the number of the unit's own inputs when an optional strike
+// x, y pair may follow them, see MESH_INPUTS; 0 for units without a strike
+void VarMembrane_init(VarMembrane* unit, int shape_type, float angle, int fragNums,
+                      int inputs = 0)
+{
+  uint64_t start = profile_ticks();
+  unit->profile = profile_claim(shape_type, angle, fragNums,
+                                unit->mParent ? unit->mParent->mNode.mID : -1);
 
-#ifndef AUDIO_INPUT
+  int audio = INRATE(0) == calc_FullRate;
+  int params = PARAMS_FIXED;
+
+  if (INRATE(1) == calc_FullRate || INRATE(2) == calc_FullRate) {
+    params = PARAMS_SAMPLE;
+  }
+  else if (INRATE(1) != calc_ScalarRate || INRATE(2) != calc_ScalarRate) {
+    params = PARAMS_BLOCK;
+  }
+
+  static const UnitCalcFunc calcs[2][3] = {
+    {(UnitCalcFunc) &VarMembrane_next_ki, (UnitCalcFunc) &VarMembrane_next_kk,
+     (UnitCalcFunc) &VarMembrane_next_ka},
+    {(UnitCalcFunc) &VarMembrane_next_ai, (UnitCalcFunc) &VarMembrane_next_ak,
+     (UnitCalcFunc) &VarMembrane_next_aa}
+  };
+  unit->run = calcs[audio][params];
 
   unit->triggered = 0;
   unit->excite = 0;
-#endif
+  VarMembrane_latch_init(&unit->latch);
+
+  VarMembrane_params(unit, IN0(1), IN0(2));
+  unit->entry = NULL;
+  unit->mesh = NULL;
+  unit->stencil = NULL;
+  unit->state_block = NULL;
+  unit->done_action = unit->mNumInputs > 3 ? (int) IN0(3) : 0;
+  unit->model = VarMembrane_model(unit, 4);
+  unit->pickup_n = (int) unit->mNumOutputs - 1;
+  unit->pickups = NULL;
+  unit->placing = NULL;
+  unit->placed = 0;
+  unit->strike_in = inputs > 0 && inputs + 2 + 2 * unit->pickup_n <= (int) unit->mNumInputs
+    ? inputs : 0;
+  unit->pickup_in = unit->strike_in ? inputs + 2 : inputs > 0 ? inputs : MESH_INPUTS;
+  unit->kernels = mesh_kernels(unit->model);
+  unit->stencil_cycle = stencil_kernel(unit->model);
+
+  SETCALC(VarMembrane_next_warmup);
+
+  VarMembrane_request(unit, &unit->pending, VarMembrane_attach, shape_type, angle, fragNums);
 
-  unit->yj = 0;
+  // 3. Calculate one sample of output.
+  // (why do this?)
+  (unit->mCalcFunc)(unit, 1);
 
+  profile_constructed(unit->profile, start);
+}
 
-    
-    shape = unit->shape = calcMesh(shape_type, angle, fragNums);
 
+////////////////////////////////////////////////////////////////////
 
-  unit->delay_n = (shape->lines_n * 2)
-#ifdef RIMGUIDES
-    + shape->edge_n
-#endif
-#ifdef SELF_LOOP
-    + shape->points_n
-#endif
-    ;
+// a noise burst of MESH_TRIGGER_DURATION samples per rising edge
+static inline float VarMembrane_noise(VarMembrane *unit)
+{
+  if (unit->excite > 0) {
+    unit->excite--;
+    return (0.01 - (((float) rand() / RAND_MAX) * 0.02));
+  }
+  return 0.0;
+}
+
+// one sample on whichever engine the mesh was attached with, into sample k
+// of every output
+static inline void VarMembrane_cycle(VarMembrane *unit, int k, float input, float yj, float yj_r,
+                                     float loss)
+{
+  const float *a, *b;
+
+  if (unit->stencil) {
+    OUT(0)[k] = unit->stencil_cycle(unit->stencil, &unit->stencil_state, input, yj, yj_r, loss);
+    a = unit->stencil_state.a;
+    b = unit->stencil_state.b;
+  }
+  else {
+    OUT(0)[k] = unit->kernels->cycle(unit->mesh, &unit->state, input, yj, yj_r, loss);
+    a = unit->state.a;
+    b = unit->state.b;
+  }
+  for (int p = 0; p < unit->pickup_n; ++p) {
+    OUT(1 + p)[k] = mesh_pickup_read(&unit->pickups[p], a, b);
+  }
+}
+
+static inline float VarMembrane_energy(VarMembrane *unit)
+{
+  if (unit->stencil) {
+    return stencil_state_energy(unit->stencil, unit->model, &unit->stencil_state);
+  }
+  return mesh_state_energy(unit->mesh, unit->model, &unit->state);
+}
+
+template <bool AUDIO, int PARAMS>
+static inline void VarMembrane_next(VarMembrane *unit, int inNumSamples) {
+  // get the pointer to the output buffer
+  float *out = OUT(0);
+  float *in = IN(0);
+  const t_mesh *mesh = unit->mesh;
+  const t_mesh_kernels *kernels = unit->kernels;
+  uint64_t start = profile_ticks();
+
+  if (unit->strike_in && !unit->placing && (IN0(unit->strike_in) != unit->strike_x
+                                             || IN0(unit->strike_in + 1) != unit->strike_y)) {
+    VarMembranePlaceCmd *place = VarMembrane_place_alloc(unit);
+    if (place) {
+      VarMembrane_place(unit, place);
+    }
+  }
+
+  if (!AUDIO) {
+    float trigger = IN0(0);
+    if (trigger >= 0.5 && (! unit->triggered)) {
+      unit->triggered = 1;
+      unit->excite = MESH_TRIGGER_DURATION;
+    }
+    else if (trigger < 0.5 && unit->triggered) {
+      unit->triggered = 0;
+    }
+  }
 
+  unsigned int fpmode = mesh_denormals_flush();
 
-  unit->delays =
+  if (PARAMS == PARAMS_SAMPLE) {
+    // audio rate tension or loss: a new admittance every sample
+    float *tension = IN(1);
+    float *loss = IN(2);
+    int tension_step = INRATE(1) == calc_FullRate;
+    int loss_step = INRATE(2) == calc_FullRate;
 
-    (t_delay *) RTAlloc(unit->mWorld, unit->delay_n * sizeof(t_delay));
+    for (int k = 0; k < inNumSamples; ++k) {
+      float yj = mesh_admittance(tension[k * tension_step]);
+      float input = AUDIO ? in[k] : VarMembrane_noise(unit);
 
-  memset((void *) unit->delays, 0, unit->delay_n * sizeof(t_delay));
+      VarMembrane_cycle(unit, k, input, yj, 1.0f / yj, mesh_loss(loss[k * loss_step]));
+    }
+  }
+  else if (PARAMS == PARAMS_BLOCK && (IN0(1) != unit->tension_in || IN0(2) != unit->loss_in)) {
+    // a control rate change: ramp the admittance and loss over the block
+    // instead of stepping them
+    float yj = unit->yj;
+    float loss = unit->loss;
+
+    VarMembrane_params(unit, IN0(1), IN0(2));
+
+    float yj_slope = (unit->yj - yj) / inNumSamples;
+    float loss_slope = (unit->loss - loss) / inNumSamples;
 
+    for (int k = 0; k < inNumSamples; ++k) {
+      yj += yj_slope;
+      loss += loss_slope;
+      float input = AUDIO ? in[k] : VarMembrane_noise(unit);
 
-  unit->junctions =
-    (t_junction *) RTAlloc(unit->mWorld,
-			   unit->shape->points_n * sizeof(t_junction)
-			   );
+      VarMembrane_cycle(unit, k, input, yj, 1.0f / yj, loss);
+    }
+  }
+  else if (AUDIO && !unit->stencil && !unit->pickup_n && mesh_use_tiled(mesh)) {
+    // meshes too big for the cache advance several samples per sweep. only
+    // the output junction comes out of a sweep, so not with pickups
+    kernels->tiled(mesh, &unit->state, in, out, inNumSamples, unit->yj, unit->yj_r, unit->loss);
+  }
+  else {
+    for (int k = 0; k < inNumSamples; ++k) {
+      float input = AUDIO ? in[k] : VarMembrane_noise(unit);
 
-  memset((void *) unit->junctions, 0,
-	 unit->shape->points_n * sizeof(t_junction)
-	 );
+      VarMembrane_cycle(unit, k, input, unit->yj, unit->yj_r, unit->loss);
+    }
+  }
+
+  // nothing coming in and nothing left ringing: stop computing
+  int quiet = AUDIO ? VarMembrane_silent(in, inNumSamples) : unit->excite == 0;
+  if (quiet && VarMembrane_energy(unit) < MESH_QUIET_ENERGY) {
+    if (unit->stencil) {
+      stencil_state_clear(unit->stencil, &unit->stencil_state);
+    }
+    else {
+      mesh_state_clear(mesh, &unit->state);
+    }
+    profile_sleeping(unit->profile, 1);
+    SETCALC(VarMembrane_next_sleep);
+    if (unit->done_action) {
+      DoneAction(unit->done_action, unit);
+    }
+  }
 
+  mesh_denormals_restore(fpmode);
+  profile_block(unit->profile, profile_ticks() - start);
+}
 
+void VarMembrane_next_ai(VarMembrane *unit, int inNumSamples) {
+  VarMembrane_next<true, PARAMS_FIXED>(unit, inNumSamples);
+}
 
-  for (i = 0; i < shape->lines_n; ++i) {
+void VarMembrane_next_ak(VarMembrane *unit, int inNumSamples) {
+  VarMembrane_next<true, PARAMS_BLOCK>(unit, inNumSamples);
+}
 
-    t_line *line = shape->lines[i];
+void VarMembrane_next_aa(VarMembrane *unit, int inNumSamples) {
+  VarMembrane_next<true, PARAMS_SAMPLE>(unit, inNumSamples);
+}
 
-    t_junction *from, *to;
+void VarMembrane_next_ki(VarMembrane *unit, int inNumSamples) {
+  VarMembrane_next<false, PARAMS_FIXED>(unit, inNumSamples);
+}
 
-    t_delay *delay;
+void VarMembrane_next_kk(VarMembrane *unit, int inNumSamples) {
+  VarMembrane_next<false, PARAMS_BLOCK>(unit, inNumSamples);
+}
 
-    from = &unit->junctions[line->a->id];
-    to = &unit->junctions[line->b->id];
+void VarMembrane_next_ka(VarMembrane *unit, int inNumSamples) {
+  VarMembrane_next<false, PARAMS_SAMPLE>(unit, inNumSamples);
+}
 
-    delay = &unit->delays[d++];
+// a silent mesh outputs zeros until the next excitation wakes it
+void VarMembrane_next_sleep(VarMembrane *unit, int inNumSamples) {
+  int wake;
 
-    from->out[from->outs++] = delay;
-    to->in[to->ins++] = delay;
+  if (INRATE(0) == calc_FullRate) {
+    wake = !VarMembrane_silent(IN(0), inNumSamples);
+  }
+  else {
+    wake = IN0(0) >= 0.5 && !unit->triggered;
+    if (IN0(0) < 0.5) {
+      unit->triggered = 0;
+    }
+  }
 
-    // rightward delay
-    delay = &unit->delays[d++];
-    from->in[from->ins++] = delay;
-    to->out[to->outs++] = delay;
+  if (wake) {
+    profile_sleeping(unit->profile, 0);
+    unit->mCalcFunc = unit->run;
+    (unit->run)(unit, inNumSamples);
+    return;
   }
+  profile_sleep_block(unit->profile);
+  ClearUnitOutputs(unit, inNumSamples);
+}
 
-  for (i = 0; i < shape->points_n; ++i) {
-    t_point *point = shape->points[i];
-    t_junction *junction = &unit->junctions[i];
 
-#ifdef SELF_LOOP
-    t_delay *delay = &unit->delays[d++];
-    junction->self_loop = delay;
-#endif
+// silence until the asynchronously built mesh arrives, keeping what
+// excites it in the meantime. a trigger's noise burst is simply kept
+// pending
+void VarMembrane_next_warmup(VarMembrane *unit, int inNumSamples) {
+  if (INRATE(0) == calc_FullRate) {
+    VarMembrane_latch(unit, &unit->latch, 0, inNumSamples);
+  }
+  else if (IN0(0) >= 0.5 && !unit->triggered) {
+    unit->triggered = 1;
+    unit->excite = MESH_TRIGGER_DURATION;
+    unit->latch.seen = 1;
+  }
+  else if (IN0(0) < 0.5) {
+    unit->triggered = 0;
+  }
+  ClearUnitOutputs(unit, inNumSamples);
+}
+
+void VarMembrane_next_replay(VarMembrane *unit, int inNumSamples) {
+  VarMembrane_replay(unit, &unit->latch, (UnitCalcFunc) &VarMembrane_next_replay, unit->run,
+                     inNumSamples);
+}
+
+// no mesh: silence, and whatever the unit would have done once it decayed
+void VarMembrane_next_failed(VarMembrane *unit, int inNumSamples) {
+  ClearUnitOutputs(unit, inNumSamples);
+  if (unit->done_action) {
+    DoneAction(unit->done_action, unit);
+    unit->done_action = 0;
+  }
+}
 
-#ifdef RIMGUIDES
+////////////////////////////////////////////////////////////////////
+
+static void VarMembraneLanes_attach(Unit* inUnit, t_mesh_entry *entry, t_modal_entry *, t_conv_entry *)
+{
+  VarMembraneLanes *unit = (VarMembraneLanes *) inUnit;
 
-    assert((junction->ins < 6) == point->is_edge);
-    if (point->is_edge) {
-      t_delay *delay = &unit->delays[d++];
-      delay->invert = 1;
-      junction->out[junction->outs++] = delay;
-      junction->in[junction->ins++] = delay;
+  if (!entry) {
+    for (int l = 0; l < unit->lanes; ++l) {
+      VarMembrane_latch_free(unit, &unit->lane[l].latch);
     }
-#endif
+    unit->mCalcFunc = (UnitCalcFunc) &VarMembrane_next_clear;
+    return;
+  }
+
+  int stride = mesh_lanes_stride(unit->lanes);
+  size_t state_size = mesh_lanes_size(entry->mesh, unit->lanes);
+
+  unit->state_block = RTAlloc(unit->mWorld, state_size + 5 * stride * sizeof(float));
+  if (!unit->state_block) {
+    // out of real-time memory, stay silent
+    if (releaseMesh(entry)) {
+      VarMembrane_trim(unit->mWorld);
+    }
+    VarMembraneLanes_attach(unit, NULL, NULL, NULL);
+    return;
   }
 
+  unit->entry = entry;
+  unit->mesh = entry->mesh;
+  mesh_lanes_init(unit->mesh, &unit->state, unit->lanes, unit->state_block);
+
+  unit->input = (float *) ((char *) unit->state_block + state_size);
+  unit->yj = unit->input + stride;
+  unit->yj_r = unit->yj + stride;
+  unit->loss = unit->yj_r + stride;
+  unit->result = unit->loss + stride;
+
+  // padding lanes stay silent
+  for (int l = 0; l < stride; ++l) {
+    unit->input[l] = 0.f;
+    unit->yj[l] = 1.f;
+    unit->yj_r[l] = 1.f;
+    unit->loss[l] = 0.f;
+  }
+
+  for (int l = 0; l < unit->lanes; ++l) {
+    if (unit->lane[l].latch.buf) {
+      SETCALC(VarMembraneLanes_next_replay);
+      return;
+    }
+  }
+  SETCALC(VarMembraneLanes_next_a);
+}
+
+void VarMembraneLanes_Ctor(VarMembraneLanes* unit)
+{
+  unit->lanes = (int) (unit->mNumInputs - LANES_FIRST_INPUT) / LANES_INPUTS;
+  unit->cycle = mesh_kernels(VarMembrane_model(unit, 3))->lanes;
+  unit->entry = NULL;
+  unit->mesh = NULL;
+  unit->state_block = NULL;
+  unit->pending = NULL;
+  unit->lane = unit->lanes > 0
+    ? (VarMembraneLane *) RTAlloc(unit->mWorld, unit->lanes * sizeof(VarMembraneLane)) : NULL;
+
+  SETCALC(VarMembraneLanes_next_warmup);
+
+  if (unit->lane) {
+    for (int l = 0; l < unit->lanes; ++l) {
+      unit->lane[l].audio = INRATE(LANES_FIRST_INPUT + l * LANES_INPUTS) == calc_FullRate;
+      VarMembrane_latch_init(&unit->lane[l].latch);
+    }
+    VarMembrane_request(unit, &unit->pending, VarMembraneLanes_attach,
+                        (int) IN0(0), IN0(1), (int) IN0(2));
+  }
+  else {
+    // no lanes, or out of real-time memory
+    unit->mCalcFunc = (UnitCalcFunc) &VarMembrane_next_clear;
+  }
+
+  (unit->mCalcFunc)(unit, 1);
+}
+
+// REPLAY adds what each lane latched during warm-up to its excitation
+template <bool REPLAY>
+static inline void VarMembraneLanes_next(VarMembraneLanes *unit, int inNumSamples)
+{
+  int lanes = unit->lanes;
+  VarMembraneLane *lane = unit->lane;
+
+  for (int l = 0; l < lanes; ++l) {
+    int input_n = LANES_FIRST_INPUT + l * LANES_INPUTS;
+
+    unit->yj[l] = mesh_admittance(IN0(input_n + 1));
+    unit->yj_r[l] = 1.0f / unit->yj[l];
+    unit->loss[l] = mesh_loss(IN0(input_n + 2));
+  }
+
+  unsigned int fpmode = mesh_denormals_flush();
+
+  for (int k = 0; k < inNumSamples; ++k) {
+    for (int l = 0; l < lanes; ++l) {
+      int input_n = LANES_FIRST_INPUT + l * LANES_INPUTS;
+      const VarMembraneLatch *latch = &lane[l].latch;
+
+      unit->input[l] = lane[l].audio ? IN(input_n)[k] : IN0(input_n);
+      if (REPLAY && latch->buf && latch->pos + k < latch->n) {
+        unit->input[l] += latch->buf[latch->pos + k];
+      }
+    }
+
+    (unit->cycle)(unit->mesh, &unit->state, unit->input, unit->yj, unit->yj_r,
+                  unit->loss, unit->result);
+
+    for (int l = 0; l < lanes; ++l) {
+      OUT(l)[k] = unit->result[l];
+    }
+  }
+
+  mesh_denormals_restore(fpmode);
+}
+
+void VarMembraneLanes_next_a(VarMembraneLanes *unit, int inNumSamples)
+{
+  VarMembraneLanes_next<false>(unit, inNumSamples);
+}
+
+// silence until the mesh arrives, keeping what excites each audio lane
+void VarMembraneLanes_next_warmup(VarMembraneLanes *unit, int inNumSamples) {
+  for (int l = 0; l < unit->lanes; ++l) {
+    if (unit->lane[l].audio) {
+      VarMembrane_latch(unit, &unit->lane[l].latch, LANES_FIRST_INPUT + l * LANES_INPUTS,
+                        inNumSamples);
+    }
+  }
+  ClearUnitOutputs(unit, inNumSamples);
+}
+
+// after attach: the latched excitations on top of the live ones, until
+// every lane's is used up
+void VarMembraneLanes_next_replay(VarMembraneLanes *unit, int inNumSamples) {
+  int replaying = 0;
+
+  VarMembraneLanes_next<true>(unit, inNumSamples);
+
+  for (int l = 0; l < unit->lanes; ++l) {
+    VarMembraneLatch *latch = &unit->lane[l].latch;
+
+    if (latch->buf) {
+      latch->pos += inNumSamples;
+      if (latch->pos < latch->n) {
+        replaying = 1;
+      }
+      else {
+        VarMembrane_latch_free(unit, latch);
+      }
+    }
+  }
+  if (!replaying) {
+    SETCALC(VarMembraneLanes_next_a);
+  }
+}
+
+void VarMembraneLanes_Dtor(VarMembraneLanes* unit) {
+  if (unit->pending) {
+    unit->pending->unit = NULL;
+  }
+  if (unit->lane) {
+    for (int l = 0; l < unit->lanes; ++l) {
+      VarMembrane_latch_free(unit, &unit->lane[l].latch);
+    }
+    RTFree(unit->mWorld, unit->lane);
+  }
+  if (unit->entry) {
+    if (releaseMesh(unit->entry)) {
+      VarMembrane_trim(unit->mWorld);
+    }
+    RTFree(unit->mWorld, unit->state_block);
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+
+static void VarMembraneModal_attach(Unit* inUnit, t_mesh_entry *, t_modal_entry *entry, t_conv_entry *)
+{
+  VarMembraneModal *unit = (VarMembraneModal *) inUnit;
+
+  if (!entry) {
+    VarMembrane_latch_free(unit, &unit->latch);
+    unit->mCalcFunc = (UnitCalcFunc) &VarMembrane_next_clear;
+    return;
+  }
+
+  int modes_n = modal_select(entry->modal, unit->max_modes, unit->threshold);
+
+  unit->state_block = RTAlloc(unit->mWorld, modal_state_size(modes_n));
+  if (!unit->state_block) {
+    // out of real-time memory, stay silent
+    if (releaseModal(entry)) {
+      VarMembrane_trim(unit->mWorld);
+    }
+    VarMembraneModal_attach(unit, NULL, NULL, NULL);
+    return;
+  }
+
+  unit->entry = entry;
+  modal_state_init(entry->modal, &unit->state, modes_n, unit->state_block);
+  modal_retune(entry->modal, &unit->state, mesh_admittance(unit->tension),
+               mesh_loss(unit->loss));
+
   if(unit->mWorld->mVerbosity > 0){
-    printf("%d delays initialised.\n", unit->delay_n);
+    printf("%d of %d modes initialised.\n", modes_n, entry->modal->modes_n);
   }
 
-  // 3. Calculate one sample of output.
-  // (why do this?)
-  VarMembrane_next_a(unit, 1);
+  if (unit->latch.buf) {
+    SETCALC(VarMembraneModal_next_replay);
+    return;
+  }
+  SETCALC(VarMembraneModal_next_a);
+}
+
+void VarMembraneModal_Ctor(VarMembraneModal* unit)
+{
+  unit->tension = IN0(1);
+  unit->loss = IN0(2);
+  unit->max_modes = (int) IN0(6);
+  unit->threshold = IN0(7);
+  unit->entry = NULL;
+  unit->state_block = NULL;
+  VarMembrane_latch_init(&unit->latch);
+
+  SETCALC(VarMembraneModal_next_warmup);
+
+  if (INRATE(0) != calc_FullRate) {
+    // modal_run() and the latch take a block of samples
+    Print("VarMembraneModal: the excitation must be audio rate\n");
+    unit->pending = NULL;
+    unit->mCalcFunc = (UnitCalcFunc) &VarMembrane_next_clear;
+  }
+  else {
+    VarMembrane_requestModal(unit, &unit->pending, VarMembraneModal_attach,
+                             (int) IN0(3), IN0(4), (int) IN0(5), VarMembrane_model(unit, 8));
+  }
+
+  (unit->mCalcFunc)(unit, 1);
+}
+
+void VarMembraneModal_next_a(VarMembraneModal *unit, int inNumSamples)
+{
+  float tension = IN0(1);
+  float loss = IN0(2);
+
+  // moving the poles is cheap, a new decomposition is not
+  if (tension != unit->tension || loss != unit->loss) {
+    unit->tension = tension;
+    unit->loss = loss;
+    modal_retune(unit->entry->modal, &unit->state, mesh_admittance(tension),
+                 mesh_loss(loss));
+  }
+
+  unsigned int fpmode = mesh_denormals_flush();
+  modal_run(&unit->state, IN(0), OUT(0), inNumSamples);
+  mesh_denormals_restore(fpmode);
 }
 
+void VarMembraneModal_next_warmup(VarMembraneModal *unit, int inNumSamples) {
+  VarMembrane_latch(unit, &unit->latch, 0, inNumSamples);
+  ClearUnitOutputs(unit, inNumSamples);
+}
+
+void VarMembraneModal_next_replay(VarMembraneModal *unit, int inNumSamples) {
+  VarMembrane_replay(unit, &unit->latch, (UnitCalcFunc) &VarMembraneModal_next_replay,
+                     (UnitCalcFunc) &VarMembraneModal_next_a, inNumSamples);
+}
+
+void VarMembraneModal_Dtor(VarMembraneModal* unit) {
+  if (unit->pending) {
+    unit->pending->unit = NULL;
+  }
+  VarMembrane_latch_free(unit, &unit->latch);
+  if (unit->entry) {
+    if (releaseModal(unit->entry)) {
+      VarMembrane_trim(unit->mWorld);
+    }
+    RTFree(unit->mWorld, unit->state_block);
+  }
+}
 
 ////////////////////////////////////////////////////////////////////
 
-void VarMembrane_next_a(VarMembrane *unit, int inNumSamples) {
-  // get the pointer to the output buffer
-  float *out = OUT(0);
-  int input_n = 0;
-  // get the control rate input
-#ifdef AUDIO_INPUT
-  float *in = IN(input_n++);
-#else
-  float trigger = IN0(input_n++);
-#endif
+static void VarMembraneConv_attach(Unit* inUnit, t_mesh_entry *, t_modal_entry *, t_conv_entry *entry)
+{
+  VarMembraneConv *unit = (VarMembraneConv *) inUnit;
 
-  float tension = IN0(input_n++);
-  float loss = IN0(input_n++);
+  if (!entry) {
+    VarMembrane_latch_free(unit, &unit->latch);
+    SETCALC(VarMembraneConv_next_failed);
+    return;
+  }
 
-  if (tension == 0) {
-    // default tension
-    tension =  0.0001;
+  unit->state_block = RTAlloc(unit->mWorld, conv_state_size(entry->conv));
+  if (!unit->state_block) {
+    // out of real-time memory, stay silent
+    if (releaseConv(entry)) {
+      VarMembrane_trim(unit->mWorld);
+    }
+    VarMembraneConv_attach(unit, NULL, NULL, NULL);
+    return;
   }
 
-  unit->yj = 2.f * DELTA * DELTA / (tension * tension * GAMMA * GAMMA);
+  unit->entry = entry;
+  conv_state_init(entry->conv, &unit->state, unit->state_block);
+  unit->silent = 0;
+
+  if(unit->mWorld->mVerbosity > 0){
+    printf("%u taps in %u levels initialised.\n", entry->conv->length, entry->conv->levels_n);
+  }
 
-  float yj_r = 1.0f / unit->yj;
+  if (unit->latch.seen) {
+    unit->mCalcFunc = unit->latch.buf ? (UnitCalcFunc) &VarMembraneConv_next_replay
+      : (UnitCalcFunc) &VarMembraneConv_next_a;
+    return;
+  }
+  SETCALC(VarMembraneConv_next_sleep);
+}
 
-  if (loss >= 1) {
-    loss = 0.99999;
+// the response is at most CONV_MAX_SECONDS long: its state, RTAlloc'd per
+// unit, takes about 2 floats per sample of it
+void VarMembraneConv_Ctor(VarMembraneConv* unit)
+{
+  float seconds = IN0(6);
+  if (seconds > CONV_MAX_SECONDS) {
+    seconds = CONV_MAX_SECONDS;
   }
-  unit->loss = loss;
+  uint32_t length = seconds > 0 ? (uint32_t) (seconds * SAMPLERATE) : 0;
 
- 
-#ifndef AUDIO_INPUT
-  if (trigger >= 0.5 && (! unit->triggered)) {
+  unit->entry = NULL;
+  unit->state_block = NULL;
+  unit->pending = NULL;
+  unit->done_action = unit->mNumInputs > 8 ? (int) IN0(8) : 0;
+  VarMembrane_latch_init(&unit->latch);
 
-    unit->triggered = 1;
-    unit->excite = TRIGGER_DURATION;
+  SETCALC(VarMembraneConv_next_warmup);
 
+  if (INRATE(0) != calc_FullRate) {
+    // conv_run() and the latch take a block of samples
+    Print("VarMembraneConv: the excitation must be audio rate\n");
+    VarMembraneConv_attach(unit, NULL, NULL, NULL);
   }
-  else if (trigger < 0.5 && unit->triggered) {
-    unit->triggered = 0;
+  else if (length > 0) {
+    VarMembrane_requestConv(unit, &unit->pending, VarMembraneConv_attach,
+                            (int) IN0(3), IN0(4), (int) IN0(5), VarMembrane_model(unit, 7),
+                            mesh_admittance(IN0(1)), mesh_loss(IN0(2)), length);
+  }
+  else {
+    VarMembraneConv_attach(unit, NULL, NULL, NULL);
   }
-#endif
-  ////////////////////
 
-  for (int k=0; k < inNumSamples; ++k) {
-    float input = 0.0;
-#ifdef AUDIO_INPUT
+  (unit->mCalcFunc)(unit, 1);
+}
 
-    input = in[k];
-#else
-    if (unit->excite > 0) {
-      input = (0.01 - (((float) rand() / RAND_MAX) * 0.02));
-      unit->excite--;
+void VarMembraneConv_next_a(VarMembraneConv *unit, int inNumSamples)
+{
+  const t_conv *conv = unit->entry->conv;
+
+  unsigned int fpmode = mesh_denormals_flush();
+  conv_run(conv, &unit->state, IN(0), OUT(0), inNumSamples);
+  mesh_denormals_restore(fpmode);
+
+  // once the response has run out everything in the state is exactly 0,
+  // so the unit can stop without clearing it
+  if (VarMembrane_silent(IN(0), inNumSamples)) {
+    unit->silent += inNumSamples;
+    if (unit->silent >= conv->silence) {
+      SETCALC(VarMembraneConv_next_sleep);
+      if (unit->done_action) {
+        DoneAction(unit->done_action, unit);
+      }
     }
-#endif
+  }
+  else {
+    unit->silent = 0;
+  }
+}
 
-    out[k] = cycle(unit, input, yj_r);
+void VarMembraneConv_next_sleep(VarMembraneConv *unit, int inNumSamples) {
+  if (!VarMembrane_silent(IN(0), inNumSamples)) {
+    unit->silent = 0;
+    SETCALC(VarMembraneConv_next_a);
+    VarMembraneConv_next_a(unit, inNumSamples);
+    return;
+  }
+  ClearUnitOutputs(unit, inNumSamples);
+}
+
+void VarMembraneConv_next_warmup(VarMembraneConv *unit, int inNumSamples) {
+  VarMembrane_latch(unit, &unit->latch, 0, inNumSamples);
+  ClearUnitOutputs(unit, inNumSamples);
+}
+
+void VarMembraneConv_next_failed(VarMembraneConv *unit, int inNumSamples) {
+  ClearUnitOutputs(unit, inNumSamples);
+  if (unit->done_action) {
+    DoneAction(unit->done_action, unit);
+    unit->done_action = 0;
+  }
+}
+
+void VarMembraneConv_next_replay(VarMembraneConv *unit, int inNumSamples) {
+  VarMembrane_replay(unit, &unit->latch, (UnitCalcFunc) &VarMembraneConv_next_replay,
+                     (UnitCalcFunc) &VarMembraneConv_next_a, inNumSamples);
+}
+
+void VarMembraneConv_Dtor(VarMembraneConv* unit) {
+  if (unit->pending) {
+    unit->pending->unit = NULL;
+  }
+  VarMembrane_latch_free(unit, &unit->latch);
+  if (unit->entry) {
+    if (releaseConv(unit->entry)) {
+      VarMembrane_trim(unit->mWorld);
+    }
+    RTFree(unit->mWorld, unit->state_block);
   }
 }
 
@@ -320,6 +1426,21 @@ void VarMembraneHexagon_Ctor(VarMembrane* unit) {
   VarMembrane_init(unit, 1, 0, 0);
 }
 
+// a mesh defined by /cmd membraneLoadPoints or membraneLoadMask, by the id
+// after the model input
+void VarMembraneCustom_Ctor(VarMembrane* unit) {
+  VarMembrane_init(unit, MESH_CUSTOM, 0, unit->mNumInputs > 5 ? (int) IN0(5) : 0, CUSTOM_INPUTS);
+}
+
+// any of the meshes above by the shape type, angle and fragNums after the
+// model input. chime angles are not limited to the four of StoneChime0-3;
+// an unseen one is built in the background, see canonicalKey()
+void VarMembraneShape_Ctor(VarMembrane* unit) {
+  VarMembrane_init(unit, unit->mNumInputs > 5 ? (int) IN0(5) : 2,
+                   unit->mNumInputs > 6 ? IN0(6) : 14,
+                   unit->mNumInputs > 7 ? (int) IN0(7) : 0, SHAPE_INPUTS);
+}
+
 void StoneChime0_Ctor(VarMembrane* unit){
     VarMembrane_init(unit, 2, 2, 0);
 }
@@ -532,9 +1653,253 @@ void SCFrag46_Ctor(VarMembrane* unit){
 void VarMembrane_Dtor(VarMembrane* unit) {
   //메모리 free해준다 
   
-  //free_shape(unit->shape);
-  RTFree(unit->mWorld, unit->delays);
-  RTFree(unit->mWorld, unit->junctions);
+  if (unit->pending) {
+    unit->pending->unit = NULL;
+  }
+  if (unit->placing) {
+    unit->placing->unit = NULL;
+  }
+  VarMembrane_latch_free(unit, &unit->latch);
+  if (unit->entry) {
+    if (releaseMesh(unit->entry)) {
+      VarMembrane_trim(unit->mWorld);
+    }
+    RTFree(unit->mWorld, unit->state_block);
+  }
+  profile_release(unit->profile);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// /cmd membraneProfile [path]: the VarMembrane counters, see
+// Membrane_profile.h, printed or written to path. the audio thread only
+// passes the request on; the dump runs on the NRT thread
+
+// plug-in command data is a single RTAlloc
+static void VarMembrane_cmd_cleanup(World *world, void *inData)
+{
+  RTFree(world, inData);
+}
+
+static bool VarMembrane_profile_stage2(World *world, void *inData)
+{
+  const char *path = (const char *) inData;
+
+  if (*path) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+      printf("membraneProfile: cannot write %s\n", path);
+      return false;
+    }
+    profile_dump(out, unitName);
+    fclose(out);
+  }
+  else {
+    profile_dump(stdout, unitName);
+  }
+  return true;
+}
+
+static void VarMembrane_profileCmd(World *world, void *inUserData, sc_msg_iter *args, void *replyAddr)
+{
+  const char *path = args->gets();
+  size_t size = path ? strlen(path) + 1 : 1;
+  char *data = (char *) RTAlloc(world, size);
+
+  if (!data) {
+    return;
+  }
+  if (path) {
+    memcpy(data, path, size);
+  }
+  else {
+    data[0] = 0;
+  }
+  DoAsynchronousCommand(world, replyAddr, "membraneProfile", (void *) data,
+                        (AsyncStageFn) VarMembrane_profile_stage2,
+                        NULL, NULL,
+                        VarMembrane_cmd_cleanup,
+                        0, NULL);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// meshes built ahead of the notes that need them, on the NRT thread:
+//
+// /cmd membranePreload item...: each item a UGen name (StoneChime3) or a
+// shape type, angle and fragNums triple (2, 14, 0; 2, 9.5, 0 for a
+// VarMembraneShape chime)
+// /cmd membraneLoadPoints id path, /cmd membraneLoadMask id path: defines
+// custom mesh id from a file, see loadCustomPoints(), and builds it
+// /cmd membranePurge: frees every cached mesh no unit is playing
+
+#define PRELOAD_MAX 64
+
+struct VarMembranePreloadCmd {
+  int n;
+  int shape_type[PRELOAD_MAX];
+  float angle[PRELOAD_MAX];
+  int fragNums[PRELOAD_MAX];
+};
+
+struct VarMembraneLoadCmd {
+  int id;
+  int mask;
+  char path[1]; // and the rest of the string
+};
+
+static void VarMembrane_preload(int shape_type, float angle, int fragNums)
+{
+  t_mesh_entry *entry = acquireMesh(shape_type, angle, fragNums);
+
+  // idle entries stay cached, up to MESH_CACHE_IDLE_BYTES
+  if (entry) {
+    releaseMesh(entry);
+  }
+  else {
+    printf("membranePreload: no mesh %d %g %d\n", shape_type, angle, fragNums);
+  }
+}
+
+static bool VarMembrane_preload_stage2(World *world, void *inData)
+{
+  VarMembranePreloadCmd *cmd = (VarMembranePreloadCmd *) inData;
+
+  for (int i = 0; i < cmd->n; ++i) {
+    VarMembrane_preload(cmd->shape_type[i], cmd->angle[i], cmd->fragNums[i]);
+  }
+  trimMeshCache(MESH_CACHE_IDLE_BYTES);
+  return true;
+}
+
+static bool VarMembrane_load_stage2(World *world, void *inData)
+{
+  VarMembraneLoadCmd *cmd = (VarMembraneLoadCmd *) inData;
+  int points_n = cmd->mask ? loadCustomMask(cmd->id, cmd->path)
+    : loadCustomPoints(cmd->id, cmd->path);
+
+  if (!points_n) {
+    return false;
+  }
+  if (world->mVerbosity > 0) {
+    printf("custom mesh %d: %d points from %s\n", cmd->id, points_n, cmd->path);
+  }
+  VarMembrane_preload(MESH_CUSTOM, 0, cmd->id);
+  trimMeshCache(MESH_CACHE_IDLE_BYTES);
+  return true;
+}
+
+static bool VarMembrane_purge_stage2(World *world, void *inData)
+{
+  int freed = purgeMeshCache();
+
+  if (world->mVerbosity > 0) {
+    printf("membranePurge: %d cache entries freed\n", freed);
+  }
+  return true;
+}
+
+static void VarMembrane_preloadCmd(World *world, void *inUserData, sc_msg_iter *args, void *replyAddr)
+{
+  VarMembranePreloadCmd *cmd = (VarMembranePreloadCmd *) RTAlloc(world, sizeof(VarMembranePreloadCmd));
+
+  if (!cmd) {
+    return;
+  }
+  cmd->n = 0;
+  while (args->remain() > 0 && cmd->n < PRELOAD_MAX) {
+    int i = cmd->n;
+
+    if (args->nextTag('i') == 's') {
+      const char *name = args->gets();
+      int angle;
+      if (!name || !unitParams(name, &cmd->shape_type[i], &angle, &cmd->fragNums[i])) {
+        Print("membranePreload: no unit %s\n", name ? name : "");
+        continue;
+      }
+      cmd->angle[i] = angle;
+    }
+    else {
+      cmd->shape_type[i] = args->geti();
+      cmd->angle[i] = args->getf();
+      cmd->fragNums[i] = args->geti();
+    }
+    cmd->n++;
+  }
+
+  DoAsynchronousCommand(world, replyAddr, "membranePreload", (void *) cmd,
+                        (AsyncStageFn) VarMembrane_preload_stage2,
+                        NULL, NULL,
+                        VarMembrane_cmd_cleanup,
+                        0, NULL);
+}
+
+static void VarMembrane_load(World *world, sc_msg_iter *args, void *replyAddr, int mask)
+{
+  const char *name = mask ? "membraneLoadMask" : "membraneLoadPoints";
+  int id = args->geti(-1);
+  const char *path = args->gets();
+
+  if (id < 0 || id >= CUSTOM_MESHES || !path) {
+    Print("%s: expected an id below %d and a path\n", name, CUSTOM_MESHES);
+    return;
+  }
+
+  size_t size = strlen(path) + 1;
+  VarMembraneLoadCmd *cmd = (VarMembraneLoadCmd *) RTAlloc(world, sizeof(VarMembraneLoadCmd) + size);
+  if (!cmd) {
+    return;
+  }
+  cmd->id = id;
+  cmd->mask = mask;
+  memcpy(cmd->path, path, size);
+
+  DoAsynchronousCommand(world, replyAddr, name, (void *) cmd,
+                        (AsyncStageFn) VarMembrane_load_stage2,
+                        NULL, NULL,
+                        VarMembrane_cmd_cleanup,
+                        0, NULL);
+}
+
+static void VarMembrane_loadPointsCmd(World *world, void *inUserData, sc_msg_iter *args, void *replyAddr)
+{
+  VarMembrane_load(world, args, replyAddr, 0);
+}
+
+static void VarMembrane_loadMaskCmd(World *world, void *inUserData, sc_msg_iter *args, void *replyAddr)
+{
+  VarMembrane_load(world, args, replyAddr, 1);
+}
+
+static void VarMembrane_purgeCmd(World *world, void *inUserData, sc_msg_iter *args, void *replyAddr)
+{
+  DoAsynchronousCommand(world, replyAddr, "membranePurge", NULL,
+                        (AsyncStageFn) VarMembrane_purge_stage2,
+                        NULL, NULL, NULL, 0, NULL);
+}
+
+////////////////////////////////////////////////////////////////////
+
+// precompiled meshes from $STONECHIME_MESHES, else from MESHFILE_NAME next
+// to the plug-in; set the variable empty to build every mesh instead
+static void VarMembrane_loadMeshes()
+{
+  const char *path = getenv("STONECHIME_MESHES");
+  char buf[4096];
+
+#ifndef _WIN32
+  Dl_info info;
+  if (!path && dladdr((void *) &VarMembrane_loadMeshes, &info) && info.dli_fname) {
+    const char *slash = strrchr(info.dli_fname, '/');
+    int dir = slash ? (int) (slash - info.dli_fname + 1) : 0;
+
+    snprintf(buf, sizeof(buf), "%.*s%s", dir, info.dli_fname, MESHFILE_NAME);
+    path = buf;
+  }
+#endif
+  if (path && *path) {
+    loadMeshFile(path);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -544,6 +1909,16 @@ PluginLoad(VarMembrane)
 {
   ft = inTable;
 
+  // pick the widest SIMD mesh kernel this CPU runs
+  mesh_select_kernel(MESH_KERNEL_N);
+  VarMembrane_loadMeshes();
+
+  DefinePlugInCmd("membraneProfile", (PlugInCmdFunc) VarMembrane_profileCmd, NULL);
+  DefinePlugInCmd("membranePreload", (PlugInCmdFunc) VarMembrane_preloadCmd, NULL);
+  DefinePlugInCmd("membraneLoadPoints", (PlugInCmdFunc) VarMembrane_loadPointsCmd, NULL);
+  DefinePlugInCmd("membraneLoadMask", (PlugInCmdFunc) VarMembrane_loadMaskCmd, NULL);
+  DefinePlugInCmd("membranePurge", (PlugInCmdFunc) VarMembrane_purgeCmd, NULL);
+
   //여기서 2개의 uGen을 만들어 주고 싶은 경우 DefineSimpleUnit을 쓰지 못하는듯. 그건 1개 일때만?
   //아니면 Dtor때문에 그럴수도 
   (*ft->fDefineUnit)("VarMembraneCircle",
@@ -821,6 +2196,36 @@ PluginLoad(VarMembrane)
                        (UnitDtorFunc)&VarMembrane_Dtor,
                        0);
 
+  (*ft->fDefineUnit)("VarMembraneCustom",
+		     sizeof(VarMembrane),
+		     (UnitCtorFunc)&VarMembraneCustom_Ctor,
+		     (UnitDtorFunc)&VarMembrane_Dtor,
+		     0);
+
+  (*ft->fDefineUnit)("VarMembraneShape",
+		     sizeof(VarMembrane),
+		     (UnitCtorFunc)&VarMembraneShape_Ctor,
+		     (UnitDtorFunc)&VarMembrane_Dtor,
+		     0);
+
+  (*ft->fDefineUnit)("VarMembraneLanes",
+		     sizeof(VarMembraneLanes),
+		     (UnitCtorFunc)&VarMembraneLanes_Ctor,
+		     (UnitDtorFunc)&VarMembraneLanes_Dtor,
+		     0);
+
+  (*ft->fDefineUnit)("VarMembraneModal",
+		     sizeof(VarMembraneModal),
+		     (UnitCtorFunc)&VarMembraneModal_Ctor,
+		     (UnitDtorFunc)&VarMembraneModal_Dtor,
+		     0);
+
+  (*ft->fDefineUnit)("VarMembraneConv",
+		     sizeof(VarMembraneConv),
+		     (UnitCtorFunc)&VarMembraneConv_Ctor,
+		     (UnitDtorFunc)&VarMembraneConv_Dtor,
+		     0);
+
 
 }
 